@@ -0,0 +1,165 @@
+#ifndef __CODEC_H_
+#define __CODEC_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "recordio.h"
+
+// The direct codec reads and writes the big-endian jute encoding straight
+// from the buffer archives, the jute_encode_* and jute_decode_* functions in
+// zookeeper.codec.c are generated on top of these. Readers report errors the
+// same way the iarchive does: -E2BIG for a short buffer, -EINVAL for a
+// negative string length and -ENOMEM.
+
+static inline int is_buffer_iarchive(struct iarchive *ia) {
+    return ia->start_record == ia_start_record;
+}
+
+static inline int is_buffer_oarchive(struct oarchive *oa) {
+    return oa->start_record == oa_start_record;
+}
+
+static inline uint32_t load_be32(const char *p) {
+    uint32_t v;
+
+    memcpy(&v, p, 4);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static inline uint64_t load_be64(const char *p) {
+    uint64_t v;
+
+    memcpy(&v, p, 8);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline void store_be32(char *p, uint32_t v) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    memcpy(p, &v, 4);
+}
+
+static inline void store_be64(char *p, uint64_t v) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    memcpy(p, &v, 8);
+}
+
+// the jget_* and jput_* helpers leave the bounds checks to the caller, which
+// checks a run of fixed size fields at once.
+static inline int32_t jget_int(struct buff_struct *b) {
+    b->off += 4;
+    return (int32_t)load_be32(b->buffer + b->off - 4);
+}
+
+static inline int64_t jget_long(struct buff_struct *b) {
+    b->off += 8;
+    return (int64_t)load_be64(b->buffer + b->off - 8);
+}
+
+static inline int32_t jget_bool(struct buff_struct *b) {
+    return b->buffer[b->off++];
+}
+
+static inline void jput_int(struct buff_struct *b, int32_t v) {
+    store_be32(b->buffer + b->off, v);
+    b->off += 4;
+}
+
+static inline void jput_long(struct buff_struct *b, int64_t v) {
+    store_be64(b->buffer + b->off, v);
+    b->off += 8;
+}
+
+static inline void jput_bool(struct buff_struct *b, int32_t v) {
+    b->buffer[b->off++] = v ? 1 : 0;
+}
+
+static inline int jneed(struct buff_struct *b, int32_t n) {
+    return b->len - b->off < n ? -E2BIG : 0;
+}
+
+static inline int jreserve(struct buff_struct *b, int32_t n) {
+    return b->len - b->off < n ? resize_buffer(b, b->off + n) : 0;
+}
+
+static inline int jread_int(struct buff_struct *b, int32_t *v) {
+    if (jneed(b, 4)) return -E2BIG;
+    *v = jget_int(b);
+    return 0;
+}
+
+static inline int jread_buffer(struct buff_struct *b, struct buffer *v) {
+    if (jread_int(b, &v->len)) return -E2BIG;
+    if (v->len == -1) {
+        v->buff = NULL;
+        return 0;
+    }
+    if (v->len < 0 || jneed(b, v->len)) return -E2BIG;
+    if (b->view) {
+        v->buff = b->buffer + b->off;
+    } else {
+        if (!(v->buff = malloc(v->len))) return -ENOMEM;
+        memcpy(v->buff, b->buffer + b->off, v->len);
+    }
+    b->off += v->len;
+    return 0;
+}
+
+static inline int jread_string(struct buff_struct *b, char **v) {
+    int32_t len;
+
+    if (jread_int(b, &len)) return -E2BIG;
+    if (jneed(b, len)) return -E2BIG;
+    if (len < 0) return -EINVAL;
+    if (b->view) {
+        // same trick as the view iarchive, see ia_deserialize_string_view
+        *v = b->buffer + b->off - 4;
+        memmove(*v, b->buffer + b->off, len);
+    } else if (!(*v = malloc(len + 1))) {
+        return -ENOMEM;
+    } else {
+        memcpy(*v, b->buffer + b->off, len);
+    }
+    (*v)[len] = '\0';
+    b->off += len;
+    return 0;
+}
+
+static inline int jwrite_int(struct buff_struct *b, int32_t v) {
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v);
+    return 0;
+}
+
+static inline int jwrite_buffer(struct buff_struct *b, const struct buffer *v) {
+    if (!v || v->len == -1) return jwrite_int(b, -1);
+    if (jreserve(b, 4 + v->len)) return -ENOMEM;
+    jput_int(b, v->len);
+    memcpy(b->buffer + b->off, v->buff, v->len);
+    b->off += v->len;
+    return 0;
+}
+
+static inline int jwrite_string(struct buff_struct *b, const char *v) {
+    int32_t len;
+
+    if (!v) return jwrite_int(b, -1);
+    len = strlen(v);
+    if (jreserve(b, 4 + len)) return -ENOMEM;
+    jput_int(b, len);
+    memcpy(b->buffer + b->off, v, len);
+    b->off += len;
+    return 0;
+}
+#endif
@@ -7,6 +7,8 @@
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <poll.h>
 #include "conn.h"
 #include "zkclient.h"
@@ -28,7 +30,11 @@ static int set_socket_nodelay(int fd) {
     int rc, enable;
 
     enable = 1;
-    rc = setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(int));
+    rc = setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(int));
+#ifdef SO_NOSIGPIPE
+    // there's no MSG_NOSIGNAL on every platform
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(int));
+#endif
     return rc < 0 ? ZK_ERROR : ZK_OK;
 }
 
@@ -0,0 +1,519 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "util.h"
+#include "datatree.h"
+#include "zkclient.h"
+#include "request.h"
+
+#define DT_TOMB 0xfffffffeu
+#define ARENA_CHUNK (1024 * 1024)
+#define CONTAINER_OWNER ((int64_t)1 << 63)
+#define LOAD_BATCH 256
+
+struct dt_arena {
+    struct dt_arena *next;
+    size_t used;
+    size_t cap;
+    char buf[];
+};
+
+static uint32_t hash_path(const char *path, int32_t len) {
+    int32_t i;
+    uint32_t h = 2166136261u;
+
+    for (i = 0; i < len; i++) {
+        h ^= (uint8_t)path[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static char *arena_copy(struct datatree *t, const char *src, int32_t len) {
+    size_t cap;
+    struct dt_arena *a = t->arena;
+
+    if (len <= 0) return NULL;
+    if (!a || a->cap - a->used < (size_t)len) {
+        cap = len > ARENA_CHUNK ? len : ARENA_CHUNK;
+        if (!(a = malloc(sizeof(*a) + cap))) return NULL;
+        a->used = 0;
+        a->cap = cap;
+        a->next = t->arena;
+        t->arena = a;
+    }
+    memcpy(a->buf + a->used, src, len);
+    a->used += len;
+    return a->buf + a->used - len;
+}
+
+struct datatree *datatree_new(void) {
+    struct datatree *t;
+
+    if (!(t = calloc(1, sizeof(*t)))) return NULL;
+    t->nslots = 1024;
+    t->slots = malloc(sizeof(uint32_t) * t->nslots);
+    memset(t->slots, 0xff, sizeof(uint32_t) * t->nslots);
+    t->snap_zxid = -1;
+    stat_block_init(&t->stats, 0);
+    return t;
+}
+
+void datatree_free(struct datatree *t) {
+    struct dt_arena *a, *next;
+
+    if (!t) return;
+    for (a = t->arena; a; a = next) {
+        next = a->next;
+        free(a);
+    }
+    if (t->snap) snapshot_close(t->snap);
+    stat_block_free(&t->stats);
+    free(t->ephemerals);
+    free(t->slots);
+    free(t->nodes);
+    free(t);
+}
+
+// find_slot returns the slot which holds path, or the empty slot where it
+// would be inserted.
+static uint32_t find_slot(struct datatree *t, const char *path, int32_t len, int *found) {
+    uint32_t i, idx, mask = t->nslots - 1, tomb = DT_NONE;
+    struct dt_node *n;
+
+    *found = 0;
+    for (i = hash_path(path, len) & mask; ; i = (i + 1) & mask) {
+        idx = t->slots[i];
+        if (idx == DT_NONE) return tomb != DT_NONE ? tomb : i;
+        if (idx == DT_TOMB) {
+            if (tomb == DT_NONE) tomb = i;
+            continue;
+        }
+        n = &t->nodes[idx];
+        if (n->path_len == len && !memcmp(n->path, path, len)) {
+            *found = 1;
+            return i;
+        }
+    }
+}
+
+static int grow_slots(struct datatree *t) {
+    int found;
+    uint32_t i, nslots, *old = t->slots, old_nslots = t->nslots;
+
+    for (nslots = 1024; nslots < t->live * 4; nslots *= 2);
+    if (!(t->slots = malloc(sizeof(uint32_t) * nslots))) {
+        t->slots = old;
+        return ZK_ERROR;
+    }
+    memset(t->slots, 0xff, sizeof(uint32_t) * nslots);
+    t->nslots = nslots;
+    t->used_slots = 0;
+    for (i = 0; i < old_nslots; i++) {
+        if (old[i] == DT_NONE || old[i] == DT_TOMB) continue;
+        t->slots[find_slot(t, t->nodes[old[i]].path, t->nodes[old[i]].path_len, &found)] = old[i];
+        t->used_slots++;
+    }
+    free(old);
+    return ZK_OK;
+}
+
+static uint32_t lookup_index(struct datatree *t, const char *path, int32_t len) {
+    int found;
+    uint32_t slot;
+
+    slot = find_slot(t, path, len, &found);
+    return found ? t->slots[slot] : DT_NONE;
+}
+
+static uint32_t parent_index(struct datatree *t, const char *path, int32_t len) {
+    int32_t i;
+
+    for (i = len - 1; i > 0 && path[i] != '/'; i--);
+    return lookup_index(t, path, i);
+}
+
+// add_node inserts a node under parent, the caller made sure path is not in
+// the tree yet. Returns the index of the node or DT_NONE.
+static uint32_t add_node(struct datatree *t, const char *path, int32_t len, uint32_t parent) {
+    int found;
+    uint32_t idx, cap, slot;
+    struct dt_node *n, *nodes, *p;
+    struct StatPersisted zero = {0};
+
+    if ((t->used_slots + 1) * 2 > t->nslots && grow_slots(t) != ZK_OK) return DT_NONE;
+    if (t->count == t->cap) {
+        cap = t->cap ? t->cap * 2 : 1024;
+        if (!(nodes = realloc(t->nodes, sizeof(*nodes) * cap))) return DT_NONE;
+        t->nodes = nodes;
+        if (stat_block_reserve(&t->stats, cap) != ZK_OK) return DT_NONE;
+        t->cap = cap;
+    }
+    idx = t->count++;
+    n = &t->nodes[idx];
+    memset(n, 0, sizeof(*n));
+    stat_block_set(&t->stats, idx, &zero);
+    if (t->stats.count <= idx) t->stats.count = idx + 1;
+    n->path = path;
+    n->path_len = len;
+    n->data_len = -1;
+    n->parent = parent;
+    n->first_child = n->next_sibling = n->prev_sibling = DT_NONE;
+    if (parent != DT_NONE) {
+        p = &t->nodes[parent];
+        n->next_sibling = p->first_child;
+        if (p->first_child != DT_NONE) t->nodes[p->first_child].prev_sibling = idx;
+        p->first_child = idx;
+        p->num_children++;
+    }
+    slot = find_slot(t, path, len, &found);
+    if (t->slots[slot] == DT_NONE) t->used_slots++;
+    t->slots[slot] = idx;
+    t->live++;
+    return idx;
+}
+
+static void track_ephemeral(struct datatree *t, uint32_t idx) {
+    uint32_t cap, *ephemerals;
+
+    if (t->nephemerals == t->ephemerals_cap) {
+        cap = t->ephemerals_cap ? t->ephemerals_cap * 2 : 64;
+        if (!(ephemerals = realloc(t->ephemerals, sizeof(uint32_t) * cap))) return;
+        t->ephemerals = ephemerals;
+        t->ephemerals_cap = cap;
+    }
+    t->ephemerals[t->nephemerals++] = idx;
+}
+
+static void remove_node(struct datatree *t, uint32_t idx) {
+    int found;
+    struct dt_node *n = &t->nodes[idx], *p;
+
+    // a fuzzy snapshot may still hold children of a deleted node
+    while (n->first_child != DT_NONE) remove_node(t, n->first_child);
+    if (n->parent != DT_NONE) {
+        p = &t->nodes[n->parent];
+        if (n->prev_sibling != DT_NONE) {
+            t->nodes[n->prev_sibling].next_sibling = n->next_sibling;
+        } else {
+            p->first_child = n->next_sibling;
+        }
+        if (n->next_sibling != DT_NONE) t->nodes[n->next_sibling].prev_sibling = n->prev_sibling;
+        p->num_children--;
+    }
+    t->slots[find_slot(t, n->path, n->path_len, &found)] = DT_TOMB;
+    n->deleted = 1;
+    n->parent = DT_NONE;
+    t->live--;
+}
+
+// load_stats decodes the stats of a batch of freshly added nodes, whose
+// indexes start at first, in one go.
+static void load_stats(struct datatree *t, uint32_t first, const char **raws, int n) {
+    int i;
+    int64_t owner;
+
+    decode_stats_persisted(&t->stats, first, raws, n);
+    for (i = 0; i < n; i++) {
+        owner = t->stats.ephemeral_owner[first + i];
+        if (owner && owner != CONTAINER_OWNER) track_ephemeral(t, first + i);
+    }
+}
+
+int datatree_load_snapshot(struct datatree *t, struct snapshot *s) {
+    int rc, n = 0;
+    uint32_t idx, parent, first = 0;
+    const char *raws[LOAD_BATCH];
+    struct snap_node node;
+
+    s->raw_stats = 1;
+    while ((rc = snapshot_next_node(s, &node)) == 1) {
+        parent = node.path_len > 0 ? parent_index(t, node.path, node.path_len) : DT_NONE;
+        if (node.path_len > 0 && parent == DT_NONE) {
+            logger(WARN, "node %.*s has no parent in the snapshot.", node.path_len, node.path);
+        }
+        if ((idx = add_node(t, node.path, node.path_len, parent)) == DT_NONE) return ZK_ERROR;
+        t->nodes[idx].data = node.data;
+        t->nodes[idx].data_len = node.data_len;
+        t->nodes[idx].acl = node.acl;
+        if (n == 0) first = idx;
+        raws[n++] = node.stat_raw;
+        if (n == LOAD_BATCH) {
+            load_stats(t, first, raws, n);
+            n = 0;
+        }
+    }
+    if (n > 0) load_stats(t, first, raws, n);
+    return rc == 0 ? ZK_OK : ZK_ERROR;
+}
+
+static void apply_create(struct datatree *t, struct TxnHeader *header, int32_t type,
+        struct CreateTxn *txn) {
+    int32_t len = strlen(txn->path), cversion;
+    uint32_t idx, parent;
+    char *path;
+    struct dt_node *n;
+    struct stat_block *b = &t->stats;
+
+    // txns between the snapshot's zxid and the end of the fuzzy snapshot may
+    // be in it already, replaying them again has to be a no-op.
+    if (lookup_index(t, txn->path, len) != DT_NONE) return;
+    if ((parent = parent_index(t, txn->path, len)) == DT_NONE) return;
+    if (!(path = arena_copy(t, txn->path, len))) return;
+    if ((idx = add_node(t, path, len, parent)) == DT_NONE) return;
+    n = &t->nodes[idx];
+    n->data = arena_copy(t, txn->data.buff, txn->data.len);
+    n->data_len = txn->data.len;
+    n->acl = -1;
+    b->czxid[idx] = b->mzxid[idx] = b->pzxid[idx] = header->zxid;
+    b->ctime[idx] = b->mtime[idx] = header->time;
+    if (type == CREATE_CONTAINER_TXN) {
+        b->ephemeral_owner[idx] = CONTAINER_OWNER;
+    } else if (txn->ephemeral) {
+        b->ephemeral_owner[idx] = header->clientId;
+        track_ephemeral(t, idx);
+    }
+    cversion = txn->parentCVersion == -1 ? b->cversion[parent] + 1 : txn->parentCVersion;
+    if (cversion > b->cversion[parent]) {
+        b->cversion[parent] = cversion;
+        b->pzxid[parent] = header->zxid;
+    }
+}
+
+static void apply_delete(struct datatree *t, struct TxnHeader *header, uint32_t idx) {
+    uint32_t parent;
+
+    if (idx == DT_NONE) return;
+    if ((parent = t->nodes[idx].parent) != DT_NONE) {
+        t->stats.cversion[parent]++;
+        if (header->zxid > t->stats.pzxid[parent]) t->stats.pzxid[parent] = header->zxid;
+    }
+    remove_node(t, idx);
+}
+
+static void close_session(struct datatree *t, struct TxnHeader *header) {
+    uint32_t i, j, idx;
+
+    for (i = 0, j = 0; i < t->nephemerals; i++) {
+        idx = t->ephemerals[i];
+        if (t->nodes[idx].deleted) continue;
+        if (t->stats.ephemeral_owner[idx] == header->clientId) {
+            apply_delete(t, header, idx);
+            continue;
+        }
+        t->ephemerals[j++] = idx;
+    }
+    t->nephemerals = j;
+}
+
+static int apply_txn(struct datatree *t, struct TxnHeader *header, struct txn_body *body) {
+    int i, rc = ZK_OK;
+    uint32_t idx;
+    struct dt_node *n;
+    struct txn_body sub;
+
+    switch (body->type) {
+        case CREATE_OPCODE:
+        case CREATE2_TXN:
+        case CREATE_CONTAINER_TXN:
+        case CREATE_TTL_TXN:
+            apply_create(t, header, body->type, &body->u.create);
+            break;
+        case DELETE_OPCODE:
+        case DELETE_CONTAINER_TXN:
+            apply_delete(t, header, lookup_index(t, body->u.del.path, strlen(body->u.del.path)));
+            break;
+        case SETDATA_OPCODE:
+            idx = lookup_index(t, body->u.set_data.path, strlen(body->u.set_data.path));
+            if (idx == DT_NONE) break;
+            n = &t->nodes[idx];
+            n->data = arena_copy(t, body->u.set_data.data.buff, body->u.set_data.data.len);
+            n->data_len = body->u.set_data.data.len;
+            t->stats.version[idx] = body->u.set_data.version;
+            t->stats.mzxid[idx] = header->zxid;
+            t->stats.mtime[idx] = header->time;
+            break;
+        case SETACL_OPCODE:
+            idx = lookup_index(t, body->u.set_acl.path, strlen(body->u.set_acl.path));
+            if (idx == DT_NONE) break;
+            t->stats.aversion[idx] = body->u.set_acl.version;
+            t->nodes[idx].acl = -1;
+            break;
+        case CLOSE_SESSION_TXN:
+            close_session(t, header);
+            break;
+        case MULTI_OPCODE:
+            for (i = 0; i < body->u.multi.txns.count && rc == ZK_OK; i++) {
+                rc = txn_decode(body->u.multi.txns.data[i].type, body->u.multi.txns.data[i].data.buff,
+                        body->u.multi.txns.data[i].data.len, &sub);
+                if (rc != ZK_OK) break;
+                rc = apply_txn(t, header, &sub);
+                deallocate_txn_body(&sub);
+            }
+            break;
+    }
+    return rc;
+}
+
+// datatree_apply applies one txn the way the server does, txns which no
+// longer match the tree are skipped instead of failing the replay.
+int datatree_apply(struct datatree *t, struct TxnHeader *header, struct txn_body *body) {
+    int rc;
+
+    rc = apply_txn(t, header, body);
+    if (header->zxid > t->zxid) t->zxid = header->zxid;
+    t->applied++;
+    return rc;
+}
+
+// replay_txn is a decoded log entry waiting to be applied
+struct replay_txn {
+    struct TxnHeader header;
+    struct txn_body body;
+    struct replay_txn *next;
+};
+
+struct replay_job {
+    const char *filename;
+    int64_t start;
+    int64_t from;
+    int64_t to;
+    struct replay_txn *head;
+    struct replay_txn *tail;
+    int rc;
+    int running;
+    pthread_t tid;
+};
+
+// decode_log runs on its own thread per log, so logs are read and decoded
+// while the snapshot is being loaded.
+static void *decode_log(void *arg) {
+    int rc;
+    struct replay_job *job = arg;
+    struct replay_txn *txn;
+    struct txnlog *log;
+    struct txn_entry entry;
+
+    job->rc = ZK_ERROR;
+    if (!(log = txnlog_open(job->filename))) {
+        logger(WARN, "open txn log %s failed.", job->filename);
+        return NULL;
+    }
+    while ((rc = txnlog_next(log, &entry)) == 1) {
+        if (entry.header.zxid <= job->from) continue;
+        if (job->to >= 0 && entry.header.zxid > job->to) break;
+        if (!(txn = calloc(1, sizeof(*txn)))) break;
+        txn->header = entry.header;
+        if (txn_decode(entry.header.type, entry.body, entry.body_len, &txn->body) != ZK_OK) {
+            logger(WARN, "decode txn 0x%llx in %s failed.", (long long)entry.header.zxid, job->filename);
+            free(txn);
+            rc = ZK_ERROR;
+            break;
+        }
+        if (job->tail) {
+            job->tail->next = txn;
+        } else {
+            job->head = txn;
+        }
+        job->tail = txn;
+    }
+    if (rc == ZK_ERROR) {
+        logger(WARN, "txn log %s is corrupt at offset %ld.", job->filename, log->offset);
+    }
+    txnlog_close(log);
+    job->rc = rc == ZK_ERROR ? ZK_ERROR : ZK_OK;
+    return NULL;
+}
+
+static int compare_job(const void *a, const void *b) {
+    int64_t sa = ((struct replay_job *)a)->start, sb = ((struct replay_job *)b)->start;
+    return sa < sb ? -1 : (sa > sb ? 1 : 0);
+}
+
+static void release_txns(struct replay_job *job) {
+    struct replay_txn *txn, *next;
+
+    for (txn = job->head; txn; txn = next) {
+        next = txn->next;
+        deallocate_txn_body(&txn->body);
+        free(txn);
+    }
+    job->head = job->tail = NULL;
+}
+
+// datatree_replay rebuilds the tree as of zxid, or as of the end of the logs
+// when zxid is -1. Logs are named after their first zxid, those which end
+// before the snapshot or start after zxid are not read at all.
+int datatree_replay(struct datatree *t, const char *snapshot, char **logs, int nlogs, int64_t zxid) {
+    int i, rc = ZK_OK;
+    struct replay_job *jobs = NULL;
+    struct replay_txn *txn;
+
+    if (!(t->snap = snapshot_open(snapshot))) {
+        logger(WARN, "open snapshot %s failed.", snapshot);
+        return ZK_ERROR;
+    }
+    t->snap_zxid = snapshot_zxid(snapshot);
+    t->zxid = t->snap_zxid;
+    if (nlogs > 0 && !(jobs = calloc(nlogs, sizeof(*jobs)))) return ZK_ERROR;
+    for (i = 0; i < nlogs; i++) {
+        jobs[i].filename = logs[i];
+        jobs[i].start = snapshot_zxid(logs[i]);
+        jobs[i].from = t->snap_zxid;
+        jobs[i].to = zxid;
+    }
+    if (nlogs > 0) qsort(jobs, nlogs, sizeof(*jobs), compare_job);
+    for (i = 0; i < nlogs; i++) {
+        if (i + 1 < nlogs && jobs[i + 1].start >= 0 && jobs[i + 1].start <= t->snap_zxid + 1) continue;
+        if (zxid >= 0 && jobs[i].start > zxid) continue;
+        if (pthread_create(&jobs[i].tid, NULL, decode_log, &jobs[i]) == 0) {
+            jobs[i].running = 1;
+        } else {
+            decode_log(&jobs[i]);
+        }
+    }
+    if (datatree_load_snapshot(t, t->snap) != ZK_OK) {
+        logger(WARN, "snapshot %s is corrupt after %lld nodes.", snapshot, (long long)t->snap->nnodes);
+        rc = ZK_ERROR;
+    }
+    // logs are applied in order as soon as their decoder finished
+    for (i = 0; i < nlogs; i++) {
+        if (jobs[i].running) pthread_join(jobs[i].tid, NULL);
+        if (rc == ZK_OK && jobs[i].rc != ZK_OK) rc = ZK_ERROR;
+        for (txn = jobs[i].head; txn && rc == ZK_OK; txn = txn->next) {
+            rc = datatree_apply(t, &txn->header, &txn->body);
+        }
+        release_txns(&jobs[i]);
+    }
+    if (nlogs > 0) free(jobs);
+    return rc;
+}
+
+struct dt_node *datatree_lookup(struct datatree *t, const char *path, int32_t len) {
+    uint32_t idx;
+
+    // the root is stored as "", and "/a/" is the same node as "/a"
+    while (len > 0 && path[len - 1] == '/') len--;
+    idx = lookup_index(t, path, len);
+    return idx == DT_NONE ? NULL : &t->nodes[idx];
+}
+
+struct dt_node *datatree_child(struct datatree *t, struct dt_node *n) {
+    return n->first_child == DT_NONE ? NULL : &t->nodes[n->first_child];
+}
+
+struct dt_node *datatree_sibling(struct datatree *t, struct dt_node *n) {
+    return n->next_sibling == DT_NONE ? NULL : &t->nodes[n->next_sibling];
+}
+
+void datatree_stat(struct datatree *t, struct dt_node *n, struct Stat *stat) {
+    stat_block_get_stat(&t->stats, n - t->nodes, stat);
+    stat->dataLength = n->data_len < 0 ? 0 : n->data_len;
+    stat->numChildren = n->num_children;
+}
+
+void datatree_stat_persisted(struct datatree *t, struct dt_node *n, struct StatPersisted *stat) {
+    stat_block_get(&t->stats, n - t->nodes, stat);
+}
@@ -0,0 +1,60 @@
+#ifndef __DATATREE_H_
+#define __DATATREE_H_
+
+#include "snapshot.h"
+#include "txnlog.h"
+#include "statblock.h"
+#include "zookeeper.jute.h"
+
+#define DT_NONE 0xffffffffu
+
+// dt_node is one node of an offline tree. Nodes loaded from a snapshot keep
+// pointing into its mapping, only paths and data written by replayed txns
+// are copied into the tree's arena. The root has an empty path. Stats live
+// in the tree's stat block at the node's index.
+struct dt_node {
+    const char *path;
+    const char *data;
+    int32_t path_len;
+    int32_t data_len;
+    int64_t acl;
+    uint32_t parent;
+    uint32_t first_child;
+    uint32_t next_sibling;
+    uint32_t prev_sibling;
+    int32_t num_children;
+    int32_t deleted;
+};
+
+struct dt_arena;
+
+struct datatree {
+    struct dt_node *nodes;
+    uint32_t count;
+    uint32_t cap;
+    uint32_t live;
+    uint32_t *slots;
+    uint32_t nslots;
+    uint32_t used_slots;
+    uint32_t *ephemerals;
+    uint32_t nephemerals;
+    uint32_t ephemerals_cap;
+    struct stat_block stats;
+    struct dt_arena *arena;
+    struct snapshot *snap;
+    int64_t snap_zxid;
+    int64_t zxid;
+    int64_t applied;
+};
+
+struct datatree *datatree_new(void);
+void datatree_free(struct datatree *t);
+int datatree_load_snapshot(struct datatree *t, struct snapshot *s);
+int datatree_apply(struct datatree *t, struct TxnHeader *header, struct txn_body *body);
+int datatree_replay(struct datatree *t, const char *snapshot, char **logs, int nlogs, int64_t zxid);
+struct dt_node *datatree_lookup(struct datatree *t, const char *path, int32_t len);
+struct dt_node *datatree_child(struct datatree *t, struct dt_node *n);
+struct dt_node *datatree_sibling(struct datatree *t, struct dt_node *n);
+void datatree_stat(struct datatree *t, struct dt_node *n, struct Stat *stat);
+void datatree_stat_persisted(struct datatree *t, struct dt_node *n, struct StatPersisted *stat);
+#endif
@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "export.h"
+#include "request.h"
+#include "recordio.h"
+#include "zookeeper.jute.h"
+#include "zookeeper.codec.h"
+
+// nodes fetched per pipelined burst while exporting
+#define EXPORT_BATCH 128
+// a multi transaction has to fit in the server's jute.maxbuffer (1MB)
+#define IMPORT_BATCH 128
+#define IMPORT_BATCH_BYTES (512 * 1024)
+
+static char *join_path(const char *parent, const char *name) {
+    int plen, nlen;
+    char *path;
+
+    plen = strlen(parent);
+    nlen = strlen(name);
+    // "/" + "/a" must not become "//a"
+    if (plen == 1 && parent[0] == '/') plen = 0;
+    path = malloc(plen + nlen + 2);
+    if (!path) {
+        logger(ERROR, "Malloc memory failed.");
+        exit(1);
+    }
+    memcpy(path, parent, plen);
+    if (name[0] != '/') path[plen++] = '/';
+    memcpy(path + plen, name, nlen + 1);
+    return path;
+}
+
+struct export_batch {
+    char *paths[EXPORT_BATCH];
+    struct buffer data[EXPORT_BATCH];
+    struct Stat stats[EXPORT_BATCH];
+    int errs[EXPORT_BATCH];
+};
+
+// export_children streams the subtree below path. Each level only holds its
+// children list and one batch of stats, so memory is bounded by the depth of
+// the tree rather than its size.
+static int export_children(zk_client *c, FILE *fp, char *path, int root_len) {
+    int i, j, k, n, rc;
+    struct export_batch *b;
+    struct export_record rec;
+    char *frame = NULL;
+    struct String_vector children = {0, NULL};
+
+    if ((rc = zk_get_children_view(c, path, &children, &frame)) != ZK_OK) {
+        // the node was deleted since its parent was listed
+        return rc == ZNONODE ? ZK_OK : rc;
+    }
+    if (!(b = malloc(sizeof(*b)))) {
+        zk_release_children_view(&children, frame);
+        return ZK_ERROR;
+    }
+    for (i = 0; i < children.count && rc == ZK_OK; i += k) {
+        k = children.count - i < EXPORT_BATCH ? children.count - i : EXPORT_BATCH;
+        for (j = n = 0; j < k; j++) {
+            // /zookeeper belongs to the server, an import of it would
+            // overwrite the system nodes of the destination
+            if (!strcmp(path, "/") && !strcmp(children.data[i + j], "zookeeper")) continue;
+            b->paths[n++] = join_path(path, children.data[i + j]);
+        }
+        rc = n > 0 ? zk_get_batch(c, b->paths, n, b->data, b->stats, b->errs) : ZK_OK;
+        for (j = 0; j < n && rc == ZK_OK; j++) {
+            if (b->errs[j] == ZNONODE) continue;
+            if (b->errs[j] != ZOK) {
+                rc = b->errs[j];
+                break;
+            }
+            rec.path = b->paths[j] + root_len;
+            rec.data = b->data[j];
+            rec.stat = b->stats[j];
+            rec.flags = b->stats[j].ephemeralOwner ? ZOO_EPHEMERAL : 0;
+            rc = export_write_record(fp, &rec);
+        }
+        for (j = 0; j < n; j++) {
+            deallocate_Buffer(&b->data[j]);
+        }
+        // the whole batch of siblings is written before descending, which
+        // still keeps every parent ahead of its children.
+        for (j = 0; j < n && rc == ZK_OK; j++) {
+            if (b->errs[j] == ZOK && b->stats[j].numChildren > 0) {
+                rc = export_children(c, fp, b->paths[j], root_len);
+            }
+        }
+        for (j = 0; j < n; j++) {
+            free(b->paths[j]);
+        }
+    }
+    free(b);
+    zk_release_children_view(&children, frame);
+    return rc;
+}
+
+int zk_export(zk_client *c, const char *path, const char *filename) {
+    int rc, err, root_len;
+    char *root;
+    FILE *fp;
+    struct Stat stat;
+    struct export_record rec;
+
+    if (!c || !path || !filename) return ZK_ERROR;
+    if (!(fp = fopen(filename, "wb"))) {
+        logger(DEBUG, "Open export file %s failed.", filename);
+        set_last_error(ZK_ERROR);
+        return ZK_ERROR;
+    }
+    root = (char *)path;
+    root_len = strcmp(path, "/") ? strlen(path) : 0;
+    rc = export_write_header(fp);
+    if (rc == ZK_OK && (rc = zk_get_batch(c, &root, 1, &rec.data, &stat, &err)) == ZK_OK) {
+        rc = err;
+    }
+    if (rc == ZK_OK) {
+        rec.path = "";
+        rec.stat = stat;
+        rec.flags = stat.ephemeralOwner ? ZOO_EPHEMERAL : 0;
+        rc = export_write_record(fp, &rec);
+        deallocate_Buffer(&rec.data);
+    }
+    if (rc == ZK_OK && stat.numChildren > 0) {
+        rc = export_children(c, fp, root, root_len);
+    }
+    if (rc == ZK_OK) rc = export_write_trailer(fp);
+    if (fclose(fp) != 0 && rc == ZK_OK) rc = ZK_ERROR;
+    set_last_error(rc);
+    return rc;
+}
+
+struct import_batch {
+    int n;
+    int bytes;
+    struct zk_op ops[IMPORT_BATCH];
+    int errs[IMPORT_BATCH];
+};
+
+static void release_import_batch(struct import_batch *b) {
+    int i;
+
+    for (i = 0; i < b->n; i++) {
+        free(b->ops[i].path);
+        deallocate_Buffer(&b->ops[i].data);
+    }
+    b->n = 0;
+    b->bytes = 0;
+}
+
+// import_node creates a single node, or overwrites its data if it exists
+static int import_node(zk_client *c, char *path, struct buffer *data, int flags) {
+    int rc;
+
+    rc = zk_create(c, path, data->buff, data->len, flags);
+    if (rc == ZNODEEXISTS) rc = zk_set(c, path, data);
+    return rc;
+}
+
+// flush_import_batch creates the batched nodes with one multi transaction.
+// If the transaction is rejected, e.g. some nodes already exist in the
+// destination, it falls back to one create per node and overwrites the data
+// of the existing ones, so an import can be safely re-run.
+static int flush_import_batch(zk_client *c, struct import_batch *b) {
+    int i, rc;
+
+    if (b->n == 0) return ZK_OK;
+    rc = zk_multi(c, b->ops, b->n, b->errs);
+    if (rc != ZK_OK && rc < ZAPIERROR) {
+        for (i = 0, rc = ZK_OK; i < b->n && rc == ZK_OK; i++) {
+            rc = import_node(c, b->ops[i].path, &b->ops[i].data, b->ops[i].flags);
+        }
+    }
+    release_import_batch(b);
+    return rc;
+}
+
+int zk_import(zk_client *c, const char *filename, const char *path) {
+    int rc, more, nodes, skipped, size;
+    char *full;
+    FILE *fp;
+    struct import_batch *b;
+    struct export_record rec;
+
+    if (!c || !filename || !path) return ZK_ERROR;
+    if (!(fp = fopen(filename, "rb"))) {
+        logger(DEBUG, "Open import file %s failed.", filename);
+        set_last_error(ZK_ERROR);
+        return ZK_ERROR;
+    }
+    if (!(b = calloc(1, sizeof(*b)))) {
+        fclose(fp);
+        set_last_error(ZK_ERROR);
+        return ZK_ERROR;
+    }
+    nodes = skipped = 0;
+    rc = export_read_header(fp);
+    // the root record lands on path itself, which may already exist
+    if (rc == ZK_OK) {
+        if (export_read_record(fp, &rec) == 1) {
+            rc = strcmp(path, "/") ? zk_mkdir(c, (char *)path) : ZK_OK;
+            if (rc == ZK_OK || rc == ZNODEEXISTS) {
+                rc = rec.data.len > 0 ? zk_set(c, (char *)path, &rec.data) : ZK_OK;
+            }
+            deallocate_export_record(&rec);
+            nodes++;
+        } else {
+            rc = ZK_ERROR;
+        }
+    }
+    while (rc == ZK_OK) {
+        if ((more = export_read_record(fp, &rec)) <= 0) {
+            rc = more == 0 ? flush_import_batch(c, b) : ZK_ERROR;
+            break;
+        }
+        // ephemeral nodes belong to sessions of the source ensemble and
+        // can't have children, so they are left out.
+        if (rec.flags & ZOO_EPHEMERAL) {
+            deallocate_export_record(&rec);
+            skipped++;
+            continue;
+        }
+        size = rec.data.len + strlen(rec.path);
+        if (size > IMPORT_BATCH_BYTES) {
+            // with others in a multi a node this large could pass the
+            // server's jute.maxbuffer, it's created on its own
+            rc = flush_import_batch(c, b);
+            full = join_path(path, rec.path);
+            if (rc == ZK_OK) rc = import_node(c, full, &rec.data, 0);
+            free(full);
+            deallocate_export_record(&rec);
+            nodes++;
+            continue;
+        }
+        if (b->n == IMPORT_BATCH || b->bytes + size > IMPORT_BATCH_BYTES) {
+            rc = flush_import_batch(c, b);
+        }
+        b->ops[b->n].type = CREATE_OPCODE;
+        b->ops[b->n].path = join_path(path, rec.path);
+        b->ops[b->n].data = rec.data;
+        b->ops[b->n].flags = 0;
+        b->ops[b->n].version = -1;
+        b->bytes += size;
+        b->n++;
+        nodes++;
+        rec.data.buff = NULL;
+        deallocate_export_record(&rec);
+    }
+    release_import_batch(b);
+    fclose(fp);
+    free(b);
+    logger(DEBUG, "Import %s to %s, %d nodes, %d ephemeral nodes skipped.",
+            filename, path, nodes, skipped);
+    set_last_error(rc);
+    return rc;
+}
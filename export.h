@@ -0,0 +1,8 @@
+#ifndef __EXPORT_H_
+#define __EXPORT_H_
+
+#include "exportfile.h"
+
+int zk_export(zk_client *c, const char *path, const char *filename);
+int zk_import(zk_client *c, const char *filename, const char *path);
+#endif
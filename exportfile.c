@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "exportfile.h"
+#include "recordio.h"
+#include "zookeeper.jute.h"
+#include "zookeeper.codec.h"
+#include "codec.h"
+
+static int write_int32(FILE *fp, int32_t i32) {
+    char buf[4];
+
+    store_be32(buf, i32);
+    return fwrite(buf, 4, 1, fp) == 1 ? ZK_OK : ZK_ERROR;
+}
+
+static int read_int32(FILE *fp, int32_t *i32) {
+    char buf[4];
+
+    if (fread(buf, 4, 1, fp) != 1) return ZK_ERROR;
+    *i32 = (int32_t)load_be32(buf);
+    return ZK_OK;
+}
+
+int export_write_header(FILE *fp) {
+    if (write_int32(fp, EXPORT_MAGIC) != ZK_OK) return ZK_ERROR;
+    return write_int32(fp, EXPORT_VERSION);
+}
+
+int export_read_header(FILE *fp) {
+    int32_t magic, version;
+
+    if (read_int32(fp, &magic) != ZK_OK || read_int32(fp, &version) != ZK_OK) {
+        return ZK_ERROR;
+    }
+    return magic == EXPORT_MAGIC && version == EXPORT_VERSION ? ZK_OK : ZK_ERROR;
+}
+
+// Each record is framed like a request on the wire: a length prefix followed
+// by the jute encoding of path, data, stat and flags.
+int export_write_record(FILE *fp, struct export_record *rec) {
+    int rc;
+    struct oarchive *oa;
+
+    oa = create_buffer_oarchive();
+    if (!oa) return ZK_ERROR;
+    rc = oa->serialize_String(oa, "path", &rec->path);
+    rc = rc < 0 ? rc : oa->serialize_Buffer(oa, "data", &rec->data);
+    rc = rc < 0 ? rc : jute_encode_Stat(oa, &rec->stat);
+    rc = rc < 0 ? rc : oa->serialize_Int(oa, "flags", &rec->flags);
+    if (rc == 0 && write_int32(fp, get_buffer_len(oa)) == ZK_OK &&
+        fwrite(get_buffer(oa), get_buffer_len(oa), 1, fp) == 1) {
+        rc = ZK_OK;
+    } else {
+        rc = ZK_ERROR;
+    }
+    close_buffer_oarchive(&oa, 1);
+    return rc;
+}
+
+// a zero length record marks the end of the stream, so truncated files are
+// told apart from complete ones.
+int export_write_trailer(FILE *fp) {
+    return write_int32(fp, 0);
+}
+
+// export_read_record returns 1 and fills rec while there are records left,
+// 0 at the trailer and ZK_ERROR on a corrupt or truncated stream.
+int export_read_record(FILE *fp, struct export_record *rec) {
+    int rc;
+    int32_t len;
+    char *buf;
+    struct iarchive *ia;
+
+    memset(rec, 0, sizeof(*rec));
+    if (read_int32(fp, &len) != ZK_OK || len < 0) return ZK_ERROR;
+    if (len == 0) return 0;
+    if (!(buf = malloc(len))) return ZK_ERROR;
+    if (fread(buf, len, 1, fp) != 1 || !(ia = create_buffer_iarchive(buf, len))) {
+        free(buf);
+        return ZK_ERROR;
+    }
+    rc = ia->deserialize_String(ia, "path", &rec->path);
+    rc = rc < 0 ? rc : ia->deserialize_Buffer(ia, "data", &rec->data);
+    rc = rc < 0 ? rc : jute_decode_Stat(ia, &rec->stat);
+    rc = rc < 0 ? rc : ia->deserialize_Int(ia, "flags", &rec->flags);
+    close_buffer_iarchive(&ia);
+    free(buf);
+    if (rc < 0) {
+        deallocate_export_record(rec);
+        return ZK_ERROR;
+    }
+    return 1;
+}
+
+void deallocate_export_record(struct export_record *rec) {
+    deallocate_String(&rec->path);
+    deallocate_Buffer(&rec->data);
+}
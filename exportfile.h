@@ -0,0 +1,26 @@
+#ifndef __EXPORTFILE_H_
+#define __EXPORTFILE_H_
+
+#include <stdio.h>
+#include "zkclient.h"
+
+#define EXPORT_MAGIC 0x5a4b4558 // "ZKEX"
+#define EXPORT_VERSION 1
+
+// export_record is one node of an exported subtree, path is relative to the
+// exported root, "" for the root itself. Records are streamed in pre-order,
+// so a parent always comes before its children.
+struct export_record {
+    char *path;
+    struct buffer data;
+    struct Stat stat;
+    int32_t flags;
+};
+
+int export_write_header(FILE *fp);
+int export_write_record(FILE *fp, struct export_record *rec);
+int export_write_trailer(FILE *fp);
+int export_read_header(FILE *fp);
+int export_read_record(FILE *fp, struct export_record *rec);
+void deallocate_export_record(struct export_record *rec);
+#endif
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+# Generates zookeeper.codec.h and zookeeper.codec.c, the direct codec for
+# every record in zookeeper.jute.c. Field order and types are taken from the
+# serialize_* functions there. Run `make codec` after regenerating the jute
+# sources.
+import re
+import sys
+
+SIZES = {"Int": 4, "Long": 8, "Bool": 1}
+
+def parse(src):
+    records, vectors = {}, {}
+    for m in re.finditer(r"int serialize_(\w+)\(struct oarchive \*out, const char \*tag, struct \w+ \*v\)\s*{(.*?)\n}", src, re.S):
+        name, body = m.group(1), m.group(2)
+        if name.endswith("_vector"):
+            elem = re.search(r"serialize_(\w+)\(out, \"\w+\", &v->data\[i\]\)", body).group(1)
+            vectors[name] = elem
+            continue
+        fields = []
+        for f in re.finditer(r"(out->)?serialize_(\w+)\(out, \"\w+\", &v->(\w+)\)", body):
+            fields.append((f.group(2), f.group(3)))
+        records[name] = fields
+    return records, vectors
+
+def fixed_size(records, kind):
+    if kind in SIZES:
+        return SIZES[kind]
+    if kind not in records:
+        return None
+    total = 0
+    for k, _ in records[kind]:
+        size = fixed_size(records, k)
+        if size is None:
+            return None
+        total += size
+    return total
+
+def flatten(records, kind, expr):
+    # expands a fixed size record into its primitive fields
+    if kind in SIZES:
+        return [(kind, expr)]
+    out = []
+    for k, f in records[kind]:
+        out += flatten(records, k, "%s.%s" % (expr, f) if expr else f)
+    return out
+
+def gen_fields(records, name, decode):
+    lines, run, run_size = [], [], 0
+    def flush():
+        nonlocal run, run_size
+        if not run:
+            return
+        if decode:
+            lines.append("    if (jneed(b, %d)) return -E2BIG;" % run_size)
+            for k, e in run:
+                lines.append("    v->%s = jget_%s(b);" % (e, k.lower()))
+        else:
+            lines.append("    if (jreserve(b, %d)) return -ENOMEM;" % run_size)
+            for k, e in run:
+                lines.append("    jput_%s(b, v->%s);" % (k.lower(), e))
+        run, run_size = [], 0
+    for kind, field in records[name]:
+        size = fixed_size(records, kind)
+        if size is not None:
+            run += flatten(records, kind, field)
+            run_size += size
+            continue
+        flush()
+        if kind in ("String", "Buffer"):
+            if decode:
+                lines.append("    if ((rc = jread_%s(b, &v->%s))) return rc;" % (kind.lower(), field))
+            elif kind == "String":
+                lines.append("    if ((rc = jwrite_string(b, v->%s))) return rc;" % field)
+            else:
+                lines.append("    if ((rc = jwrite_buffer(b, &v->%s))) return rc;" % field)
+        else:
+            lines.append("    if ((rc = %s_%s(b, &v->%s))) return rc;" % ("decode" if decode else "encode", kind, field))
+    flush()
+    return lines
+
+def gen_record(records, name, decode):
+    op = "decode" if decode else "encode"
+    body = gen_fields(records, name, decode)
+    out = ["static int %s_%s(struct buff_struct *b, struct %s *v) {" % (op, name, name)]
+    if any("rc = " in l for l in body):
+        out += ["    int rc;", ""]
+    out += body + ["    return 0;", "}", ""]
+    return out
+
+def gen_vector(name, elem, decode):
+    out = []
+    if decode:
+        out.append("static int decode_%s(struct buff_struct *b, struct %s *v) {" % (name, name))
+        out += ["    int rc;", "    int32_t i;", "",
+                "    v->data = NULL;",
+                "    if ((rc = jread_int(b, &v->count))) return rc;",
+                "    if (v->count <= 0) return 0;",
+                "    // every element takes at least a byte, a larger count is corrupt",
+                "    if (v->count > b->len - b->off) return -E2BIG;",
+                "    if (!(v->data = calloc(v->count, sizeof(*v->data)))) return -ENOMEM;",
+                "    for (i = 0; i < v->count; i++) {"]
+        if elem == "String":
+            out.append("        if ((rc = jread_string(b, &v->data[i]))) return rc;")
+        else:
+            out.append("        if ((rc = decode_%s(b, &v->data[i]))) return rc;" % elem)
+    else:
+        out.append("static int encode_%s(struct buff_struct *b, struct %s *v) {" % (name, name))
+        out += ["    int rc;", "    int32_t i;", "",
+                "    if ((rc = jwrite_int(b, v->count))) return rc;",
+                "    for (i = 0; i < v->count; i++) {"]
+        if elem == "String":
+            out.append("        if ((rc = jwrite_string(b, v->data[i]))) return rc;")
+        else:
+            out.append("        if ((rc = encode_%s(b, &v->data[i]))) return rc;" % elem)
+    out += ["    }", "    return 0;", "}", ""]
+    return out
+
+def gen_size(records, name):
+    fixed, terms = 0, []
+    for kind, field in records[name]:
+        size = fixed_size(records, kind)
+        if size is not None:
+            fixed += size
+        elif kind == "String":
+            fixed += 4
+            terms.append("(v->%s ? strlen(v->%s) : 0)" % (field, field))
+        elif kind == "Buffer":
+            fixed += 4
+            terms.append("(v->%s.len > 0 ? v->%s.len : 0)" % (field, field))
+        else:
+            terms.append("serialized_size_%s(&v->%s)" % (kind, field))
+    expr = " + ".join([str(fixed)] + terms) if terms else str(fixed)
+    return ["int32_t serialized_size_%s(struct %s *v) {" % (name, name),
+            "    return %s;" % expr, "}", ""]
+
+def gen_vector_size(name, elem):
+    out = ["int32_t serialized_size_%s(struct %s *v) {" % (name, name),
+           "    int32_t i, size = 4;", "",
+           "    for (i = 0; i < v->count; i++) {"]
+    if elem == "String":
+        out.append("        size += 4 + (v->data[i] ? strlen(v->data[i]) : 0);")
+    else:
+        out.append("        size += serialized_size_%s(&v->data[i]);" % elem)
+    out += ["    }", "    return size;", "}", ""]
+    return out
+
+def order(records, vectors):
+    # static helpers have to be defined before they are used
+    done, out = set(), []
+    def visit(name):
+        if name in done:
+            return
+        done.add(name)
+        deps = [vectors[name]] if name in vectors else [k for k, _ in records[name]]
+        for d in deps:
+            if d in records or d in vectors:
+                visit(d)
+        out.append(name)
+    for name in list(records) + list(vectors):
+        visit(name)
+    return out
+
+HEADER = """/* generated by gen_codec.py from zookeeper.jute.c, do not edit. */
+"""
+
+def main():
+    src = open("zookeeper.jute.c").read()
+    records, vectors = parse(src)
+    names = order(records, vectors)
+
+    h = [HEADER, "#ifndef __ZOOKEEPER_CODEC__", "#define __ZOOKEEPER_CODEC__", "",
+         '#include "zookeeper.jute.h"', "",
+         "// jute_encode_* and jute_decode_* behave like serialize_* and deserialize_*",
+         "// but read and write buffer archives directly, other archives fall back",
+         "// to the generic functions. serialized_size_* returns the exact number of",
+         "// bytes a record encodes to.", ""]
+    for n in names:
+        h.append("int32_t serialized_size_%s(struct %s *v);" % (n, n))
+    h.append("")
+    for n in names:
+        h.append("int jute_encode_%s(struct oarchive *out, struct %s *v);" % (n, n))
+        h.append("int jute_decode_%s(struct iarchive *in, struct %s *v);" % (n, n))
+    h += ["#endif", ""]
+
+    c = [HEADER, '#include "codec.h"', '#include "zookeeper.codec.h"', ""]
+    for n in names:
+        c += gen_vector_size(n, vectors[n]) if n in vectors else gen_size(records, n)
+    for n in names:
+        if n in vectors:
+            c += gen_vector(n, vectors[n], False) + gen_vector(n, vectors[n], True)
+        else:
+            c += gen_record(records, n, False) + gen_record(records, n, True)
+    for n in names:
+        c += ["int jute_encode_%s(struct oarchive *out, struct %s *v) {" % (n, n),
+              "    if (!is_buffer_oarchive(out)) return serialize_%s(out, \"\", v);" % n,
+              "    return encode_%s(out->priv, v);" % n, "}", "",
+              "int jute_decode_%s(struct iarchive *in, struct %s *v) {" % (n, n),
+              "    if (!is_buffer_iarchive(in)) return deserialize_%s(in, \"\", v);" % n,
+              "    return decode_%s(in->priv, v);" % n, "}", ""]
+    open("zookeeper.codec.h", "w").write("\n".join(h))
+    open("zookeeper.codec.c", "w").write("\n".join(c).rstrip("\n") + "\n")
+
+if __name__ == "__main__":
+    sys.exit(main())
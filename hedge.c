@@ -0,0 +1,98 @@
+#include <string.h>
+
+#include "hedge.h"
+
+// the histogram is halved once it holds this many samples, so it follows
+// the recent latencies
+#define HEDGE_DECAY (1 << 14)
+// hedges that may be spent in a row after a quiet period
+#define HEDGE_BURST 10
+
+void hedge_init(struct zk_hedge *h) {
+    pthread_mutex_init(&h->lock, NULL);
+    h->percentile = 0;
+    h->max_pct = 0;
+    h->budget = 0;
+    h->samples = 0;
+    memset(h->buckets, 0, sizeof(h->buckets));
+}
+
+void hedge_destroy(struct zk_hedge *h) {
+    pthread_mutex_destroy(&h->lock);
+}
+
+void hedge_configure(struct zk_hedge *h, int percentile, int max_pct) {
+    pthread_mutex_lock(&h->lock);
+    h->percentile = percentile;
+    h->max_pct = max_pct;
+    h->budget = 0;
+    pthread_mutex_unlock(&h->lock);
+}
+
+static int bucket_of(int64_t v) {
+    int p;
+
+    if (v < 4) return v > 0 ? v : 0;
+    p = 63 - __builtin_clzll(v);
+    if (p > 32) return HEDGE_BUCKETS - 1;
+    return (p - 1) * 4 + ((v >> (p - 2)) & 3);
+}
+
+// bucket_end returns the smallest latency above bucket i
+static int64_t bucket_end(int i) {
+    if (i < 4) return i + 1;
+    return (int64_t)(4 + i % 4 + 1) << (i / 4 - 1);
+}
+
+// hedge_observe records the latency of a read in microseconds, every read
+// also earns max_pct hundredths of a hedge.
+void hedge_observe(struct zk_hedge *h, int64_t latency) {
+    int i;
+
+    pthread_mutex_lock(&h->lock);
+    h->buckets[bucket_of(latency)]++;
+    if (++h->samples >= HEDGE_DECAY) {
+        h->samples = 0;
+        for (i = 0; i < HEDGE_BUCKETS; i++) {
+            h->buckets[i] /= 2;
+            h->samples += h->buckets[i];
+        }
+    }
+    h->budget += h->max_pct / 100.0;
+    if (h->budget > HEDGE_BURST) h->budget = HEDGE_BURST;
+    pthread_mutex_unlock(&h->lock);
+}
+
+// hedge_delay returns the latency at the percentile in microseconds, or 0
+// while there are too few samples to tell.
+int64_t hedge_delay(struct zk_hedge *h) {
+    int i;
+    uint32_t rank, seen = 0;
+    int64_t delay = 0;
+
+    pthread_mutex_lock(&h->lock);
+    if (h->percentile > 0 && h->samples >= HEDGE_MIN_SAMPLES) {
+        rank = (uint64_t)h->samples * h->percentile / 100;
+        for (i = 0; i < HEDGE_BUCKETS; i++) {
+            seen += h->buckets[i];
+            if (seen > rank) break;
+        }
+        delay = bucket_end(i < HEDGE_BUCKETS ? i : HEDGE_BUCKETS - 1);
+    }
+    pthread_mutex_unlock(&h->lock);
+    return delay;
+}
+
+// hedge_take spends one hedge from the budget, it returns 0 when the cap
+// is reached.
+int hedge_take(struct zk_hedge *h) {
+    int ok = 0;
+
+    pthread_mutex_lock(&h->lock);
+    if (h->budget >= 1) {
+        h->budget -= 1;
+        ok = 1;
+    }
+    pthread_mutex_unlock(&h->lock);
+    return ok;
+}
@@ -0,0 +1,29 @@
+#ifndef __HEDGE_H_
+#define __HEDGE_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define HEDGE_BUCKETS 128
+#define HEDGE_MIN_SAMPLES 64
+
+// zk_hedge decides when a read is sent to a second session. It keeps a
+// decaying histogram of read latencies, a read still unanswered at the
+// chosen percentile of it is hedged. Hedges are capped at max_pct per 100
+// reads, so a slow ensemble doesn't see its read load doubled.
+struct zk_hedge {
+    pthread_mutex_t lock;
+    int percentile; // 0 disables hedging
+    int max_pct;
+    double budget;
+    uint32_t samples;
+    uint32_t buckets[HEDGE_BUCKETS]; // 4 per power of two microseconds
+};
+
+void hedge_init(struct zk_hedge *h);
+void hedge_destroy(struct zk_hedge *h);
+void hedge_configure(struct zk_hedge *h, int percentile, int max_pct);
+void hedge_observe(struct zk_hedge *h, int64_t latency);
+int64_t hedge_delay(struct zk_hedge *h);
+int hedge_take(struct zk_hedge *h);
+#endif
@@ -5,6 +5,7 @@
 #include <assert.h>
 #include "util.h"
 #include "request.h"
+#include "export.h"
 #include "zkclient.h"
 #include "cJSON/cJSON.h"
 #include "linenoise/linenoise.h"
@@ -18,6 +19,8 @@
 #define STAT_CMD "stat"
 #define DEL_CMD  "del" 
 #define MKDIR_CMD  "mkdir" 
+#define EXPORT_CMD "export"
+#define IMPORT_CMD "import"
 
 #define PROMPT "zkclient> "
 #define HISTORY_FILE_PATH "/tmp/.zkclient_history.txt"
@@ -34,13 +37,14 @@ const char * commands[] = {
     DEL_CMD,
     STAT_CMD,
     MKDIR_CMD,
+    EXPORT_CMD,
+    IMPORT_CMD,
     QUIT_CMD
 };
 
 static int check_reconnect(zk_client *c) {
-    switch (c->last_err) {
+    switch (zk_last_error(c)) {
         case ZSYSTEMERROR:
-        case ZOPERATIONTIMEOUT:
         case ZINVALIDSTATE:
         case ZSESSIONEXPIRED:
         case ZINVALIDACL:
@@ -68,7 +72,7 @@ static void path_completion(zk_client *c, const char *buf, int len, linenoiseCom
     int i, j, lastSpacePos, lastSlashPos, status, pathLen, dataLen;
     char *path = NULL;
     char *completion_buf;
-    struct String_vector childrens= {0, NULL};
+    struct zk_children *childrens = NULL;
     
     i = j = len - 1;
     // index of ' ' or '\t' from the end
@@ -90,12 +94,12 @@ static void path_completion(zk_client *c, const char *buf, int len, linenoiseCom
     path[pathLen] = '\0';
     // remove last '/' in path if exist, path like '/admin/' isn't allowed, we should trim it as /admin.
     if (pathLen > 1 && path[pathLen-1] == '/')  path[pathLen -1] = '\0';
-    status = zk_get_children(c, path, &childrens);
+    status = zk_get_children_packed(c, path, &childrens);
     if ( status != ZOK) goto cleanup;
 
-    for (i = 0; i < childrens.count; ++i) {
-        if (strncmp(buf + lastSlashPos + 1, childrens.data[i], len - lastSlashPos -1) == 0) {
-            linenoiseAddCompletion(lc, childrens.data[i]); 
+    for (i = 0; i < childrens->count; ++i) {
+        if (strncmp(buf + lastSlashPos + 1, zk_child(childrens, i), len - lastSlashPos -1) == 0) {
+            linenoiseAddCompletion(lc, zk_child(childrens, i)); 
         }
     }
     // tricks: if there's only one element, we should copy user input buffer to completion.
@@ -112,7 +116,7 @@ static void path_completion(zk_client *c, const char *buf, int len, linenoiseCom
 
  cleanup:
     free(path);
-    deallocate_String_vector(&childrens);
+    free(childrens);
 }
 
 void completion(const char *buf, linenoiseCompletions *lc) {
@@ -154,7 +158,7 @@ static int getCommand(zk_client *c, char *path) {
 ERR:
     printf("get %s failed, %s.\n", path, zk_error(c));
     deallocate_Buffer(&data);
-    return c->last_err;
+    return zk_last_error(c);
 }
 
 static int createCommand(zk_client *c, char *path, char *buf, int len) {
@@ -163,7 +167,7 @@ static int createCommand(zk_client *c, char *path, char *buf, int len) {
         return ZK_OK;
     } else {
         printf("create %s failed, %s.\n", path, zk_error(c));
-        return c->last_err;
+        return zk_last_error(c);
     }
 }
 
@@ -174,24 +178,56 @@ static int mkdirCommand(zk_client *c, char *path) {
         return ZK_OK;
     } else {
         printf("mkdir %s failed, %s.\n", path, zk_error(c));
-        return c->last_err;
+        return zk_last_error(c);
+    }
+}
+
+// export and import move whole trees, so they run in the bulk lane
+static int exportCommand(zk_client *c, char *path, char *file) {
+    int rc;
+
+    zk_set_lane(ZK_LANE_BULK);
+    rc = zk_export(c, path, file);
+    zk_set_lane(ZK_LANE_INTERACTIVE);
+    if (rc == ZK_OK) {
+        printf("export %s to %s success.\n", path, file);
+        return ZK_OK;
+    } else {
+        printf("export %s failed, %s.\n", path, zk_error(c));
+        return zk_last_error(c);
+    }
+}
+
+static int importCommand(zk_client *c, char *file, char *path) {
+    int rc;
+
+    zk_set_lane(ZK_LANE_BULK);
+    rc = zk_import(c, file, path);
+    zk_set_lane(ZK_LANE_INTERACTIVE);
+    if (rc == ZK_OK) {
+        printf("import %s to %s success.\n", file, path);
+        return ZK_OK;
+    } else {
+        printf("import %s failed, %s.\n", file, zk_error(c));
+        return zk_last_error(c);
     }
 }
 
 static int lsCommand(zk_client *c, char *path) {
     int i, status;
+    char *frame;
     struct String_vector childs;
     
-    if ((status = zk_get_children(c, path, &childs)) != ZK_OK) {
+    if ((status = zk_get_children_view(c, path, &childs, &frame)) != ZK_OK) {
         printf("ls %s failed, %s.\n", path, zk_error(c));
-        return c->last_err;
+        return zk_last_error(c);
     }
 
     for (i = 0; i < childs.count; i++) {
         printf("%s\t", childs.data[i]);
     }
     if(childs.count > 0) printf("\n");
-    deallocate_String_vector(&childs);
+    zk_release_children_view(&childs, frame);
     return ZK_OK;
 }
 
@@ -214,7 +250,7 @@ static int statCommand(zk_client *c, char *path) {
     cJSON  *cjson;
 
     if(zk_exists(c, path, &stat) != 1) {
-        return c->last_err;
+        return zk_last_error(c);
     }
     cjson = cJSON_CreateObject();
     cJSON_AddNumberToObject(cjson, "version", stat.version);
@@ -246,7 +282,7 @@ static int setCommand(zk_client *c, char *path,
     data.len = len;
     if((status = zk_set(c, path, &data)) != ZK_OK) {
         printf("set %s failed, %s.\n", path, zk_error(c));
-        return c->last_err;
+        return zk_last_error(c);
     } else {
         printf("set %s success.\n", path);
         return ZK_OK;
@@ -258,7 +294,7 @@ static int delCommand(zk_client *c, char *path, int version) {
 
     if((status = zk_del(c, path)) != ZK_OK) {
         printf("del %s failed, %s.\n", path, zk_error(c));
-        return c->last_err;
+        return zk_last_error(c);
     } else {
         printf("del %s success.\n", path);
         return ZK_OK;
@@ -316,20 +352,22 @@ static void processCommand(zk_client *c, char **args, int narg) {
         if (narg < 2) goto ARGN_ERR;
         if (narg >= 3) version = atoi(args[2]);
         status = delCommand(c, path, version);
+    } else if (STRING_EQUAL(cmd, EXPORT_CMD)) {
+        if (narg < 3) goto ARGN_ERR;
+        status = exportCommand(c, path, args[2]);
+    } else if (STRING_EQUAL(cmd, IMPORT_CMD)) {
+        if (narg < 3) goto ARGN_ERR;
+        status = importCommand(c, path, args[2]);
     } else if (STRING_EQUAL(cmd, QUIT_CMD) || STRING_EQUAL(cmd, EXIT_CMD)) {
         quitCommand();
     } else {
         printf("%s\n", "Unkonwn command.");
     }
-    // reconnect
-    if (status == ZK_SOCKET_ERR || check_reconnect(c)) {
+    // the client reconnects by itself after a socket error, only a
+    // session that can't be used anymore is reset.
+    if (status != ZK_OK && check_reconnect(c)) {
+        logger(WARN, "Reset the session, %s.", zk_error(c));
         reset_zkclient(c);
-        if (do_connect(c) != ZK_OK) {
-            logger(ERROR, "Reconnect to zookeeper error, exited...");
-            exit(1);
-        } else {
-            logger(WARN, "Reconnect to zookeeper success.");
-        }
     }
     TIME_END();
     logger(DEBUG, "Process %s command cost %d ms", cmd, TIME_COST());
@@ -345,6 +383,7 @@ static void usage(const char *prog_name) {
     fprintf(stderr, "Usage: %s -z zookeeper\n", prog_name);
     fprintf(stderr, "\t-z default 127.0.0.1:2181, delimiter is comma\n");
     fprintf(stderr, "\t-d debug mode.\n");
+    fprintf(stderr, "\t-l write the log to this file instead of stdout.\n");
     fprintf(stderr, "\t-h help\n");
     fprintf(stderr, "\n\tsupport commands:\n");
     fprintf(stderr, "\t\tget path\n");
@@ -354,6 +393,8 @@ static void usage(const char *prog_name) {
     fprintf(stderr, "\t\tset path data\n");
     fprintf(stderr, "\t\tdel path\n");
     fprintf(stderr, "\t\tstat path\n");
+    fprintf(stderr, "\t\texport path file\n");
+    fprintf(stderr, "\t\timport file path\n");
     exit(0);
 }
 
@@ -361,10 +402,11 @@ int main(int argc, char **argv) {
     char *line, **args, *zk_list = NULL;
     int ch, narg, show_usage = 0;
 
-    while((ch = getopt(argc, argv, "z:dh")) != -1) {
+    while((ch = getopt(argc, argv, "z:dl:h")) != -1) {
         switch(ch) {
             case 'z': zk_list = optarg; break;
             case 'd': set_log_level(DEBUG); break;
+            case 'l': set_log_file(optarg); break;
             case 'h': show_usage = 1; break;
         }
     }
@@ -376,6 +418,12 @@ int main(int argc, char **argv) {
     quit = 0;
     srand(time(0));
     client = new_client(zk_list, 60, 3);
+    if (!client) {
+        logger(ERROR, "Create zookeeper client failed.");
+        exit(1);
+    }
+    // don't hang a command on a server that is gone for good
+    set_request_timeout(client, 10000);
 
     linenoiseHistoryLoad(HISTORY_FILE_PATH);
     linenoiseSetCompletionCallback(completion);
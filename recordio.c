@@ -39,13 +39,7 @@ void deallocate_Buffer(struct buffer *b)
     b->buff = 0;
 }
 
-struct buff_struct {
-    int32_t len;
-    int32_t off;
-    char *buffer;
-};
-
-static int resize_buffer(struct buff_struct *s, int newlen)
+int resize_buffer(struct buff_struct *s, int newlen)
 {
     char *buffer= NULL;
     while (s->len < newlen) {
@@ -280,6 +274,52 @@ int ia_deserialize_string(struct iarchive *ia, const char *name, char **s)
     return 0;
 }
 
+// view mode: buffers and strings point into the archive's buffer instead of
+// being copied, they stay valid as long as the buffer does and must not be
+// freed on their own.
+int ia_deserialize_buffer_view(struct iarchive *ia, const char *name,
+        struct buffer *b)
+{
+    struct buff_struct *priv = ia->priv;
+    int rc = ia_deserialize_int(ia, "len", &b->len);
+    if (rc < 0)
+        return rc;
+    if (b->len < -1) {
+        return -EINVAL;
+    }
+    if ((priv->len - priv->off) < b->len) {
+        return -E2BIG;
+    }
+    if (b->len == -1) {
+       b->buff = NULL;
+       return rc;
+    }
+    b->buff = priv->buffer+priv->off;
+    priv->off += b->len;
+    return 0;
+}
+int ia_deserialize_string_view(struct iarchive *ia, const char *name, char **s)
+{
+    struct buff_struct *priv = ia->priv;
+    int32_t len;
+    int rc = ia_deserialize_int(ia, "len", &len);
+    if (rc < 0)
+        return rc;
+    if ((priv->len - priv->off) < len) {
+        return -E2BIG;
+    }
+    if (len < 0) {
+        return -EINVAL;
+    }
+    // the string is moved over its length prefix to make room for the NUL,
+    // so a buffer can only be deserialized once in view mode.
+    *s = priv->buffer+priv->off-sizeof(len);
+    memmove(*s, priv->buffer+priv->off, len);
+    (*s)[len] = '\0';
+    priv->off += len;
+    return 0;
+}
+
 static struct iarchive ia_default = { STRUCT_INITIALIZER (start_record ,ia_start_record),
         STRUCT_INITIALIZER (end_record ,ia_end_record), STRUCT_INITIALIZER (start_vector , ia_start_vector),
         STRUCT_INITIALIZER (end_vector ,ia_end_vector), STRUCT_INITIALIZER (deserialize_Bool , ia_deserialize_bool),
@@ -309,23 +349,42 @@ struct iarchive *create_buffer_iarchive(char *buffer, int len)
     buff->off = 0;
     buff->buffer = buffer;
     buff->len = len;
+    buff->view = 0;
     ia->priv = buff;
     return ia;
 }
 
+struct iarchive *create_buffer_iarchive_view(char *buffer, int len)
+{
+    struct iarchive *ia = create_buffer_iarchive(buffer, len);
+    if (!ia) return 0;
+    ia->deserialize_Buffer = ia_deserialize_buffer_view;
+    ia->deserialize_String = ia_deserialize_string_view;
+    ((struct buff_struct *)ia->priv)->view = 1;
+    return ia;
+}
+
 struct oarchive *create_buffer_oarchive()
+{
+    return create_buffer_oarchive_sized(128);
+}
+
+// create_buffer_oarchive_sized allocates the buffer at its final size up
+// front, len comes from the serialized_size_* functions.
+struct oarchive *create_buffer_oarchive_sized(int len)
 {
     struct oarchive *oa = malloc(sizeof(*oa));
     struct buff_struct *buff = malloc(sizeof(struct buff_struct));
-    if (!oa) return 0;
-    if (!buff) {
+    if (len <= 0) len = 128;
+    if (!oa || !buff || !(buff->buffer = malloc(len))) {
         free(oa);
+        free(buff);
         return 0;
     }
     *oa = oa_default;
     buff->off = 0;
-    buff->buffer = malloc(128);
-    buff->len = 128;
+    buff->len = len;
+    buff->view = 0;
     oa->priv = buff;
     return oa;
 }
@@ -360,3 +419,8 @@ int get_buffer_len(struct oarchive *oa)
     struct buff_struct *buff = oa->priv;
     return buff->off;
 }
+int get_iarchive_offset(struct iarchive *ia)
+{
+    struct buff_struct *buff = ia->priv;
+    return buff->off;
+}
@@ -35,6 +35,16 @@ struct buffer {
     char *buff;
 };
 
+// buff_struct is the state behind the buffer archives, the codec in codec.h
+// reads and writes it directly. view is set for view mode iarchives.
+struct buff_struct {
+    int32_t len;
+    int32_t off;
+    char *buffer;
+    int view;
+};
+int resize_buffer(struct buff_struct *s, int newlen);
+
 void deallocate_String(char **s);
 void deallocate_Buffer(struct buffer *b);
 void deallocate_vector(void *d);
@@ -67,11 +77,16 @@ struct oarchive {
 };
 
 struct oarchive *create_buffer_oarchive(void);
+struct oarchive *create_buffer_oarchive_sized(int len);
 void close_buffer_oarchive(struct oarchive **oa, int free_buffer);
 struct iarchive *create_buffer_iarchive(char *buffer, int len);
+struct iarchive *create_buffer_iarchive_view(char *buffer, int len);
 void close_buffer_iarchive(struct iarchive **ia);
+int ia_start_record(struct iarchive *ia, const char *tag);
+int oa_start_record(struct oarchive *oa, const char *tag);
 char *get_buffer(struct oarchive *);
 int get_buffer_len(struct oarchive *);
+int get_iarchive_offset(struct iarchive *);
 
 #if !defined(KERNEL) && (defined(_POSIX_C_SOURCE) && !defined(_DARWIN_C_SOURCE))
 int64_t htonll(int64_t v);
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // ppoll
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -7,163 +8,1783 @@
 #include <sys/uio.h>
 #include <poll.h>
 #include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <pthread.h>
 
 #include "request.h"
 #include "util.h"
 #include "conn.h"
 #include "zkclient.h"
 #include "zookeeper.jute.h"
-
-#define NOTIFY_OPCODE 0
-#define CREATE_OPCODE 1
-#define DELETE_OPCODE 2
-#define EXISTS_OPCODE 3
-#define GETDATA_OPCODE 4
-#define SETDATA_OPCODE 5
-#define GETACL_OPCODE 6
-#define SETACL_OPCODE 7
-#define GETCHILDREN_OPCODE 8
-#define SYNC_OPCODE 9
-#define PING_OPCODE 11
-#define GETCHILDREN2_OPCODE 12
-#define CHECK_OPCODE 13
-#define MULTI_OPCODE 14
-#define SETAUTH_OPCODE 100
-#define SETWATCHES_OPCODE 101
-#define CLOSE_OPCODE -11
+#include "zookeeper.codec.h"
+#include "codec.h"
+#include "uring.h"
 
 #define PROTOCOL_VERSION 0
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // SO_NOSIGPIPE is set on the socket instead
+#endif
 #define PERM_ALL 0x1f
 struct ACL acls[] = {
     {PERM_ALL, {"world", "anyone"}}
 };
 struct ACL_vector default_acl = {1, acls};
 
-static int32_t decode_int32(char *buf, int off) {
-    int32_t i32 = 0;
+// seen_zxid raises the last zxid of the session, it goes to the server on
+// reconnect, which refuses to serve a session that has seen a newer state.
+static void seen_zxid(zk_client *c, int64_t zxid) {
+    int64_t last = __atomic_load_n(&c->last_zxid, __ATOMIC_RELAXED);
 
-    i32 |= (uint8_t)buf[off] << 24;
-    i32 |= (uint8_t)buf[off+1] << 16;
-    i32 |= (uint8_t)buf[off+2] << 8;
-    i32 |= (uint8_t)buf[off+3] & 0xff;
-    return i32;
+    while (zxid > last && !__atomic_compare_exchange_n(&c->last_zxid, &last, zxid, 1,
+                __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
 }
 
-static int read_socket(int fd, char *buf, int len) {
+static int read_socket(int fd, char *buf, int len, int timeout) {
     int bytes, r_bytes = 0;
 
     while (r_bytes < len) {
         bytes = read(fd, buf + r_bytes, len - r_bytes);
-        r_bytes += bytes; 
         if (bytes == -1 &&
             (errno == EAGAIN || errno == EINTR || errno == EWOULDBLOCK)) {
+            // the rest of a frame may still be on the wire, pipelined
+            // replies in particular, so wait for it instead of spinning.
+            if (errno != EINTR && wait_socket(fd, timeout, CR_READ) != ZK_OK) {
+                return ZK_SOCKET_ERR;
+            }
             continue;
         }
-        if (bytes == 0) {
-            // close
-            close(fd);
+        if (bytes <= 0) {
+            // closed by the server, do_connect owns the socket
             return ZK_SOCKET_ERR;
         }
+        r_bytes += bytes; 
     }
     return ZK_OK;
 }
 
-static int send_request(zk_client *c, struct oarchive *oa) {
-    int rc, len, w_bytes, bytes;
+// fill_frames fills in the length prefixes of n frames and points iov at them
+static void fill_frames(struct oarchive **oas, int n, struct iovec *iov) {
+    int i, len;
     char *buf;
+
+    for (i = 0; i < n; i++) {
+        len = get_buffer_len(oas[i]);
+        buf = get_buffer(oas[i]);
+        store_be32(buf, len - 4);
+        iov[i].iov_base = buf;
+        iov[i].iov_len = len;
+    }
+}
+
+// send_buffer holds the bytes the I/O thread couldn't write yet, frames
+// written later queue behind them so the server sees them in order.
+struct send_buffer {
+    char *buf;
+    int len;
+    int off;
+    int cap;
+};
+
+static int buffer_append(struct send_buffer *out, const char *data, int n) {
+    int cap;
+    char *buf;
+
+    if (out->off > 0 && out->len + n > out->cap) {
+        memmove(out->buf, out->buf + out->off, out->len - out->off);
+        out->len -= out->off;
+        out->off = 0;
+    }
+    if (out->len + n > out->cap) {
+        cap = out->cap ? out->cap : 4096;
+        while (cap < out->len + n) cap *= 2;
+        if (!(buf = realloc(out->buf, cap))) return ZK_ERROR;
+        out->buf = buf;
+        out->cap = cap;
+    }
+    memcpy(out->buf + out->len, data, n);
+    out->len += n;
+    return ZK_OK;
+}
+
+// flush_requests writes as much of out as the socket takes right now
+static int flush_requests(zk_client *c, struct send_buffer *out) {
+    ssize_t bytes;
+
+    while (out->off < out->len) {
+        bytes = send(c->sock, out->buf + out->off, out->len - out->off, MSG_NOSIGNAL);
+        if (bytes == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return ZK_OK;
+            set_last_error(ZK_SOCKET_ERR);
+            return ZK_SOCKET_ERR;
+        }
+        out->off += bytes;
+    }
+    out->off = out->len = 0;
+    return ZK_OK;
+}
+
+// send_requests writes n frames back-to-back with a single sendmsg, so a
+// burst costs a single round trip to the server. Every frame starts with
+// the length prefix new_frame reserved, it is filled in here. It never
+// waits for the socket: what the kernel buffer doesn't take is copied to
+// out, so the frames may be freed once it returns.
+static int send_requests(zk_client *c, struct send_buffer *out, struct oarchive **oas, int n) {
+    int rc = ZK_SOCKET_ERR, cnt, bytes;
+    struct iovec *iov, *pos;
+    struct msghdr msg;
+    
+    iov = malloc(sizeof(*iov) * n);
+    if (!iov) { // out of memory
+        set_last_error(ZK_ERROR);
+        return ZK_ERROR;
+    }
+
+    TIME_START();
+    fill_frames(oas, n, iov);
+    pos = iov;
+    cnt = n;
+    memset(&msg, 0, sizeof(msg));
+    while (cnt > 0 && out->off == out->len) {
+        msg.msg_iov = pos;
+        msg.msg_iovlen = cnt < IOV_MAX ? cnt : IOV_MAX;
+        bytes = sendmsg(c->sock, &msg, MSG_NOSIGNAL);
+        if (bytes == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno != EINTR) goto cleanup;
+            continue;
+        }
+        while (cnt > 0 && (size_t)bytes >= pos->iov_len) {
+            bytes -= pos->iov_len;
+            pos++;
+            cnt--;
+        }
+        if (cnt > 0) {
+            pos->iov_base = (char *)pos->iov_base + bytes;
+            pos->iov_len -= bytes;
+        }
+    }
+    for (; cnt > 0; pos++, cnt--) {
+        if (buffer_append(out, pos->iov_base, pos->iov_len) != ZK_OK) {
+            rc = ZK_ERROR;
+            goto cleanup;
+        }
+    }
+    free(iov);
+    TIME_END();
+    return ZK_OK;
+
+cleanup:
+    free(iov);
+    set_last_error(rc);
+    TIME_END();
+    return rc;
+}
+
+// send_request writes one frame and waits until it's written, only the
+// handshake does so, before the I/O thread owns the socket.
+static int send_request(zk_client *c, struct oarchive *oa) {
+    int rc;
+    struct send_buffer out = {NULL, 0, 0, 0};
+
+    rc = send_requests(c, &out, &oa, 1);
+    while (rc == ZK_OK && out.off < out.len) {
+        rc = wait_socket(c->sock, c->write_timeout, CR_WRITE);
+        if (rc == ZK_OK) rc = flush_requests(c, &out);
+    }
+    free(out.buf);
+    return rc;
+}
+
+// new_frame allocates a frame of len bytes plus its length prefix, so the
+// request is written without a single realloc.
+static struct oarchive *new_frame(int32_t len) {
+    int32_t prefix = 0;
+    struct oarchive *oa;
+
+    if (!(oa = create_buffer_oarchive_sized(4 + len))) return NULL;
+    if (oa->serialize_Int(oa, "len", &prefix) < 0) {
+        close_buffer_oarchive(&oa, 1);
+        return NULL;
+    }
+    return oa;
+}
+
+// new_request returns a frame holding the request header, sized for a body
+// of body_size bytes which the caller encodes next.
+static struct oarchive *new_request(int opcode, int32_t body_size) {
+    struct oarchive *oa;
+    struct RequestHeader header = {PING_OPCODE == opcode ? -2 : get_xid(), opcode};
+
+    oa = new_frame(serialized_size_RequestHeader(&header) + body_size);
+    if (oa && jute_encode_RequestHeader(oa, &header) < 0) {
+        close_buffer_oarchive(&oa, 1);
+    }
+    return oa;
+}
+
+static int decode_reply_header(zk_client *c, struct iarchive *ia) {
+    int rc, err;
+    struct ReplyHeader reply_header;
+
+    rc = jute_decode_ReplyHeader(ia, &reply_header);
+    if (rc < 0) {
+        err = ZK_ERROR;
+    } else {
+        err = reply_header.err;
+        seen_zxid(c, reply_header.zxid);
+    }
+    set_last_error(err);
+    return err;
+}
+
+// recv_frame waits for a whole frame, only the handshake reads this way
+static char *recv_frame(zk_client *c, int *len) {
+    int rc;
+    char buf[4], *recv_buf;
     
-    len = get_buffer_len(oa);
-    buf = malloc(len + 4);
-    if (!buf) { // out of memory
-        c->last_err = ZK_ERROR;
+    TIME_START();
+    rc = wait_socket(c->sock, c->read_timeout, CR_READ);
+    if(rc != ZK_OK) {
+        set_last_error(rc);
+        TIME_END();
+        return NULL;
+    }
+
+    rc = read_socket(c->sock, buf, 4, c->read_timeout);
+    if (rc != ZK_OK) {
+        set_last_error(rc);
+        return NULL;
+    }
+
+    *len = (int32_t)load_be32(buf);
+    recv_buf = malloc(*len);
+    rc = read_socket(c->sock, recv_buf, *len, c->read_timeout);
+    if (rc != ZK_OK) {
+        set_last_error(rc);
+        free(recv_buf);
+        return NULL;
+    }
+
+    TIME_END();
+    return recv_buf;
+}
+
+struct iarchive *recv_response(zk_client *c) {
+    int len;
+    char *buf;
+
+    if (!(buf = recv_frame(c, &len))) return NULL;
+    return create_buffer_iarchive(buf, len);
+}
+
+static void destory_archive(struct oarchive *oa, struct iarchive *ia) {
+    if (oa) close_buffer_oarchive(&oa, 1); 
+    if (ia) {
+        free(((struct buff_struct *)(ia->priv))->buffer);
+        close_buffer_iarchive(&ia);
+    }
+}
+
+// Requests don't hold the connection while they wait for their replies.
+// Callers push their frames as zk_calls onto c->submitted, a lock-free
+// stack, and the I/O thread takes the whole stack at once, writes the
+// frames with a single writev and matches the replies, which the server
+// sends in request order, against the calls in flight. Every caller waits
+// on its own call, so callers never block each other.
+
+struct zk_call;
+typedef void (*call_fn)(struct zk_call *call, char *frame, int len, int err);
+
+// on_done, when set, takes the reply instead of a waiting caller
+struct zk_call {
+    struct zk_call *next;
+    struct oarchive *oa;
+    int32_t xid;
+    int lane;
+    int64_t deadline; // ms, 0 is none
+    char *frame;
+    int len;
+    int err;
+    int done;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    call_fn on_done;
+    void *arg;
+};
+
+// hedged_read is one read sent to up to two sessions, the first answer
+// wins. Every call holds a reference and so does the caller, whoever drops
+// the last one frees it, a late call may outlive the caller.
+struct hedged_read {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int refs;
+    int pending; // calls not completed yet
+    int done;
+    int winner; // index of the call that answered
+    int sent;
+    int stale; // replies dropped for coming from behind min_zxid
+    char *frame;
+    int len;
+    int err;
+    int64_t min_zxid; // last zxid the client had seen at submit time
+    zk_client *sessions[2];
+    struct oarchive *oas[2]; // private copies of the request frame
+    struct zk_call calls[2];
+};
+
+// inflight_slot is a request written to the server. A call that outlives
+// its deadline is completed right away and leaves its slot behind with
+// call set to NULL, so the late reply still matches by xid and is dropped.
+struct inflight_slot {
+    int32_t xid;
+    int bulk;
+    int64_t sent; // us
+    struct zk_call *call;
+};
+
+// call_timer is a deadline in the timer heap, seq is the sequence number
+// of the slot it expires.
+struct call_timer {
+    int64_t deadline;
+    uint64_t seq;
+};
+
+// the lane of the requests issued by this thread, see zk_set_lane
+static __thread int current_lane = ZK_LANE_INTERACTIVE;
+
+// call_queue holds calls that aren't written yet
+struct call_queue {
+    struct zk_call *head;
+    struct zk_call *tail;
+    int count;
+    int64_t deadline; // no later than the earliest deadline in the queue
+};
+
+// call_fifo holds the requests in flight in the order they were written,
+// and a min-heap of the deadlines of the calls among them. Bulk calls wait
+// in bulk while bulk_depth of them are in flight already.
+struct call_fifo {
+    struct inflight_slot *slots;
+    int head;
+    int count;
+    int cap;
+    uint64_t popped; // sequence number of the head slot
+    struct call_timer *timers;
+    int ntimers;
+    int timers_cap;
+    struct call_queue bulk;
+    int bulk_inflight;
+    struct send_buffer out; // the poll loop's unwritten bytes
+};
+
+static void free_hedged_read(struct hedged_read *h) {
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (!h->oas[i]) continue;
+        close_buffer_oarchive(&h->oas[i], 1);
+        pthread_mutex_destroy(&h->calls[i].lock);
+        pthread_cond_destroy(&h->calls[i].cond);
+    }
+    free(h->frame);
+    pthread_mutex_destroy(&h->lock);
+    pthread_cond_destroy(&h->cond);
+    free(h);
+}
+
+// complete_hedged settles a hedged read with the first reply, or with the
+// error of the last call when none of them got one.
+static void complete_hedged(struct zk_call *call, char *frame, int len, int err) {
+    int refs, stale = 0;
+    struct hedged_read *h = call->arg;
+
+    // a server behind the state the client has seen mustn't answer, on
+    // either session, the read goes to the other session instead
+    if (err == ZK_OK && (len < 12 || (int64_t)load_be64(frame + 4) < h->min_zxid)) {
+        free(frame);
+        frame = NULL;
+        len = 0;
+        err = ZK_ERROR;
+        stale = 1;
+    }
+    pthread_mutex_lock(&h->lock);
+    h->pending--;
+    if (stale) {
+        h->stale++;
+        pthread_cond_signal(&h->cond);
+    }
+    if (!h->done && (err == ZK_OK || (h->pending == 0 && (!stale || h->sent == 2)))) {
+        h->done = 1;
+        h->winner = call - h->calls;
+        h->frame = frame;
+        h->len = len;
+        h->err = err;
+        frame = NULL;
+        pthread_cond_signal(&h->cond);
+    }
+    refs = --h->refs;
+    pthread_mutex_unlock(&h->lock);
+    free(frame);
+    if (refs == 0) free_hedged_read(h);
+}
+
+static void complete_call(struct zk_call *call, char *frame, int len, int err) {
+    if (call->on_done) {
+        call->on_done(call, frame, len, err);
+        return;
+    }
+    pthread_mutex_lock(&call->lock);
+    call->frame = frame;
+    call->len = len;
+    call->err = err;
+    call->done = 1;
+    pthread_cond_signal(&call->cond);
+    pthread_mutex_unlock(&call->lock);
+}
+
+static void fail_calls(struct zk_call *chain, int err) {
+    struct zk_call *next;
+
+    for (; chain; chain = next) {
+        next = chain->next;
+        complete_call(chain, NULL, 0, err);
+    }
+}
+
+static void queue_push(struct call_queue *q, struct zk_call *call) {
+    call->next = NULL;
+    if (q->tail) {
+        q->tail->next = call;
+    } else {
+        q->head = call;
+    }
+    q->tail = call;
+    q->count++;
+    if (call->deadline && (!q->deadline || call->deadline < q->deadline)) {
+        q->deadline = call->deadline;
+    }
+}
+
+static struct zk_call *queue_pop(struct call_queue *q) {
+    struct zk_call *call;
+
+    if (!(call = q->head)) return NULL;
+    if (!(q->head = call->next)) q->tail = NULL;
+    call->next = NULL;
+    q->count--;
+    return call;
+}
+
+// queue_take empties q and returns its calls as a chain
+static struct zk_call *queue_take(struct call_queue *q) {
+    struct zk_call *chain = q->head;
+
+    q->head = q->tail = NULL;
+    q->count = 0;
+    q->deadline = 0;
+    return chain;
+}
+
+// queue_expire fails the queued calls whose deadline has passed
+static void queue_expire(struct call_queue *q, int64_t now) {
+    struct zk_call *call, *prev = NULL, *next;
+
+    if (!q->deadline || q->deadline > now) return;
+    q->deadline = 0;
+    for (call = q->head; call; call = next) {
+        next = call->next;
+        if (call->deadline && call->deadline <= now) {
+            if (prev) {
+                prev->next = next;
+            } else {
+                q->head = next;
+            }
+            if (q->tail == call) q->tail = prev;
+            q->count--;
+            complete_call(call, NULL, 0, ZOPERATIONTIMEOUT);
+            continue;
+        }
+        if (call->deadline && (!q->deadline || call->deadline < q->deadline)) {
+            q->deadline = call->deadline;
+        }
+        prev = call;
+    }
+}
+
+static int timer_push(struct call_fifo *f, int64_t deadline, uint64_t seq) {
+    int i, parent, cap;
+    struct call_timer *timers, t = {deadline, seq};
+
+    if (f->ntimers == f->timers_cap) {
+        cap = f->timers_cap ? f->timers_cap * 2 : 64;
+        if (!(timers = realloc(f->timers, sizeof(*timers) * cap))) return ZK_ERROR;
+        f->timers = timers;
+        f->timers_cap = cap;
+    }
+    for (i = f->ntimers++; i > 0; i = parent) {
+        parent = (i - 1) / 2;
+        if (f->timers[parent].deadline <= deadline) break;
+        f->timers[i] = f->timers[parent];
+    }
+    f->timers[i] = t;
+    return ZK_OK;
+}
+
+static void timer_pop(struct call_fifo *f) {
+    int i, child;
+    struct call_timer last;
+
+    last = f->timers[--f->ntimers];
+    for (i = 0; (child = 2 * i + 1) < f->ntimers; i = child) {
+        if (child + 1 < f->ntimers &&
+                f->timers[child + 1].deadline < f->timers[child].deadline) {
+            child++;
+        }
+        if (last.deadline <= f->timers[child].deadline) break;
+        f->timers[i] = f->timers[child];
+    }
+    if (f->ntimers > 0) f->timers[i] = last;
+}
+
+// next_deadline returns the earliest deadline of a call in flight, or 0.
+// Timers of calls that already got their replies are dropped on the way.
+static int64_t next_deadline(struct call_fifo *f) {
+    while (f->ntimers > 0 && f->timers[0].seq < f->popped) timer_pop(f);
+    return f->ntimers > 0 ? f->timers[0].deadline : 0;
+}
+
+// expire_calls completes the calls in flight whose deadline has passed
+static void expire_calls(struct call_fifo *f, int64_t now) {
+    int64_t deadline;
+    struct inflight_slot *slot;
+
+    while ((deadline = next_deadline(f)) && deadline <= now) {
+        slot = &f->slots[(f->head + (f->timers[0].seq - f->popped)) % f->cap];
+        timer_pop(f);
+        if (slot->call) {
+            complete_call(slot->call, NULL, 0, ZOPERATIONTIMEOUT);
+            slot->call = NULL;
+        }
+    }
+}
+
+// fifo_push appends a request with xid, call is NULL for a request the
+// I/O thread issued on its own.
+static int fifo_push(struct call_fifo *f, int32_t xid, struct zk_call *call, int64_t sent) {
+    int i, cap;
+    struct inflight_slot *slots, *slot;
+
+    if (f->count == f->cap) {
+        cap = f->cap ? f->cap * 2 : 64;
+        if (!(slots = malloc(sizeof(*slots) * cap))) return ZK_ERROR;
+        for (i = 0; i < f->count; i++) {
+            slots[i] = f->slots[(f->head + i) % f->cap];
+        }
+        free(f->slots);
+        f->slots = slots;
+        f->head = 0;
+        f->cap = cap;
+    }
+    if (call && call->deadline &&
+            timer_push(f, call->deadline, f->popped + f->count) != ZK_OK) {
+        return ZK_ERROR;
+    }
+    slot = &f->slots[(f->head + f->count++) % f->cap];
+    slot->xid = xid;
+    slot->bulk = call && call->lane == ZK_LANE_BULK;
+    slot->sent = sent;
+    slot->call = call;
+    f->bulk_inflight += slot->bulk;
+    return ZK_OK;
+}
+
+static int fifo_pop(struct call_fifo *f, struct inflight_slot *slot) {
+    if (f->count == 0) return 0;
+    *slot = f->slots[f->head];
+    f->head = (f->head + 1) % f->cap;
+    f->count--;
+    f->popped++;
+    f->bulk_inflight -= slot->bulk;
+    return 1;
+}
+
+static void fifo_fail(struct call_fifo *f, int err) {
+    struct inflight_slot slot;
+
+    while (fifo_pop(f, &slot)) {
+        if (slot.call) complete_call(slot.call, NULL, 0, err);
+    }
+    f->ntimers = 0;
+}
+
+// burst_lane returns the lane of a burst, pings and closes are control
+// traffic and a burst with a frame too large for the interactive lane is
+// bulk. The lane is picked for the burst as a whole, the frames of a lane
+// are written in order, so a burst is never reordered.
+static int burst_lane(struct oarchive **oas, int n, int lane) {
+    int i, opcode = (int32_t)load_be32(get_buffer(oas[0]) + 8);
+
+    if (n == 1 && (opcode == PING_OPCODE || opcode == CLOSE_OPCODE)) return ZK_LANE_CONTROL;
+    for (i = 0; i < n; i++) {
+        if (get_buffer_len(oas[i]) > BULK_FRAME_SIZE) return ZK_LANE_BULK;
+    }
+    return lane;
+}
+
+// submit_calls pushes the n calls onto the submission stack with a single
+// CAS, so a pipelined burst stays contiguous and in one lane, and wakes the
+// I/O thread if the stack was empty.
+static int submit_calls(zk_client *c, struct zk_call *calls, struct oarchive **oas,
+        int n, int lane, int64_t deadline, call_fn on_done, void *arg) {
+    int i;
+    char wake = 1;
+    struct zk_call *head;
+
+    lane = burst_lane(oas, n, lane);
+    for (i = 0; i < n; i++) {
+        calls[i].oa = oas[i];
+        calls[i].xid = (int32_t)load_be32(get_buffer(oas[i]) + 4);
+        calls[i].lane = lane;
+        calls[i].deadline = deadline;
+        calls[i].frame = NULL;
+        calls[i].err = ZK_OK;
+        calls[i].done = 0;
+        calls[i].on_done = on_done;
+        calls[i].arg = arg;
+        pthread_mutex_init(&calls[i].lock, NULL);
+        pthread_cond_init(&calls[i].cond, NULL);
+        // the stack is reversed when it is taken, so link the burst backwards
+        calls[i].next = i > 0 ? &calls[i - 1] : NULL;
+    }
+    head = __atomic_load_n(&c->submitted, __ATOMIC_RELAXED);
+    do {
+        if (head == IO_CLOSED) {
+            for (i = 0; i < n; i++) calls[i].next = NULL;
+            for (i = 0; i < n; i++) complete_call(&calls[i], NULL, 0, ZK_SOCKET_ERR);
+            return ZK_SOCKET_ERR;
+        }
+        calls[0].next = head;
+    } while (!__atomic_compare_exchange_n(&c->submitted, &head, &calls[n - 1], 1,
+                __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    if (!head && write(c->io_pipe[1], &wake, 1) < 0) {
+        // the pipe is full, so the I/O thread has a wakeup pending anyway
+    }
+    return ZK_OK;
+}
+
+static int wait_call(struct zk_call *call) {
+    pthread_mutex_lock(&call->lock);
+    while (!call->done) pthread_cond_wait(&call->cond, &call->lock);
+    pthread_mutex_unlock(&call->lock);
+    pthread_mutex_destroy(&call->lock);
+    pthread_cond_destroy(&call->cond);
+    return call->err;
+}
+
+// take_submitted empties the submission stack and returns it in FIFO order
+static struct zk_call *take_submitted(zk_client *c, struct zk_call *replace) {
+    struct zk_call *chain, *prev = NULL, *next;
+
+    chain = __atomic_exchange_n(&c->submitted, replace, __ATOMIC_ACQUIRE);
+    if (chain == IO_CLOSED) return NULL;
+    for (; chain; chain = next) {
+        next = chain->next;
+        chain->next = prev;
+        prev = chain;
+    }
+    return prev;
+}
+
+// write_calls moves a chain of submitted calls in flight and writes their
+// frames in one burst, through the ring when u is set. Calls that expired
+// before they were written are not sent at all.
+static int write_calls(zk_client *c, struct uring *u, struct call_fifo *inflight, struct zk_call *chain) {
+    int i, n, rc;
+    int64_t now, now_ms;
+    struct zk_call *call, *next;
+    struct oarchive **oas;
+    struct iovec *iov;
+
+    for (n = 0, call = chain; call; call = call->next) n++;
+    if (!(oas = malloc((sizeof(*oas) + sizeof(*iov)) * n))) {
+        fail_calls(chain, ZK_ERROR);
+        return ZK_OK;
+    }
+    now = ustime();
+    now_ms = now / 1000;
+    for (i = 0, call = chain; call; call = next) {
+        next = call->next;
+        if (call->deadline && call->deadline <= now_ms) {
+            complete_call(call, NULL, 0, ZOPERATIONTIMEOUT);
+            continue;
+        }
+        if (fifo_push(inflight, call->xid, call, now) != ZK_OK) {
+            complete_call(call, NULL, 0, ZK_ERROR);
+            continue;
+        }
+        oas[i++] = call->oa;
+    }
+    if (i > 0) __atomic_store_n(&c->last_send, now_ms, __ATOMIC_RELAXED);
+    if (u && i > 0) {
+        iov = (struct iovec *)(oas + n);
+        fill_frames(oas, i, iov);
+        rc = uring_send(u, iov, i);
+    } else {
+        rc = i > 0 ? send_requests(c, &inflight->out, oas, i) : ZK_OK;
+    }
+    free(oas);
+    return rc;
+}
+
+// zk_set_lane sets the lane of the requests the calling thread issues from
+// now on, ZK_LANE_INTERACTIVE by default.
+void zk_set_lane(int lane) {
+    if (lane < ZK_LANE_CONTROL || lane > ZK_LANE_BULK) return;
+    current_lane = lane;
+}
+
+// bulk_ready tells whether a parked bulk call may be written now
+static int bulk_ready(zk_client *c, struct call_fifo *f) {
+    return f->bulk.count > 0 && f->bulk_inflight < c->bulk_depth;
+}
+
+// write_lanes writes a chain of submitted calls lane by lane: control
+// calls first, then interactive ones, then as many parked bulk calls as
+// bulk_depth allows. The server answers in order, so every bulk request
+// held back here is one that a latency critical request doesn't wait for.
+static int write_lanes(zk_client *c, struct uring *u, struct call_fifo *f, struct zk_call *chain) {
+    int room;
+    struct zk_call *call, *next;
+    struct call_queue lanes[ZK_LANE_BULK] = {{NULL, NULL, 0, 0}, {NULL, NULL, 0, 0}};
+
+    for (call = chain; call; call = next) {
+        next = call->next;
+        queue_push(call->lane == ZK_LANE_BULK ? &f->bulk : &lanes[call->lane], call);
+    }
+    for (room = c->bulk_depth - f->bulk_inflight; room > 0 && f->bulk.count > 0; room--) {
+        queue_push(&lanes[ZK_LANE_INTERACTIVE], queue_pop(&f->bulk));
+    }
+    if (lanes[ZK_LANE_CONTROL].tail) {
+        lanes[ZK_LANE_CONTROL].tail->next = lanes[ZK_LANE_INTERACTIVE].head;
+    } else {
+        lanes[ZK_LANE_CONTROL].head = lanes[ZK_LANE_INTERACTIVE].head;
+    }
+    chain = lanes[ZK_LANE_CONTROL].head;
+    return chain ? write_calls(c, u, f, chain) : ZK_OK;
+}
+
+// send_ping writes a ping for the ping timer. It has no caller waiting,
+// the reply is matched and dropped like that of a call that timed out.
+static int send_ping(zk_client *c, struct uring *u, struct call_fifo *inflight) {
+    int rc;
+    int64_t now;
+    struct oarchive *oa;
+    struct iovec iov;
+
+    if (!(oa = new_request(PING_OPCODE, 0))) return ZK_OK;
+    now = ustime();
+    if (fifo_push(inflight, -2, NULL, now) != ZK_OK) {
+        close_buffer_oarchive(&oa, 1);
+        return ZK_OK;
+    }
+    __atomic_store_n(&c->last_send, now / 1000, __ATOMIC_RELAXED);
+    if (u) {
+        fill_frames(&oa, 1, &iov);
+        rc = uring_send(u, &iov, 1);
+    } else {
+        rc = send_requests(c, &inflight->out, &oa, 1);
+    }
+    close_buffer_oarchive(&oa, 1);
+    return rc;
+}
+
+// observe_rtt feeds a ping round trip to the smoothed RTT estimate, with
+// the gains of TCP's retransmission timer (RFC 6298).
+static void observe_rtt(zk_client *c, int64_t rtt) {
+    int64_t srtt, rttvar, diff;
+
+    srtt = c->srtt;
+    if (srtt == 0) {
+        srtt = rtt > 0 ? rtt : 1;
+        rttvar = rtt / 2;
+    } else {
+        diff = srtt > rtt ? srtt - rtt : rtt - srtt;
+        rttvar = c->rttvar + (diff - c->rttvar) / 4;
+        srtt = srtt + (rtt - srtt) / 8;
+    }
+    __atomic_store_n(&c->rttvar, rttvar, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->srtt, srtt, __ATOMIC_RELAXED);
+}
+
+// request_ping asks the I/O thread for a ping
+void request_ping(zk_client *c) {
+    char wake = 1;
+
+    __atomic_store_n(&c->ping_due, 1, __ATOMIC_RELEASE);
+    if (write(c->io_pipe[1], &wake, 1) < 0) {
+        // a wakeup is pending already
+    }
+}
+
+// neg_entry is a path zk_exists found missing. The exists request left a
+// watch on it, the entry goes once the watch fires.
+struct neg_entry {
+    struct neg_entry *next;
+    uint32_t hash;
+    char path[];
+};
+
+static struct neg_entry **find_neg(zk_client *c, const char *path, uint32_t hash) {
+    struct neg_entry **pos = &c->neg[hash % NEG_SLOTS];
+
+    for (; *pos; pos = &(*pos)->next) {
+        if ((*pos)->hash == hash && !strcmp((*pos)->path, path)) break;
+    }
+    return pos;
+}
+
+// neg_add caches a missing path, unless a watch fired or the cache was
+// cleared since epoch: the event may have been for this very path.
+static void neg_add(zk_client *c, const char *path, uint64_t epoch) {
+    size_t len = strlen(path);
+    uint32_t hash = adler32(1, path, len);
+    struct neg_entry *e, **pos;
+
+    pthread_mutex_lock(&c->neg_lock);
+    pos = find_neg(c, path, hash);
+    if (epoch == c->neg_epoch && !*pos && c->neg_count < c->neg_max &&
+            (e = malloc(sizeof(*e) + len + 1))) {
+        e->hash = hash;
+        memcpy(e->path, path, len + 1);
+        e->next = NULL;
+        *pos = e;
+        c->neg_count++;
+    }
+    pthread_mutex_unlock(&c->neg_lock);
+}
+
+static void neg_drop(zk_client *c, const char *path) {
+    uint32_t hash = adler32(1, path, strlen(path));
+    struct neg_entry *e, **pos;
+
+    pthread_mutex_lock(&c->neg_lock);
+    c->neg_epoch++;
+    if ((e = *(pos = find_neg(c, path, hash)))) {
+        *pos = e->next;
+        c->neg_count--;
+        free(e);
+    }
+    pthread_mutex_unlock(&c->neg_lock);
+}
+
+// exists_cache_clear empties the exists cache. The watches behind it don't
+// outlive the connection, so the I/O thread calls it on every disconnect.
+void exists_cache_clear(zk_client *c) {
+    int i;
+    struct neg_entry *e, *next;
+
+    pthread_mutex_lock(&c->neg_lock);
+    c->neg_epoch++;
+    for (i = 0; i < NEG_SLOTS; i++) {
+        for (e = c->neg[i]; e; e = next) {
+            next = e->next;
+            free(e);
+        }
+        c->neg[i] = NULL;
+    }
+    c->neg_count = 0;
+    pthread_mutex_unlock(&c->neg_lock);
+}
+
+// cache_entry is the last reply to a get or a children read of a path,
+// kept for the read modes of zk_get_opts and zk_get_children_opts. A
+// watched entry holds until its watch fires, any other one ages.
+struct cache_entry {
+    struct cache_entry *next;
+    uint32_t hash;
+    int opcode;
+    int watched;
+    int refreshing;
+    int64_t fetched; // ms
+    char *frame;
+    int len;
+    char path[];
+};
+
+static struct cache_entry **find_entry(zk_client *c, int opcode, const char *path, uint32_t hash) {
+    struct cache_entry **pos = &c->cache[hash % CACHE_SLOTS];
+
+    for (; *pos; pos = &(*pos)->next) {
+        if ((*pos)->hash == hash && (*pos)->opcode == opcode && !strcmp((*pos)->path, path)) {
+            break;
+        }
+    }
+    return pos;
+}
+
+static void cache_drop(zk_client *c, int opcode, const char *path) {
+    uint32_t hash = adler32(1, path, strlen(path));
+    struct cache_entry *e, **pos;
+
+    pthread_mutex_lock(&c->cache_lock);
+    c->cache_epoch++;
+    if ((e = *(pos = find_entry(c, opcode, path, hash)))) {
+        *pos = e->next;
+        c->cache_count--;
+        free(e->frame);
+        free(e);
+    }
+    pthread_mutex_unlock(&c->cache_lock);
+}
+
+// read_cache_unwatch turns the watched entries into aging ones, their
+// watches are gone with the connection.
+static void read_cache_unwatch(zk_client *c) {
+    int i;
+    struct cache_entry *e;
+
+    pthread_mutex_lock(&c->cache_lock);
+    c->cache_epoch++;
+    for (i = 0; i < CACHE_SLOTS; i++) {
+        for (e = c->cache[i]; e; e = e->next) e->watched = 0;
+    }
+    pthread_mutex_unlock(&c->cache_lock);
+}
+
+void read_cache_clear(zk_client *c) {
+    int i;
+    struct cache_entry *e, *next;
+
+    pthread_mutex_lock(&c->cache_lock);
+    c->cache_epoch++;
+    for (i = 0; i < CACHE_SLOTS; i++) {
+        for (e = c->cache[i]; e; e = next) {
+            next = e->next;
+            free(e->frame);
+            free(e);
+        }
+        c->cache[i] = NULL;
+    }
+    c->cache_count = 0;
+    pthread_mutex_unlock(&c->cache_lock);
+}
+
+// zk_add_watcher makes fn see every watch notification of the session. It
+// runs on the I/O thread, so it must not issue requests itself.
+int zk_add_watcher(zk_client *c, zk_watch_fn fn, void *arg) {
+    struct zk_watcher *w;
+
+    if (!c || !fn || !(w = malloc(sizeof(*w)))) return ZK_ERROR;
+    w->fn = fn;
+    w->arg = arg;
+    pthread_mutex_lock(&c->watch_lock);
+    w->next = c->watchers;
+    c->watchers = w;
+    pthread_mutex_unlock(&c->watch_lock);
+    return ZK_OK;
+}
+
+// zk_remove_watcher removes a watcher, fn isn't running once it returns
+void zk_remove_watcher(zk_client *c, zk_watch_fn fn, void *arg) {
+    struct zk_watcher *w, **pos;
+
+    pthread_mutex_lock(&c->watch_lock);
+    for (pos = &c->watchers; (w = *pos); pos = &w->next) {
+        if (w->fn == fn && w->arg == arg) {
+            *pos = w->next;
+            free(w);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&c->watch_lock);
+}
+
+static void notify_watchers(zk_client *c, int type, const char *path) {
+    struct zk_watcher *w;
+
+    pthread_mutex_lock(&c->watch_lock);
+    for (w = c->watchers; w; w = w->next) w->fn(c, type, path, w->arg);
+    pthread_mutex_unlock(&c->watch_lock);
+}
+
+// handle_event handles a watch notification, it drops what the watch was
+// guarding: a missing path of zk_exists or a cached read.
+static void handle_event(zk_client *c, char *frame, int len) {
+    struct iarchive *ia;
+    struct ReplyHeader header;
+    struct WatcherEvent event = {ZOO_SESSION_EVENT, 0, NULL};
+
+    // a notification that can't be read counts as lost watches
+    if (!(ia = create_buffer_iarchive_view(frame, len)) ||
+            jute_decode_ReplyHeader(ia, &header) < 0 || jute_decode_WatcherEvent(ia, &event) < 0) {
+        logger(WARN, "Malformed watch notification.");
+        event.type = ZOO_SESSION_EVENT;
+    }
+    if (event.type == ZOO_SESSION_EVENT || !event.path) {
+        event.type = ZOO_SESSION_EVENT;
+        event.path = NULL;
+        exists_cache_clear(c);
+        read_cache_unwatch(c);
+    } else if (event.type == ZOO_CREATED_EVENT) {
+        neg_drop(c, event.path);
+    } else {
+        if (event.type == ZOO_CHANGED_EVENT || event.type == ZOO_DELETED_EVENT) {
+            cache_drop(c, GETDATA_OPCODE, event.path);
+        }
+        if (event.type == ZOO_CHILD_EVENT || event.type == ZOO_DELETED_EVENT) {
+            cache_drop(c, GETCHILDREN_OPCODE, event.path);
+        }
+    }
+    notify_watchers(c, event.type, event.path);
+    if (ia) close_buffer_iarchive(&ia);
+}
+
+// dispatch_reply completes the oldest call in flight with frame and feeds
+// its latency to the in-flight window.
+static int dispatch_reply(zk_client *c, struct call_fifo *inflight, char *frame, int len) {
+    int64_t now;
+    int32_t xid;
+    struct inflight_slot slot;
+
+    xid = len >= 4 ? (int32_t)load_be32(frame) : 0;
+    if (xid == -1) {
+        handle_event(c, frame, len);
+        free(frame);
+        return ZK_OK;
+    }
+    if (!fifo_pop(inflight, &slot)) {
+        logger(WARN, "Unexpected reply with xid %d, nothing in flight.", xid);
+        free(frame);
+        return ZK_SOCKET_ERR;
+    }
+    if (slot.xid != xid) {
+        logger(WARN, "Unexpected reply with xid %d, expected %d.", xid, slot.xid);
+        free(frame);
+        if (slot.call) complete_call(slot.call, NULL, 0, ZK_SOCKET_ERR);
+        return ZK_SOCKET_ERR;
+    }
+    if (len >= 12) seen_zxid(c, (int64_t)load_be64(frame + 4));
+    now = ustime();
+    if (xid == -2) {
+        // the server answers pings without touching the tree, so their
+        // round trip is the network's alone
+        observe_rtt(c, now - slot.sent);
+    } else {
+        window_observe(&c->window, now - slot.sent, now);
+    }
+    if (!slot.call) {
+        // a ping of the timer, or a call that timed out already
+        free(frame);
+        return ZK_OK;
+    }
+    complete_call(slot.call, frame, len, ZK_OK);
+    return ZK_OK;
+}
+
+// reply_stream cuts the bytes read from the socket into reply frames
+struct reply_stream {
+    zk_client *c;
+    struct call_fifo *inflight;
+    char *buf;
+    int len;
+    int cap;
+    int progress;
+};
+
+static int on_reply_data(void *arg, const char *data, int n) {
+    int off = 0, len, rc = ZK_OK, cap;
+    char *frame, *buf;
+    struct reply_stream *st = arg;
+
+    if (st->len + n > st->cap) {
+        cap = st->cap ? st->cap : 4096;
+        while (cap < st->len + n) cap *= 2;
+        if (!(buf = realloc(st->buf, cap))) return ZK_ERROR;
+        st->buf = buf;
+        st->cap = cap;
+    }
+    memcpy(st->buf + st->len, data, n);
+    st->len += n;
+    st->progress = 1;
+    while (rc == ZK_OK && st->len - off >= 4) {
+        len = (int32_t)load_be32(st->buf + off);
+        if (len < 0) return ZK_SOCKET_ERR;
+        if (st->len - off - 4 < len) break;
+        if (!(frame = malloc(len > 0 ? len : 1))) return ZK_ERROR;
+        memcpy(frame, st->buf + off + 4, len);
+        off += 4 + len;
+        rc = dispatch_reply(st->c, st->inflight, frame, len);
+    }
+    memmove(st->buf, st->buf + off, st->len - off);
+    st->len -= off;
+    return rc;
+}
+
+// read_replies reads what the socket holds without waiting for more, a
+// frame cut short stays in st until the rest of it arrives.
+static int read_replies(zk_client *c, struct reply_stream *st) {
+    int rc;
+    ssize_t bytes;
+    char buf[16384];
+
+    for (;;) {
+        bytes = read(c->sock, buf, sizeof(buf));
+        if (bytes > 0) {
+            if ((rc = on_reply_data(st, buf, bytes)) != ZK_OK) return rc;
+            continue;
+        }
+        if (bytes == -1 && errno == EINTR) continue;
+        if (bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return ZK_OK;
+        return ZK_SOCKET_ERR;
+    }
+}
+
+// io_timeout returns how long the I/O thread may sleep: until the next call
+// deadline or, with requests in flight, until deadline, when the
+// connection is given up on.
+static int io_timeout(struct call_fifo *inflight, int64_t deadline) {
+    int64_t now, next;
+
+    if (inflight->count == 0) return -1;
+    if ((next = next_deadline(inflight)) && next < deadline) deadline = next;
+    if ((next = inflight->bulk.deadline) && next < deadline) deadline = next;
+    now = mstime();
+    return deadline > now ? deadline - now : 0;
+}
+
+// The I/O thread owns the socket once the session is established. A call
+// that outlives its deadline fails with ZOPERATIONTIMEOUT on its own, but
+// no reply at all within read_timeout breaks the connection like a socket
+// error. The loops return once the connection is broken, pending holds
+// the calls queued while the client was reconnecting.
+static void io_loop_poll(zk_client *c, struct call_fifo *inflight, struct zk_call *pending) {
+    int n, broken = 0, woken = 0, timeout;
+    char buf[64];
+    int64_t deadline = mstime() + c->read_timeout, now, hold_until = 0, wait;
+    struct timespec ts;
+    struct pollfd pfds[2];
+    struct zk_call *chain;
+    struct reply_stream st = {c, inflight, NULL, 0, 0, 0};
+
+    if (pending && write_lanes(c, NULL, inflight, pending) != ZK_OK) return;
+    while (!broken && !__atomic_load_n(&c->io_stop, __ATOMIC_ACQUIRE)) {
+        pfds[0].fd = c->io_pipe[0];
+        pfds[0].events = POLLIN;
+        pfds[1].fd = c->sock;
+        pfds[1].events = inflight->out.off < inflight->out.len ? POLLIN | POLLOUT : POLLIN;
+        pfds[0].revents = pfds[1].revents = 0;
+        timeout = io_timeout(inflight, deadline);
+        // ppoll keeps a held burst to the microsecond, poll would round
+        // every hold up to a millisecond
+        wait = timeout < 0 ? -1 : (int64_t)timeout * 1000;
+        if (hold_until) {
+            now = hold_until - ustime();
+            if (now < 0) now = 0;
+            if (wait < 0 || now < wait) wait = now;
+        }
+        ts.tv_sec = wait / 1000000;
+        ts.tv_nsec = wait % 1000000 * 1000;
+        n = ppoll(pfds, 2, wait < 0 ? NULL : &ts, NULL);
+        if (n < 0 && errno != EINTR) break;
+
+        if (pfds[0].revents & POLLIN) {
+            // drain the pipe before taking the stack, a push after the
+            // exchange then always leaves a byte for the next round.
+            while (read(c->io_pipe[0], buf, sizeof(buf)) == sizeof(buf));
+            woken = 1;
+        }
+        if ((pfds[1].revents & POLLOUT) && flush_requests(c, &inflight->out) != ZK_OK) {
+            broken = 1;
+        }
+        if (!broken && woken && !hold_until && c->write_delay > 0 && inflight->count > 0 &&
+                inflight->out.off == inflight->out.len &&
+                __atomic_load_n(&c->submitted, __ATOMIC_ACQUIRE)) {
+            // the server is busy with earlier requests anyway, give other
+            // callers a moment to join this burst. The poll timeout ends
+            // the hold, replies are read meanwhile.
+            hold_until = ustime() + c->write_delay;
+        }
+        if (hold_until && (inflight->count == 0 || ustime() >= hold_until)) hold_until = 0;
+        // like the ring, the stack is only taken once the last burst is
+        // written, callers arriving meanwhile make up the next one.
+        if (!broken && woken && !hold_until && inflight->out.off == inflight->out.len) {
+            woken = 0;
+            if ((chain = take_submitted(c, NULL))) {
+                if (inflight->count == 0) deadline = mstime() + c->read_timeout;
+                if (write_lanes(c, NULL, inflight, chain) != ZK_OK) broken = 1;
+            }
+            if (!broken && __atomic_exchange_n(&c->ping_due, 0, __ATOMIC_ACQUIRE)) {
+                if (inflight->count == 0) deadline = mstime() + c->read_timeout;
+                if (send_ping(c, NULL, inflight) != ZK_OK) broken = 1;
+            }
+        }
+        st.progress = 0;
+        if (!broken && (pfds[1].revents & (POLLIN | POLLERR | POLLHUP))) {
+            if (read_replies(c, &st) != ZK_OK) broken = 1;
+            if (!broken && bulk_ready(c, inflight) &&
+                    write_lanes(c, NULL, inflight, NULL) != ZK_OK) {
+                broken = 1;
+            }
+        }
+        if (st.progress) {
+            deadline = mstime() + c->read_timeout;
+        } else if (!broken && inflight->count > 0 && mstime() >= deadline) {
+            logger(WARN, "No reply from the server in %d ms.", c->read_timeout);
+            broken = 1;
+        }
+        now = mstime();
+        expire_calls(inflight, now);
+        queue_expire(&inflight->bulk, now);
+    }
+    free(st.buf);
+}
+
+// io_loop_uring is io_loop_poll on top of io_uring. The submission stack
+// is only taken while no write is in flight, callers arriving meanwhile
+// make up the next burst.
+static void io_loop_uring(zk_client *c, struct uring *u, struct call_fifo *inflight,
+        struct zk_call *pending) {
+    int rc, woken, broken = 0, timeout;
+    int64_t deadline = mstime() + c->read_timeout, now;
+    struct zk_call *chain;
+    struct reply_stream st = {c, inflight, NULL, 0, 0, 0};
+
+    if (pending && write_lanes(c, u, inflight, pending) != ZK_OK) return;
+    while (!broken && !__atomic_load_n(&c->io_stop, __ATOMIC_ACQUIRE)) {
+        if (!uring_sending(u) &&
+                ((chain = take_submitted(c, NULL)) || bulk_ready(c, inflight))) {
+            if (inflight->count == 0) deadline = mstime() + c->read_timeout;
+            if (write_lanes(c, u, inflight, chain) != ZK_OK) break;
+        }
+        if (!uring_sending(u) && __atomic_exchange_n(&c->ping_due, 0, __ATOMIC_ACQUIRE)) {
+            if (inflight->count == 0) deadline = mstime() + c->read_timeout;
+            if (send_ping(c, u, inflight) != ZK_OK) break;
+        }
+        timeout = io_timeout(inflight, deadline);
+        st.progress = 0;
+        rc = uring_wait(u, timeout, on_reply_data, &st, &woken);
+        if (rc != ZK_OK && rc != ZK_TIMEOUT) broken = 1;
+        if (st.progress) {
+            deadline = mstime() + c->read_timeout;
+        } else if (!broken && inflight->count > 0 && mstime() >= deadline) {
+            logger(WARN, "No reply from the server in %d ms.", c->read_timeout);
+            broken = 1;
+        }
+        now = mstime();
+        expire_calls(inflight, now);
+        queue_expire(&inflight->bulk, now);
+    }
+    free(st.buf);
+}
+
+// backoff returns the delay before a reconnect attempt: it doubles with
+// every failed attempt up to reconnect_max, and only its upper half is
+// fixed so clients that lost the same server don't come back in lockstep.
+static int64_t backoff(zk_client *c, int attempt, unsigned *seed) {
+    int64_t delay = c->reconnect_min;
+
+    while (attempt-- > 0 && delay < c->reconnect_max) delay *= 2;
+    if (delay > c->reconnect_max) delay = c->reconnect_max;
+    return delay / 2 + rand_r(seed) % (delay / 2 + 1);
+}
+
+// queue_calls moves the submitted calls to the end of the reconnect queue,
+// calls beyond max_queued fail right away.
+static void queue_calls(zk_client *c, struct call_queue *pending, int err) {
+    struct zk_call *chain, *next;
+
+    for (chain = take_submitted(c, NULL); chain; chain = next) {
+        next = chain->next;
+        if (err != ZK_OK || pending->count >= c->max_queued) {
+            complete_call(chain, NULL, 0, err != ZK_OK ? err : ZK_SOCKET_ERR);
+            continue;
+        }
+        queue_push(pending, chain);
+    }
+}
+
+// reconnect connects the client again while the I/O thread is offline. It
+// returns ZK_OK once the session is back, with the calls submitted in the
+// meantime added to pending, or ZK_ERROR when the thread has to stop.
+static int reconnect(zk_client *c, struct call_queue *pending, unsigned *seed) {
+    int attempt = 0, timeout, err;
+    int64_t now;
+    char buf[64];
+    struct pollfd pfd;
+
+    // the ring may have eaten the wakeup of calls submitted already
+    queue_calls(c, pending, ZK_OK);
+    __atomic_store_n(&c->reconnect_due, 0, __ATOMIC_RELAXED);
+    timer_add(&c->reconnect_timer, backoff(c, attempt, seed));
+    while (!__atomic_load_n(&c->io_stop, __ATOMIC_ACQUIRE)) {
+        pfd.fd = c->io_pipe[0];
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        now = mstime();
+        queue_expire(pending, now);
+        timeout = pending->deadline ? pending->deadline - now : -1;
+        if (poll(&pfd, 1, timeout) < 0 && errno != EINTR) break;
+        if (pfd.revents & POLLIN) {
+            while (read(c->io_pipe[0], buf, sizeof(buf)) == sizeof(buf));
+            // a closing client doesn't reconnect, it fails every call
+            err = c->state == ZK_STATE_STOP ? ZK_SOCKET_ERR : ZK_OK;
+            if (err != ZK_OK) fail_calls(queue_take(pending), err);
+            queue_calls(c, pending, err);
+        }
+        __atomic_store_n(&c->ping_due, 0, __ATOMIC_RELAXED);
+        if (c->state == ZK_STATE_STOP ||
+                !__atomic_exchange_n(&c->reconnect_due, 0, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+        if (do_connect(c) == ZK_OK) {
+            logger(INFO, "Reconnect to zookeeper success, %d requests were queued.",
+                    pending->count);
+            return ZK_OK;
+        }
+        attempt++;
+        timer_add(&c->reconnect_timer, backoff(c, attempt, seed));
+    }
+    timer_del(&c->reconnect_timer);
+    fail_calls(queue_take(pending), ZK_SOCKET_ERR);
+    return ZK_ERROR;
+}
+
+// io_loop serves the connection and reconnects it whenever it breaks, so
+// a client outlives any number of server restarts.
+static void *io_loop(void *arg) {
+    zk_client *c = arg;
+    unsigned seed;
+    struct uring *u;
+    struct zk_call *chain, *next;
+    struct call_queue pending = {NULL, NULL, 0, 0};
+    struct call_fifo inflight = {NULL, 0, 0, 0, 0, NULL, 0, 0, {NULL, NULL, 0, 0}, 0, {NULL, 0, 0, 0}};
+
+    seed = (unsigned)ustime() ^ (unsigned)(uintptr_t)c;
+    while (!__atomic_load_n(&c->io_stop, __ATOMIC_ACQUIRE)) {
+        if (c->sock < 0 && reconnect(c, &pending, &seed) != ZK_OK) break;
+        chain = queue_take(&pending);
+        if ((u = uring_new(c->sock, c->io_pipe[0]))) {
+            logger(DEBUG, "Use io_uring for the connection.");
+            io_loop_uring(c, u, &inflight, chain);
+            uring_free(u);
+        } else {
+            io_loop_poll(c, &inflight, chain);
+        }
+        // the outcome of the calls in flight is unknown, so they fail, the
+        // parked bulk calls were never written and wait for the reconnect
+        fifo_fail(&inflight, ZK_SOCKET_ERR);
+        for (chain = queue_take(&inflight.bulk); chain; chain = next) {
+            next = chain->next;
+            queue_push(&pending, chain);
+        }
+        inflight.out.len = inflight.out.off = 0;
+        disconnect(c);
+        exists_cache_clear(c);
+        read_cache_unwatch(c);
+        notify_watchers(c, ZOO_SESSION_EVENT, NULL);
+        if (c->state != ZK_STATE_STOP && !__atomic_load_n(&c->io_stop, __ATOMIC_ACQUIRE)) {
+            logger(WARN, "Lost the connection to zookeeper, reconnecting.");
+        }
+    }
+    free(inflight.slots);
+    free(inflight.timers);
+    free(inflight.out.buf);
+    fail_calls(take_submitted(c, IO_CLOSED), ZK_SOCKET_ERR);
+    return NULL;
+}
+
+// on_reconnect_timer runs on the timer thread, the I/O thread connects
+static void on_reconnect_timer(struct zk_timer *t, void *arg) {
+    zk_client *c = arg;
+    char wake = 1;
+
+    __atomic_store_n(&c->reconnect_due, 1, __ATOMIC_RELEASE);
+    if (write(c->io_pipe[1], &wake, 1) < 0) {
+        // a wakeup is pending already
+    }
+}
+
+int start_io_thread(zk_client *c) {
+    int i;
+
+    if (pipe(c->io_pipe) != 0) return ZK_ERROR;
+    for (i = 0; i < 2; i++) {
+        fcntl(c->io_pipe[i], F_SETFL, fcntl(c->io_pipe[i], F_GETFL) | O_NONBLOCK);
+    }
+    c->io_stop = 0;
+    timer_init(&c->reconnect_timer, on_reconnect_timer, c);
+    __atomic_store_n(&c->submitted, NULL, __ATOMIC_RELEASE);
+    if (pthread_create(&c->io_tid, NULL, io_loop, c) != 0) {
+        c->submitted = IO_CLOSED;
+        close(c->io_pipe[0]);
+        close(c->io_pipe[1]);
+        c->io_pipe[0] = c->io_pipe[1] = -1;
+        return ZK_ERROR;
+    }
+    return ZK_OK;
+}
+
+// stop_io_thread fails the calls still in flight and waits for the thread
+void stop_io_thread(zk_client *c) {
+    char wake = 1;
+
+    if (c->io_pipe[1] < 0) return;
+    __atomic_store_n(&c->io_stop, 1, __ATOMIC_RELEASE);
+    if (write(c->io_pipe[1], &wake, 1) < 0) {
+        // a wakeup is pending already
+    }
+    pthread_join(c->io_tid, NULL);
+    close(c->io_pipe[0]);
+    close(c->io_pipe[1]);
+    c->io_pipe[0] = c->io_pipe[1] = -1;
+}
+
+// copy_frame returns a copy of the request frame in oa
+static struct oarchive *copy_frame(struct oarchive *oa) {
+    int len = get_buffer_len(oa);
+    struct oarchive *copy;
+    struct buff_struct *buff;
+
+    if (!(copy = create_buffer_oarchive_sized(len))) return NULL;
+    buff = copy->priv;
+    memcpy(buff->buffer, get_buffer(oa), len);
+    buff->off = len;
+    return copy;
+}
+
+// is_read tells whether the request in oa is a get, exists or children read
+static int is_read(struct oarchive *oa) {
+    int opcode = (int32_t)load_be32(get_buffer(oa) + 8);
+
+    return opcode == EXISTS_OPCODE || opcode == GETDATA_OPCODE ||
+        opcode == GETCHILDREN_OPCODE || opcode == GETCHILDREN2_OPCODE;
+}
+
+// hedgeable tells whether the read in oa may be sent to the hedge session.
+// A read that sets a watch stays on its session, the watch belongs to it.
+static int hedgeable(zk_client *c, struct oarchive *oa) {
+    if (!c->hedge_session || !c->hedge.percentile || current_lane == ZK_LANE_BULK) return 0;
+    // the watch flag is the last byte of every read
+    return is_read(oa) && !get_buffer(oa)[get_buffer_len(oa) - 1];
+}
+
+// send_second sends the read on the other session, it's called with the
+// lock held. Without a copy of the frame the read fails.
+static void send_second(struct hedged_read *h, struct oarchive *oa, int64_t deadline) {
+    if (!(h->oas[1] = copy_frame(oa))) {
+        if (h->pending == 0) {
+            h->done = 1;
+            h->frame = NULL;
+            h->err = ZK_ERROR;
+        }
+        h->sent = 2;
+        return;
+    }
+    h->refs++;
+    h->pending++;
+    h->sent = 2;
+    // a failed submit completes the call at once, which takes the lock
+    pthread_mutex_unlock(&h->lock);
+    submit_calls(h->sessions[1], &h->calls[1], &h->oas[1], 1,
+            ZK_LANE_INTERACTIVE, deadline, complete_hedged, h);
+    pthread_mutex_lock(&h->lock);
+}
+
+// call_synced sends a sync ahead of the read on the primary session, the
+// server catches up with the leader before it answers the read.
+static int call_synced(zk_client *c, struct oarchive *oa, char **frame, int *len,
+        int64_t deadline) {
+    int rc, err;
+    struct zk_call calls[2];
+    struct oarchive *oas[2];
+    struct SyncRequest req = {"/"};
+
+    oas[0] = new_request(SYNC_OPCODE, serialized_size_SyncRequest(&req));
+    if (!oas[0] || jute_encode_SyncRequest(oas[0], &req) < 0) {
+        if (oas[0]) close_buffer_oarchive(&oas[0], 1);
+        return ZK_ERROR;
+    }
+    oas[1] = oa;
+    submit_calls(c, calls, oas, 2, ZK_LANE_INTERACTIVE, deadline, NULL, NULL);
+    err = wait_call(&calls[0]);
+    rc = wait_call(&calls[1]);
+    free(calls[0].frame);
+    close_buffer_oarchive(&oas[0], 1);
+    if (err != ZK_OK) {
+        // the read may come from behind without the sync
+        free(calls[1].frame);
+        return err;
+    }
+    *frame = calls[1].frame;
+    *len = calls[1].len;
+    return rc;
+}
+
+// call_hedged sends a read and sends it again on the other session when no
+// reply came within the hedge delay and the hedge budget allows it. Until
+// there are enough reads to tell the percentile, the delay follows the
+// ping round trip. Replies come in order, so the reads after a stalled one
+// would stall too: once a hedge wins, reads go to the other session first.
+// A reply only counts when its zxid has reached the last zxid the client
+// has seen, on whichever session it comes, so a read never goes back in
+// time. When neither server is there yet the read is synced on the primary.
+static int call_hedged(zk_client *c, struct oarchive *oa, char **frame, int *len,
+        int64_t deadline) {
+    int rc, refs, swapped, stale;
+    int64_t start, delay, srtt, rttvar;
+    struct timespec ts;
+    struct hedged_read *h;
+    zk_client **sessions;
+
+    if (!(h = calloc(1, sizeof(*h))) || !(h->oas[0] = copy_frame(oa))) {
+        free(h);
+        return ZK_ERROR;
+    }
+    pthread_mutex_init(&h->lock, NULL);
+    pthread_cond_init(&h->cond, NULL);
+    h->refs = 2;
+    h->pending = 1;
+    h->sent = 1;
+    h->min_zxid = __atomic_load_n(&c->last_zxid, __ATOMIC_SEQ_CST);
+    swapped = __atomic_load_n(&c->hedge_swapped, __ATOMIC_RELAXED);
+    sessions = h->sessions;
+    sessions[0] = swapped ? c->hedge_session : c;
+    sessions[1] = swapped ? c : c->hedge_session;
+    start = ustime();
+    if (!(delay = hedge_delay(&c->hedge))) {
+        get_rtt(sessions[0], &srtt, &rttvar);
+        delay = srtt ? srtt + 4 * rttvar : 0;
+    }
+    submit_calls(sessions[0], &h->calls[0], &h->oas[0], 1, ZK_LANE_INTERACTIVE, deadline,
+            complete_hedged, h);
+
+    pthread_mutex_lock(&h->lock);
+    if (delay > 0) {
+        abstime_after(&ts, (delay + 999) / 1000);
+        while (!h->done && !h->stale && pthread_cond_timedwait(&h->cond, &h->lock, &ts) != ETIMEDOUT);
+        if (!h->done && !h->stale && hedge_take(&c->hedge)) send_second(h, oa, deadline);
+    }
+    while (!h->done) {
+        // a stale first reply leaves the read to the other session, the
+        // primary, outside the hedge budget
+        if (h->stale && h->sent == 1) {
+            send_second(h, oa, deadline);
+            continue;
+        }
+        pthread_cond_wait(&h->cond, &h->lock);
+    }
+    *frame = h->frame;
+    *len = h->len;
+    rc = h->err;
+    if (rc == ZK_OK && h->winner == 1) {
+        __atomic_store_n(&c->hedge_swapped, !swapped, __ATOMIC_RELAXED);
+    }
+    stale = h->stale;
+    h->frame = NULL;
+    refs = --h->refs;
+    pthread_mutex_unlock(&h->lock);
+    if (refs == 0) free_hedged_read(h);
+    if (rc == ZK_OK) hedge_observe(&c->hedge, ustime() - start);
+    if (rc != ZK_OK && stale) rc = call_synced(c, oa, frame, len, deadline);
+    return rc;
+}
+
+// issue_requests submits n frames and waits for all of their replies.
+// frames[i] is NULL when the i-th request failed, the first error is
+// returned. The burst takes n slots of the in-flight window, each slot is
+// given back as soon as its reply is in. All n requests share a deadline
+// request_timeout from now, the time spent waiting for the window counts.
+static int issue_requests(zk_client *c, struct oarchive **oas, char **frames, int *lens, int n) {
+    int i, rc = ZK_OK, err, lane = current_lane;
+    int64_t deadline;
+    struct zk_call one, *calls;
+    zk_client *s = c;
+
+    for (i = 0; i < n; i++) frames[i] = NULL;
+    // bulk requests go to the bulk session when the client has one
+    if (lane == ZK_LANE_BULK && c->bulk) s = c->bulk;
+    deadline = c->request_timeout > 0 ? mstime() + c->request_timeout : 0;
+    if ((rc = window_acquire(&s->window, n, deadline)) != ZK_OK) {
+        set_last_error(rc);
+        return rc;
+    }
+    if (n == 1 && s == c && hedgeable(c, oas[0])) {
+        rc = call_hedged(c, oas[0], frames, lens, deadline);
+        window_release(&c->window, 1);
+        if (rc != ZK_OK) set_last_error(rc);
+        return rc;
+    }
+    calls = n == 1 ? &one : malloc(sizeof(*calls) * n);
+    if (!calls) {
+        window_release(&s->window, n);
+        set_last_error(ZK_ERROR);
         return ZK_ERROR;
     }
-
-    TIME_START();
-    buf[0] = len >> 24;
-    buf[1] = len >> 16;
-    buf[2] = len >> 8;
-    buf[3] = len & 0xff;
-    memcpy(buf + 4, get_buffer(oa), len);
-    rc = wait_socket(c->sock, c->write_timeout, CR_WRITE);
-    if (rc != ZK_OK) goto cleanup;
-    w_bytes = 0;
-    while(w_bytes < len + 4) {
-        bytes = write(c->sock, buf + w_bytes, len + 4 - w_bytes);
-        if (bytes == -1 && errno != EAGAIN && errno != EINTR) {
-            goto cleanup;
-        }
-        w_bytes += bytes;
+    submit_calls(s, calls, oas, n, lane, deadline, NULL, NULL);
+    for (i = 0; i < n; i++) {
+        err = wait_call(&calls[i]);
+        window_release(&s->window, 1);
+        frames[i] = calls[i].frame;
+        lens[i] = calls[i].len;
+        if (rc == ZK_OK && err != ZK_OK) rc = err;
     }
-    free(buf);
-    TIME_END();
-    return ZK_OK;
-
-cleanup:
-    free(buf);
-    c->last_err = ZK_SOCKET_ERR;
-    TIME_END();
-    return ZK_SOCKET_ERR;
+    if (calls != &one) free(calls);
+    if (rc != ZK_OK) set_last_error(rc);
+    return rc;
 }
 
-static int add_request_header(struct oarchive *oa, int opcode) {
-    int32_t xid;
-    xid = PING_OPCODE == opcode ? -2 : get_xid();
-    struct RequestHeader header = {xid, opcode};
-    return serialize_RequestHeader(oa, "header", &header);
-}
+// read_flight is a read in flight that identical reads issued meanwhile
+// join instead of sending their own. The key is the frame past the xid:
+// the opcode, the path and the watch flag. A read only joins a flight
+// started after the last write of the session, so a thread never sees a
+// reply older than its own writes.
+struct read_flight {
+    struct read_flight *next;
+    uint32_t hash;
+    uint64_t write_seq;
+    char *key; // points into the frame of the leader
+    int key_len;
+    int refs;
+    int done;
+    char *frame;
+    int len;
+    int err;
+};
 
-static int decode_reply_header(zk_client *c, struct iarchive *ia) {
-    int rc, err;
-    struct ReplyHeader reply_header;
+static struct read_flight **find_flight(zk_client *c, uint32_t hash, char *key, int key_len) {
+    struct read_flight **pos = &c->flights[hash % FLIGHT_SLOTS];
 
-    rc = deserialize_ReplyHeader(ia, "header", &reply_header);
-    if (rc < 0) {
-        err = ZK_ERROR;
-    } else {
-        err = reply_header.err;
+    for (; *pos; pos = &(*pos)->next) {
+        if ((*pos)->hash == hash && (*pos)->key_len == key_len &&
+                !memcmp((*pos)->key, key, key_len)) {
+            break;
+        }
     }
-    c->last_err = err;
-    return err;
+    return pos;
 }
 
-struct iarchive *recv_response(zk_client *c) {
-    int rc, len;
-    char buf[4], *recv_buf;
-    
-    TIME_START();
-    rc = wait_socket(c->sock, c->read_timeout, CR_READ);
-    if(rc != ZK_OK) {
-        c->last_err = rc;
-        TIME_END();
-        return NULL;
+// call_coalesced sends a read unless an identical one is in flight, then
+// it waits for that one and takes a copy of its reply.
+static int call_coalesced(zk_client *c, struct oarchive *oa, char **frame, int *len) {
+    int rc, key_len;
+    char *key;
+    uint32_t hash;
+    struct read_flight *f, **pos, self;
+
+    key = get_buffer(oa) + 8;
+    key_len = get_buffer_len(oa) - 8;
+    hash = adler32(1, key, key_len);
+    pthread_mutex_lock(&c->flight_lock);
+    pos = find_flight(c, hash, key, key_len);
+    if ((f = *pos) && f->write_seq == c->write_seq) {
+        f->refs++;
+        while (!f->done) pthread_cond_wait(&c->flight_cond, &c->flight_lock);
+        pthread_mutex_unlock(&c->flight_lock);
+        rc = f->err;
+        *frame = NULL;
+        *len = 0;
+        if (f->frame && (*frame = malloc(f->len))) {
+            memcpy(*frame, f->frame, f->len);
+            *len = f->len;
+        } else if (f->frame) {
+            rc = ZK_ERROR;
+        }
+        pthread_mutex_lock(&c->flight_lock);
+        if (--f->refs == 1) pthread_cond_broadcast(&c->flight_cond);
+        pthread_mutex_unlock(&c->flight_lock);
+        if (rc != ZK_OK) set_last_error(rc);
+        return rc;
     }
-
-    rc = read_socket(c->sock, buf, 4); 
-    if (rc != ZK_OK) {
-        c->last_err = rc;
-        return NULL;
+    // a flight from before the last write stays where it is, the new one
+    // goes in front of it and is found first
+    f = &self;
+    f->hash = hash;
+    f->write_seq = c->write_seq;
+    f->key = key;
+    f->key_len = key_len;
+    f->refs = 1;
+    f->done = 0;
+    f->next = c->flights[hash % FLIGHT_SLOTS];
+    c->flights[hash % FLIGHT_SLOTS] = f;
+    pthread_mutex_unlock(&c->flight_lock);
+
+    rc = issue_requests(c, &oa, frame, len, 1);
+
+    pthread_mutex_lock(&c->flight_lock);
+    for (pos = &c->flights[hash % FLIGHT_SLOTS]; *pos != f; pos = &(*pos)->next);
+    *pos = f->next;
+    f->frame = *frame;
+    f->len = *len;
+    f->err = rc;
+    f->done = 1;
+    if (f->refs > 1) {
+        pthread_cond_broadcast(&c->flight_cond);
+        // the followers copy the reply before it goes back to the caller
+        while (f->refs > 1) pthread_cond_wait(&c->flight_cond, &c->flight_lock);
     }
+    pthread_mutex_unlock(&c->flight_lock);
+    return rc;
+}
 
-    len = decode_int32(buf, 0);
-    recv_buf = malloc(len);
-    rc = read_socket(c->sock, recv_buf, len);
-    if (rc != ZK_OK) {
-        c->last_err = rc;
-        free(recv_buf);
-        return NULL;
-    }
+// call_requests is issue_requests for the request functions. A single
+// read may join an identical one in flight, anything else counts
+// as a write and keeps later reads from joining earlier flights. The
+// sequence moves again once the write is answered: a flight started while
+// it waited for the window may have gone out ahead of it.
+static int call_requests(zk_client *c, struct oarchive **oas, char **frames, int *lens, int n) {
+    int i, rc;
 
-    TIME_END();
-    return create_buffer_iarchive(recv_buf, len);
+    if (n == 1 && c->coalesce_reads && is_read(oas[0])) {
+        return call_coalesced(c, oas[0], frames, lens);
+    }
+    for (i = 0; i < n && is_read(oas[i]); i++);
+    if (i < n) {
+        pthread_mutex_lock(&c->flight_lock);
+        c->write_seq++;
+        pthread_mutex_unlock(&c->flight_lock);
+    }
+    rc = issue_requests(c, oas, frames, lens, n);
+    if (i < n) {
+        pthread_mutex_lock(&c->flight_lock);
+        c->write_seq++;
+        pthread_mutex_unlock(&c->flight_lock);
+    }
+    return rc;
 }
 
-static void destory_archive(struct oarchive *oa, struct iarchive *ia) {
-    if (oa) close_buffer_oarchive(&oa, 1); 
-    if (ia) {
-        free(((struct buffer*)(ia->priv))->buff);
-        close_buffer_iarchive(&ia);
+// pipeline_requests sends n requests in a single burst and then collects
+// their replies in order, ias[i] is left NULL once the connection fails.
+// Reply headers are left for the caller to decode.
+static int pipeline_requests(zk_client *c, struct oarchive **oas, struct iarchive **ias, int n) {
+    int i, rc, one_len, *lens;
+    char *one_frame, **frames;
+
+    frames = n == 1 ? &one_frame : malloc(sizeof(*frames) * n);
+    lens = n == 1 ? &one_len : malloc(sizeof(*lens) * n);
+    if (!frames || !lens) {
+        if (n != 1) {
+            free(frames);
+            free(lens);
+        }
+        for (i = 0; i < n; i++) ias[i] = NULL;
+        set_last_error(ZK_ERROR);
+        return ZK_ERROR;
+    }
+    rc = call_requests(c, oas, frames, lens, n);
+    for (i = 0; i < n; i++) {
+        ias[i] = frames[i] ? create_buffer_iarchive(frames[i], lens[i]) : NULL;
     }
+    if (n != 1) {
+        free(frames);
+        free(lens);
+    }
+    return rc;
 }
 
 int authenticate(zk_client *c) {
@@ -174,26 +1795,32 @@ int authenticate(zk_client *c) {
 
     struct ConnectRequest req = {
         PROTOCOL_VERSION,
-        c->last_zxid,
+        __atomic_load_n(&c->last_zxid, __ATOMIC_SEQ_CST),
         c->session_timeout,
         c->session_id,
         c->passwd
     };
-    oa = create_buffer_oarchive();
-    rc = serialize_ConnectRequest(oa, "auth", &req);
+    oa = new_frame(serialized_size_ConnectRequest(&req));
+    rc = oa ? jute_encode_ConnectRequest(oa, &req) : ZK_ERROR;
     rc = rc < 0 ? rc : send_request(c, oa);
     if (rc != ZK_OK || !(ia = recv_response(c))) {
-        rc = rc != ZK_OK ? rc: c->last_err;
+        rc = rc != ZK_OK ? rc: zk_last_error(c);
         goto END;
     }
 
-    rc = deserialize_ConnectResponse(ia, "auth", &resp);
+    rc = jute_decode_ConnectResponse(ia, &resp);
+    if (rc >= 0 && resp.timeOut <= 0) {
+        // the server refused to resume the session
+        deallocate_ConnectResponse(&resp);
+        rc = ZSESSIONEXPIRED;
+        goto END;
+    }
     c->session_id = resp.sessionId;
     c->session_timeout = resp.timeOut;
     if (c->passwd.len != resp.passwd.len || memcmp(c->passwd.buff, resp.passwd.buff, c->passwd.len)) {
         free(c->passwd.buff);
         c->passwd.buff = malloc(resp.passwd.len);
-        memcpy(c->passwd.buff, resp.passwd.buff, c->passwd.len);
+        memcpy(c->passwd.buff, resp.passwd.buff, resp.passwd.len);
         c->passwd.len = resp.passwd.len;
     }
     deallocate_ConnectResponse(&resp);
@@ -211,85 +1838,129 @@ int zk_create(zk_client *c, char *path, char *data, int size, int flags) {
     struct CreateResponse resp;
 
     if (!c || !path) return ZK_ERROR;
-    oa = create_buffer_oarchive();
-    rc = add_request_header(oa, CREATE_OPCODE);
     value.len = 0;
     if (data && size > 0) {
         value.buff = data; 
         value.len = size;
     }
     struct CreateRequest req = {path, value, default_acl, flags};
-    rc = rc < 0 ? rc : serialize_CreateRequest(oa, "req", &req);
+    oa = new_request(CREATE_OPCODE, serialized_size_CreateRequest(&req));
+    rc = oa ? jute_encode_CreateRequest(oa, &req) : ZK_ERROR;
 
-    pthread_mutex_lock(&c->lock);
-    rc = rc < 0 ? rc : send_request(c, oa);
-    if (rc != ZK_OK|| !(ia = recv_response(c))) {
-        err = rc != ZK_OK ? rc: c->last_err;
+    rc = rc < 0 ? rc : pipeline_requests(c, &oa, &ia, 1);
+    if (rc != ZK_OK) {
+        err = rc;
         goto ERROR;
     }
-    pthread_mutex_unlock(&c->lock);
 
     if ((err = decode_reply_header(c, ia))) {
         goto ERROR;
     }
-    rc = deserialize_CreateResponse(ia, "resp", &resp);
+    rc = jute_decode_CreateResponse(ia, &resp);
     deallocate_CreateResponse(&resp);
     destory_archive(oa, ia);
     return rc < 0 ? ZK_ERROR : ZK_OK;
 
 ERROR:
-    pthread_mutex_unlock(&c->lock);
     destory_archive(oa, ia);
     return err; 
 }
 
+// zk_mkdir creates path and every missing ancestor. The leaf is tried on its
+// own first, so an existing parent costs a single create. Once it answers
+// ZNONODE, the creates for all levels are pipelined in one burst: the
+// server applies them in order, so ancestors exist before their children.
 int zk_mkdir(zk_client *c, char *path) {
-    int status;
-    char *pos, *parent;
+    int i, n, len, rc, err, status, cause;
+    char *prefix;
+    struct oarchive **oas;
+    struct iarchive **ias;
+    struct buffer value = {0, NULL};
 
+    if (!c || !path || path[0] != '/') return ZK_ERROR;
     status = zk_create(c, path, NULL, 0, 0);
-    if (status == ZNONODE) {
-        pos = strrchr(path, '/');
-        parent = malloc(pos - path + 1); 
-        memcpy(parent, path, pos-path);
-        parent[pos-path] = '\0';
-        status = zk_mkdir(c, parent); 
-        free(parent);
-        if (status == ZK_OK) {
-            status = zk_create(c, path, NULL, 0, 0);
+    if (status != ZNONODE) return status;
+    len = strlen(path);
+    n = 0;
+    for (i = 1; i <= len; i++) {
+        if (i == len || path[i] == '/') n++;
+    }
+    oas = calloc(n, sizeof(*oas));
+    ias = calloc(n, sizeof(*ias));
+    prefix = malloc(len + 1);
+    if (!oas || !ias || !prefix) {
+        free(oas);
+        free(ias);
+        free(prefix);
+        set_last_error(ZK_ERROR);
+        return ZK_ERROR;
+    }
+
+    rc = 0;
+    n = 0;
+    for (i = 1; i <= len && rc >= 0; i++) {
+        if (i != len && path[i] != '/') continue;
+        memcpy(prefix, path, i);
+        prefix[i] = '\0';
+        struct CreateRequest req = {prefix, value, default_acl, 0};
+        oas[n] = new_request(CREATE_OPCODE, serialized_size_CreateRequest(&req));
+        rc = oas[n] ? jute_encode_CreateRequest(oas[n], &req) : ZK_ERROR;
+        n++;
+    }
+    free(prefix);
+    if (rc < 0) {
+        status = ZK_ERROR;
+        goto END;
+    }
+
+    status = pipeline_requests(c, oas, ias, n);
+    cause = ZNONODE;
+    for (i = 0; i < n && ias[i]; i++) {
+        err = decode_reply_header(c, ias[i]);
+        if (i == n - 1) {
+            // the leaf keeps the create semantics, a leaf without a parent
+            // reports why the parent couldn't be created
+            if (status == ZK_OK) status = err == ZNONODE ? cause : err;
+        } else if (err != ZNONODE) {
+            // the server checks the ACL of the parent first, an ancestor
+            // the caller can't create in answers ZNOAUTH though it exists,
+            // so only the deepest level that isn't there counts
+            cause = err == ZOK || err == ZNODEEXISTS ? ZNONODE : err;
         }
     }
+
+END:
+    for (i = 0; i < n; i++) {
+        destory_archive(oas[i], ias[i]);
+    }
+    free(oas);
+    free(ias);
+    set_last_error(status);
     return status;
 }
 
-int zk_exists(zk_client *c, char *path, struct Stat *stat) {
+static int exists_request(zk_client *c, char *path, int watch, struct Stat *stat) {
     int rc, err, result;
     struct oarchive *oa = NULL;
     struct iarchive *ia = NULL;
     struct ExistsResponse resp;
 
-    if (!c || !path) return ZK_ERROR;
-    // send exist request
-    oa = create_buffer_oarchive();
-    struct ExistsRequest req = {path, 0};
-    rc = add_request_header(oa, EXISTS_OPCODE);
-    rc = rc < 0 ? rc : serialize_ExistsRequest(oa, "req", &req);
-
-    pthread_mutex_lock(&c->lock);
-    rc = rc < 0 ? rc : send_request(c, oa);
+    struct ExistsRequest req = {path, watch};
+    oa = new_request(EXISTS_OPCODE, serialized_size_ExistsRequest(&req));
+    rc = oa ? jute_encode_ExistsRequest(oa, &req) : ZK_ERROR;
 
-    if (rc != ZK_OK || !(ia = recv_response(c))) {
-        err = rc != ZK_OK ? rc: c->last_err;
+    rc = rc < 0 ? rc : pipeline_requests(c, &oa, &ia, 1);
+    if (rc != ZK_OK) {
+        err = rc;
         goto ERROR;
     }
-    pthread_mutex_unlock(&c->lock);
 
     if ((err = decode_reply_header(c, ia)) && err != ZNONODE) {
         goto ERROR;
     }
     result = err == ZNONODE ? 0 : 1;
     if (result) {
-        deserialize_ExistsResponse(ia, "resp", &resp);
+        jute_decode_ExistsResponse(ia, &resp);
         if (stat) {
             *stat = resp.stat;
         }
@@ -299,11 +1970,35 @@ int zk_exists(zk_client *c, char *path, struct Stat *stat) {
     return result;
 
 ERROR:
-    pthread_mutex_unlock(&c->lock);
     destory_archive(oa, ia);
     return err;
 }
 
+int zk_exists(zk_client *c, char *path, struct Stat *stat) {
+    int result, room = 0;
+    uint64_t epoch = 0;
+
+    if (!c || !path) return ZK_ERROR;
+    // a path known to be missing is answered without the server
+    if (c->neg_max > 0) {
+        pthread_mutex_lock(&c->neg_lock);
+        if (*find_neg(c, path, adler32(1, path, strlen(path)))) {
+            pthread_mutex_unlock(&c->neg_lock);
+            return 0;
+        }
+        epoch = c->neg_epoch;
+        room = c->neg_count < c->neg_max;
+        pthread_mutex_unlock(&c->neg_lock);
+    }
+    result = exists_request(c, path, 0, stat);
+    // only a missing path is cached, so only then is a watch left to
+    // invalidate it; an existing node never gets one from here.
+    if (result == 0 && room && (result = exists_request(c, path, 1, stat)) == 0) {
+        neg_add(c, path, epoch);
+    }
+    return result;
+}
+
 int zk_stat(zk_client *c, char *path, struct Stat *stat) {
     int rc; 
 
@@ -312,43 +2007,341 @@ int zk_stat(zk_client *c, char *path, struct Stat *stat) {
     return rc == 1 ? ZK_OK : rc;
 }
 
+// cache_store keeps a copy of a reply in the cache. A watch that fired
+// since epoch may have been for this path, so the entry then ages like an
+// unwatched one.
+static void cache_store(zk_client *c, int opcode, const char *path, char *frame, int len,
+        int watched, uint64_t epoch) {
+    size_t path_len = strlen(path);
+    uint32_t hash = adler32(1, path, path_len);
+    char *copy, *old = NULL;
+    struct cache_entry *e, **pos;
+
+    if (!(copy = malloc(len))) return;
+    memcpy(copy, frame, len);
+    pthread_mutex_lock(&c->cache_lock);
+    pos = find_entry(c, opcode, path, hash);
+    if (!(e = *pos) && c->cache_count < c->cache_max &&
+            (e = malloc(sizeof(*e) + path_len + 1))) {
+        e->next = NULL;
+        e->hash = hash;
+        e->opcode = opcode;
+        e->frame = NULL;
+        memcpy(e->path, path, path_len + 1);
+        *pos = e;
+        c->cache_count++;
+    }
+    if (e) {
+        old = e->frame;
+        e->frame = copy;
+        e->len = len;
+        e->watched = watched && epoch == c->cache_epoch;
+        e->refreshing = 0;
+        e->fetched = mstime();
+        copy = NULL;
+    }
+    pthread_mutex_unlock(&c->cache_lock);
+    free(old);
+    free(copy);
+}
+
+// cache_lookup copies the cached reply to a read if the mode accepts it.
+// *refresh is set when a stale-while-revalidate read should refresh the
+// entry, only one read at a time gets it.
+static int cache_lookup(zk_client *c, int opcode, const char *path, struct zk_read_opts *opts,
+        char **frame, int *len, int *refresh, uint64_t *epoch) {
+    int hit = 0;
+    struct cache_entry *e;
+
+    *refresh = 0;
+    pthread_mutex_lock(&c->cache_lock);
+    *epoch = c->cache_epoch;
+    e = *find_entry(c, opcode, path, adler32(1, path, strlen(path)));
+    if (e && e->watched) {
+        hit = 1;
+    } else if (e && opts->mode == ZK_READ_TTL) {
+        hit = mstime() - e->fetched < opts->ttl;
+    } else if (e && opts->mode == ZK_READ_SWR) {
+        hit = 1;
+        if (mstime() - e->fetched >= opts->ttl && !e->refreshing) {
+            e->refreshing = 1;
+            *refresh = 1;
+        }
+    }
+    if (hit && !(*frame = malloc(e->len))) hit = 0;
+    if (hit) {
+        memcpy(*frame, e->frame, e->len);
+        *len = e->len;
+    }
+    pthread_mutex_unlock(&c->cache_lock);
+    return hit;
+}
+
+// read_request encodes a get or a children read of path
+static struct oarchive *read_request(int opcode, char *path, int watch) {
+    int rc;
+    struct oarchive *oa;
+    struct GetDataRequest data_req = {path, watch};
+    struct GetChildrenRequest children_req = {path, watch};
+
+    if (opcode == GETDATA_OPCODE) {
+        oa = new_request(opcode, serialized_size_GetDataRequest(&data_req));
+        rc = oa ? jute_encode_GetDataRequest(oa, &data_req) : ZK_ERROR;
+    } else {
+        oa = new_request(opcode, serialized_size_GetChildrenRequest(&children_req));
+        rc = oa ? jute_encode_GetChildrenRequest(oa, &children_req) : ZK_ERROR;
+    }
+    if (oa && rc < 0) close_buffer_oarchive(&oa, 1);
+    return oa;
+}
+
+// cache_refresh is a read sent by a stale-while-revalidate hit, its reply
+// goes to the cache instead of to a caller.
+struct cache_refresh {
+    struct zk_call call;
+    zk_client *c;
+    struct oarchive *oa;
+    int opcode;
+    char path[];
+};
+
+static void complete_refresh(struct zk_call *call, char *frame, int len, int err) {
+    struct cache_refresh *r = call->arg;
+
+    if (err == ZK_OK && len >= 16 && (int32_t)load_be32(frame + 12) == ZOK) {
+        cache_store(r->c, r->opcode, r->path, frame, len, 0, 0);
+    } else {
+        // the next read asks the server, be it for the error or for the node
+        cache_drop(r->c, r->opcode, r->path);
+    }
+    free(frame);
+    close_buffer_oarchive(&r->oa, 1);
+    pthread_mutex_destroy(&call->lock);
+    pthread_cond_destroy(&call->cond);
+    free(r);
+}
+
+// refresh_entry reads path again in the background, outside of the
+// in-flight window.
+static void refresh_entry(zk_client *c, int opcode, char *path) {
+    size_t len = strlen(path);
+    int64_t deadline;
+    struct cache_refresh *r;
+
+    if (!(r = malloc(sizeof(*r) + len + 1)) || !(r->oa = read_request(opcode, path, 0))) {
+        free(r);
+        cache_drop(c, opcode, path);
+        return;
+    }
+    r->c = c;
+    r->opcode = opcode;
+    memcpy(r->path, path, len + 1);
+    deadline = c->request_timeout > 0 ? mstime() + c->request_timeout : 0;
+    submit_calls(c, &r->call, &r->oa, 1, ZK_LANE_INTERACTIVE, deadline, complete_refresh, r);
+}
+
+// read_frame returns the reply to a get or a children read of path, from
+// the cache when the read mode in opts accepts what is there. NULL opts
+// is ZK_READ_STRICT.
+static int read_frame(zk_client *c, int opcode, char *path, struct zk_read_opts *opts,
+        struct iarchive **ia) {
+    int rc, len, refresh, mode, watch;
+    uint64_t epoch = 0;
+    char *frame = NULL;
+    struct oarchive *oa;
+
+    mode = opts && c->cache_max > 0 ? opts->mode : ZK_READ_STRICT;
+    if (mode != ZK_READ_STRICT && cache_lookup(c, opcode, path, opts, &frame, &len,
+                &refresh, &epoch)) {
+        if (refresh) refresh_entry(c, opcode, path);
+        *ia = create_buffer_iarchive(frame, len);
+        return *ia ? ZK_OK : ZK_ERROR;
+    }
+    watch = mode == ZK_READ_WATCH;
+    if (!(oa = read_request(opcode, path, watch))) return ZK_ERROR;
+    rc = call_requests(c, &oa, &frame, &len, 1);
+    close_buffer_oarchive(&oa, 1);
+    if (rc != ZK_OK) return rc;
+    // errors aren't cached, the server sets no watch for a missing node
+    if (mode != ZK_READ_STRICT && len >= 16 && (int32_t)load_be32(frame + 12) == ZOK) {
+        cache_store(c, opcode, path, frame, len, watch, epoch);
+    }
+    if (!(*ia = create_buffer_iarchive(frame, len))) {
+        free(frame);
+        return ZK_ERROR;
+    }
+    return ZK_OK;
+}
+
 int zk_get(zk_client *c, char *path,  struct buffer *data) {
-    int rc, err;
-    struct oarchive *oa = NULL;
+    return zk_get_opts(c, path, data, NULL, NULL);
+}
+
+// zk_get_opts is zk_get with the stat of the node and a read mode, see
+// ZK_READ_STRICT and the others.
+int zk_get_opts(zk_client *c, char *path, struct buffer *data, struct Stat *stat,
+        struct zk_read_opts *opts) {
+    int err;
     struct iarchive *ia = NULL;
     struct GetDataResponse resp;
 
     if (!c || !path || !data) {
         return ZK_ERROR;
     }
-    oa = create_buffer_oarchive();
-    struct GetDataRequest req = {path, 0};
-    rc = add_request_header(oa, GETDATA_OPCODE);
-    rc = rc < 0 ? rc : serialize_GetDataRequest(oa, "req", &req);
-
-    pthread_mutex_lock(&c->lock);
-    rc = rc < 0 ? rc : send_request(c, oa);
-    if (rc != ZK_OK || !(ia = recv_response(c))) {
-        err = rc != ZK_OK ? rc: c->last_err;
+    if ((err = read_frame(c, GETDATA_OPCODE, path, opts, &ia)) != ZK_OK) {
         goto ERROR;
     }
-    pthread_mutex_unlock(&c->lock);
-
     if ((err = decode_reply_header(c, ia))) {
         goto ERROR;
     }
-    rc = deserialize_GetDataResponse(ia, "resp", &resp);
-    if (rc < 0) goto ERROR;
+    if (jute_decode_GetDataResponse(ia, &resp) < 0) {
+        err = ZK_ERROR;
+        goto ERROR;
+    }
     *data = resp.data;
-    destory_archive(oa, ia);
+    if (stat) *stat = resp.stat;
+    destory_archive(NULL, ia);
     return  ZK_OK;
 
 ERROR:
-    pthread_mutex_unlock(&c->lock);
-    destory_archive(oa, ia);
+    destory_archive(NULL, ia);
     return err;
 }
 
+// zk_read_batch sends n reads with a single pipelined burst, reads[i].err
+// holds the result of each. The data and children of a read are released
+// with deallocate_Buffer and deallocate_String_vector.
+int zk_read_batch(zk_client *c, struct zk_read *reads, int n) {
+    int i, rc, err, status;
+    struct oarchive **oas;
+    struct iarchive **ias;
+    struct zk_read *r;
+    struct GetDataResponse data_resp;
+    struct GetChildren2Response children_resp;
+    struct ExistsResponse exists_resp;
+
+    if (!c || !reads || n <= 0) {
+        return ZK_ERROR;
+    }
+    oas = calloc(n, sizeof(*oas));
+    ias = calloc(n, sizeof(*ias));
+    if (!oas || !ias) {
+        free(oas);
+        free(ias);
+        set_last_error(ZK_ERROR);
+        return ZK_ERROR;
+    }
+    rc = 0;
+    for (i = 0; i < n && rc >= 0; i++) {
+        r = &reads[i];
+        if (r->type == GETDATA_OPCODE) {
+            struct GetDataRequest req = {r->path, r->watch};
+            oas[i] = new_request(r->type, serialized_size_GetDataRequest(&req));
+            rc = oas[i] ? jute_encode_GetDataRequest(oas[i], &req) : ZK_ERROR;
+        } else if (r->type == GETCHILDREN2_OPCODE) {
+            struct GetChildren2Request req = {r->path, r->watch};
+            oas[i] = new_request(r->type, serialized_size_GetChildren2Request(&req));
+            rc = oas[i] ? jute_encode_GetChildren2Request(oas[i], &req) : ZK_ERROR;
+        } else if (r->type == EXISTS_OPCODE) {
+            struct ExistsRequest req = {r->path, r->watch};
+            oas[i] = new_request(r->type, serialized_size_ExistsRequest(&req));
+            rc = oas[i] ? jute_encode_ExistsRequest(oas[i], &req) : ZK_ERROR;
+        } else {
+            rc = ZK_ERROR;
+        }
+    }
+    status = rc < 0 ? ZK_ERROR : pipeline_requests(c, oas, ias, n);
+
+    for (i = 0; i < n; i++) {
+        r = &reads[i];
+        r->data.len = 0;
+        r->data.buff = NULL;
+        r->children.count = 0;
+        r->children.data = NULL;
+        if (!ias[i]) {
+            r->err = status;
+            continue;
+        }
+        if ((err = decode_reply_header(c, ias[i])) == ZOK) {
+            if (r->type == GETDATA_OPCODE) {
+                rc = jute_decode_GetDataResponse(ias[i], &data_resp);
+                r->data = data_resp.data;
+                r->stat = data_resp.stat;
+            } else if (r->type == GETCHILDREN2_OPCODE) {
+                rc = jute_decode_GetChildren2Response(ias[i], &children_resp);
+                r->children = children_resp.children;
+                r->stat = children_resp.stat;
+            } else {
+                rc = jute_decode_ExistsResponse(ias[i], &exists_resp);
+                r->stat = exists_resp.stat;
+            }
+            if (rc < 0) err = ZMARSHALLINGERROR;
+        }
+        r->err = err;
+    }
+    for (i = 0; i < n; i++) {
+        destory_archive(oas[i], ias[i]);
+    }
+    free(oas);
+    free(ias);
+    set_last_error(status);
+    return status;
+}
+
+// zk_get_batch fetches the data and stat of n nodes with a single pipelined
+// burst. errs[i] holds the result of paths[i], and data[i] must be released
+// with deallocate_Buffer when errs[i] is ZOK. stats may be NULL.
+int zk_get_batch(zk_client *c, char **paths, int n, struct buffer *data, struct Stat *stats, int *errs) {
+    int i, rc, err, status;
+    struct oarchive **oas;
+    struct iarchive **ias;
+    struct GetDataResponse resp;
+
+    if (!c || !paths || n <= 0 || !data || !errs) {
+        return ZK_ERROR;
+    }
+    oas = calloc(n, sizeof(*oas));
+    ias = calloc(n, sizeof(*ias));
+    if (!oas || !ias) {
+        free(oas);
+        free(ias);
+        set_last_error(ZK_ERROR);
+        return ZK_ERROR;
+    }
+    rc = 0;
+    for (i = 0; i < n && rc >= 0; i++) {
+        struct GetDataRequest req = {paths[i], 0};
+        oas[i] = new_request(GETDATA_OPCODE, serialized_size_GetDataRequest(&req));
+        rc = oas[i] ? jute_encode_GetDataRequest(oas[i], &req) : ZK_ERROR;
+    }
+    status = rc < 0 ? ZK_ERROR : pipeline_requests(c, oas, ias, n);
+
+    for (i = 0; i < n; i++) {
+        data[i].len = 0;
+        data[i].buff = NULL;
+        if (!ias[i]) {
+            errs[i] = status;
+            continue;
+        }
+        if ((err = decode_reply_header(c, ias[i])) == ZOK) {
+            if (jute_decode_GetDataResponse(ias[i], &resp) < 0) {
+                err = ZMARSHALLINGERROR;
+            } else {
+                data[i] = resp.data;
+                if (stats) stats[i] = resp.stat;
+            }
+        }
+        errs[i] = err;
+    }
+    for (i = 0; i < n; i++) {
+        destory_archive(oas[i], ias[i]);
+    }
+    free(oas);
+    free(ias);
+    set_last_error(status);
+    return status;
+}
+
 int zk_del(zk_client *c, char *path) {
     int rc, err;
     struct oarchive *oa = NULL;
@@ -357,18 +2350,15 @@ int zk_del(zk_client *c, char *path) {
     if (!c || !path) {
         return ZK_ERROR;
     }
-    oa = create_buffer_oarchive();
-    rc = add_request_header(oa, DELETE_OPCODE);
     struct DeleteRequest req = {path, -1};
-    rc = rc < 0 ? rc : serialize_DeleteRequest(oa, "req", &req);
+    oa = new_request(DELETE_OPCODE, serialized_size_DeleteRequest(&req));
+    rc = oa ? jute_encode_DeleteRequest(oa, &req) : ZK_ERROR;
 
-    pthread_mutex_unlock(&c->lock);
-    rc = rc < 0 ? rc : send_request(c, oa);
-    if (rc != ZK_OK|| !(ia = recv_response(c))) {
-        err = rc != ZK_OK ? rc: c->last_err;
+    rc = rc < 0 ? rc : pipeline_requests(c, &oa, &ia, 1);
+    if (rc != ZK_OK) {
+        err = rc;
         goto ERROR;
     }
-    pthread_mutex_unlock(&c->lock);
 
     if ((err = decode_reply_header(c, ia))) {
         goto ERROR;
@@ -377,7 +2367,6 @@ int zk_del(zk_client *c, char *path) {
     return ZK_OK;
 
 ERROR:
-    pthread_mutex_unlock(&c->lock);
     destory_archive(oa, ia);
     return err;
 }
@@ -392,67 +2381,267 @@ int zk_set(zk_client *c, char *path, struct buffer *data) {
     if (!c || !path) {
         return ZK_ERROR;
     }
-    oa = create_buffer_oarchive();
-    rc = add_request_header(oa, SETDATA_OPCODE);
     struct SetDataRequest req = {path, *data, -1};
-    rc = rc < 0 ? rc : serialize_SetDataRequest(oa, "req", &req);
+    oa = new_request(SETDATA_OPCODE, serialized_size_SetDataRequest(&req));
+    rc = oa ? jute_encode_SetDataRequest(oa, &req) : ZK_ERROR;
 
-    pthread_mutex_lock(&c->lock);
-    rc = rc < 0 ? rc : send_request(c, oa);
-    if (rc != ZK_OK || !(ia = recv_response(c))) {
-        err = rc != ZK_OK ? rc: c->last_err;
+    rc = rc < 0 ? rc : pipeline_requests(c, &oa, &ia, 1);
+    if (rc != ZK_OK) {
+        err = rc;
         goto ERROR;
     }
-    pthread_mutex_unlock(&c->lock);
 
     if ((err = decode_reply_header(c, ia))) {
         goto ERROR;
     }
-    rc = deserialize_SetDataResponse(ia, "resp", &resp);
+    rc = jute_decode_SetDataResponse(ia, &resp);
     destory_archive(oa, ia);
     deallocate_SetDataResponse(&resp);
     return rc < 0 ? ZK_ERROR : ZK_OK;
 
 ERROR:
-    pthread_mutex_unlock(&c->lock);
     destory_archive(oa, ia);
     return err;
 }
 
 int zk_get_children(zk_client *c, char *path, struct String_vector *children) {
-    int rc, err;
-    struct oarchive *oa = NULL;
+    return zk_get_children_opts(c, path, children, NULL);
+}
+
+// zk_get_children_opts is zk_get_children with a read mode
+int zk_get_children_opts(zk_client *c, char *path, struct String_vector *children,
+        struct zk_read_opts *opts) {
+    int err;
     struct iarchive *ia = NULL;
     struct GetChildrenResponse resp;
 
     if (!c || !path) {
         return ZK_ERROR;
     }
-    oa = create_buffer_oarchive();
-    rc = add_request_header(oa, GETCHILDREN_OPCODE);
+    if ((err = read_frame(c, GETCHILDREN_OPCODE, path, opts, &ia)) != ZK_OK) {
+        goto ERROR;
+    }
+    if ((err = decode_reply_header(c, ia))) {
+        goto ERROR;
+    }
+    if (jute_decode_GetChildrenResponse(ia, &resp) < 0) {
+        err = ZK_ERROR;
+        goto ERROR;
+    }
+
+    *children = resp.children;
+    destory_archive(NULL, ia);
+    return ZK_OK;
+
+ERROR:
+    destory_archive(NULL, ia);
+    return err;
+}
+
+// zk_get_children_view is zk_get_children without a copy per child, the
+// names point into the reply frame which is returned in frame. Both are
+// released with zk_release_children_view.
+int zk_get_children_view(zk_client *c, char *path, struct String_vector *children, char **frame) {
+    int rc, err, len;
+    char *buf = NULL;
+    struct oarchive *oa = NULL;
+    struct iarchive *ia = NULL;
+    struct GetChildrenResponse resp = {{0, NULL}};
+
+    if (!c || !path || !frame) {
+        return ZK_ERROR;
+    }
     struct GetChildrenRequest req = {path, 0};
-    rc = rc < 0 ? rc : serialize_GetChildrenRequest(oa, "req", &req);
+    oa = new_request(GETCHILDREN_OPCODE, serialized_size_GetChildrenRequest(&req));
+    rc = oa ? jute_encode_GetChildrenRequest(oa, &req) : ZK_ERROR;
 
-    pthread_mutex_lock(&c->lock);
-    rc = rc < 0 ? rc : send_request(c, oa);
-    if (rc != ZK_OK || !(ia = recv_response(c))) {
-        err = rc != ZK_OK ? rc: c->last_err;
+    rc = rc < 0 ? rc : call_requests(c, &oa, &buf, &len, 1);
+    if (rc != ZK_OK) {
+        err = rc;
         goto ERROR;
     }
-    pthread_mutex_unlock(&c->lock);
 
+    ia = create_buffer_iarchive_view(buf, len);
     if ((err = decode_reply_header(c, ia))) {
         goto ERROR;
     }
-    rc = deserialize_GetChildrenResponse(ia, "resp", &resp);
-    if (rc < 0) goto ERROR;
+    rc = jute_decode_GetChildrenResponse(ia, &resp);
+    if (rc < 0) {
+        free(resp.children.data);
+        err = ZK_ERROR;
+        goto ERROR;
+    }
 
     *children = resp.children;
-    destory_archive(oa, ia);
+    *frame = buf;
+    close_buffer_iarchive(&ia);
+    close_buffer_oarchive(&oa, 1);
+    return ZK_OK;
+
+ERROR:
+    if (ia) close_buffer_iarchive(&ia);
+    free(buf);
+    close_buffer_oarchive(&oa, 1);
+    return err;
+}
+
+void zk_release_children_view(struct String_vector *children, char *frame) {
+    free(children->data);
+    children->data = NULL;
+    children->count = 0;
+    free(frame);
+}
+
+// pack_children copies a children list into a single zk_children block,
+// names are stored back to back behind the offsets array.
+struct zk_children *pack_children(struct String_vector *v) {
+    int32_t i, names_len = 0, len;
+    struct zk_children *children;
+
+    for (i = 0; i < v->count; i++) {
+        names_len += strlen(v->data[i]) + 1;
+    }
+    children = malloc(sizeof(*children) + sizeof(uint32_t) * v->count + names_len);
+    if (!children) return NULL;
+    children->count = v->count;
+    children->names_len = names_len;
+    children->names = (char *)(children->offsets + v->count);
+    for (i = 0, names_len = 0; i < v->count; i++) {
+        len = strlen(v->data[i]) + 1;
+        children->offsets[i] = names_len;
+        memcpy(children->names + names_len, v->data[i], len);
+        names_len += len;
+    }
+    return children;
+}
+
+// zk_get_children_packed returns the children of path as one zk_children
+// block which is released with a single free.
+int zk_get_children_packed(zk_client *c, char *path, struct zk_children **children) {
+    int rc;
+    char *frame;
+    struct String_vector v;
+
+    if (!children) return ZK_ERROR;
+    if ((rc = zk_get_children_view(c, path, &v, &frame)) != ZK_OK) {
+        return rc;
+    }
+    *children = pack_children(&v);
+    zk_release_children_view(&v, frame);
+    if (!*children) {
+        set_last_error(ZK_ERROR);
+        return ZK_ERROR;
+    }
     return ZK_OK;
+}
+
+// serialize_op encodes op with its multi header into oa, or returns the
+// number of bytes it encodes to when oa is NULL.
+static int serialize_op(struct oarchive *oa, struct zk_op *op) {
+    struct MultiHeader header = {op->type, 0, -1};
+    int rc, size;
+
+    size = serialized_size_MultiHeader(&header);
+    rc = oa ? jute_encode_MultiHeader(oa, &header) : 0;
+    if (rc < 0) return rc;
+    switch (op->type) {
+        case CREATE_OPCODE: {
+            struct CreateRequest req = {op->path, op->data, default_acl, op->flags};
+            return oa ? jute_encode_CreateRequest(oa, &req) : size + serialized_size_CreateRequest(&req);
+        }
+        case DELETE_OPCODE: {
+            struct DeleteRequest req = {op->path, op->version};
+            return oa ? jute_encode_DeleteRequest(oa, &req) : size + serialized_size_DeleteRequest(&req);
+        }
+        case SETDATA_OPCODE: {
+            struct SetDataRequest req = {op->path, op->data, op->version};
+            return oa ? jute_encode_SetDataRequest(oa, &req) : size + serialized_size_SetDataRequest(&req);
+        }
+        case CHECK_OPCODE: {
+            struct CheckVersionRequest req = {op->path, op->version};
+            return oa ? jute_encode_CheckVersionRequest(oa, &req) : size + serialized_size_CheckVersionRequest(&req);
+        }
+    }
+    return ZBADARGUMENTS;
+}
+
+// zk_multi applies all ops atomically in a single request. It returns ZOK
+// when every op succeeded, otherwise the error of the op which aborted the
+// transaction; errs[i], if not NULL, holds the result of each op.
+int zk_multi(zk_client *c, struct zk_op *ops, int n, int *errs) {
+    int i, rc, err, size;
+    struct oarchive *oa = NULL;
+    struct iarchive *ia = NULL;
+    struct MultiHeader header = {-1, 1, -1};
+    struct ErrorResponse err_resp;
+    struct CreateResponse create_resp;
+    struct SetDataResponse set_resp;
+
+    if (!c || !ops || n <= 0) return ZK_ERROR;
+    size = serialized_size_MultiHeader(&header);
+    for (i = 0; i < n; i++) {
+        if ((rc = serialize_op(NULL, &ops[i])) < 0) {
+            err = rc;
+            goto ERROR;
+        }
+        size += rc;
+    }
+    oa = new_request(MULTI_OPCODE, size);
+    rc = oa ? ZK_OK : ZK_ERROR;
+    for (i = 0; i < n && rc >= 0; i++) {
+        rc = serialize_op(oa, &ops[i]);
+    }
+    rc = rc < 0 ? rc : jute_encode_MultiHeader(oa, &header);
+    if (rc < 0) {
+        err = rc == ZBADARGUMENTS ? rc : ZK_ERROR;
+        goto ERROR;
+    }
+
+    if ((rc = pipeline_requests(c, &oa, &ia, 1)) != ZK_OK) {
+        err = rc;
+        goto ERROR;
+    }
+    // a failed transaction still carries the per-op results, so only
+    // bail out on system errors here.
+    err = decode_reply_header(c, ia);
+    if (err != ZOK && err > ZAPIERROR) goto ERROR;
+
+    for (i = 0; ; i++) {
+        if (jute_decode_MultiHeader(ia, &header) < 0 || (!header.done && i >= n)) {
+            err = ZMARSHALLINGERROR;
+            goto ERROR;
+        }
+        if (header.done) break;
+        rc = ZOK;
+        switch (header.type) {
+            case -1:
+                if (jute_decode_ErrorResponse(ia, &err_resp) < 0) {
+                    err_resp.err = ZMARSHALLINGERROR;
+                }
+                rc = err_resp.err;
+                break;
+            case CREATE_OPCODE:
+                create_resp.path = NULL;
+                if (jute_decode_CreateResponse(ia, &create_resp) < 0) {
+                    rc = ZMARSHALLINGERROR;
+                }
+                deallocate_CreateResponse(&create_resp);
+                break;
+            case SETDATA_OPCODE:
+                if (jute_decode_SetDataResponse(ia, &set_resp) < 0) {
+                    rc = ZMARSHALLINGERROR;
+                }
+                break;
+        }
+        if (errs) errs[i] = rc;
+        if (err == ZOK && rc != ZOK && rc != ZRUNTIMEINCONSISTENCY) err = rc;
+    }
+    set_last_error(err);
+    destory_archive(oa, ia);
+    return err;
 
 ERROR:
-    pthread_mutex_unlock(&c->lock);
+    set_last_error(err);
     destory_archive(oa, ia);
     return err;
 }
@@ -463,12 +2652,12 @@ static int do_header_request(zk_client *c, int opcode) {
     struct iarchive *ia = NULL;
 
     if (!c) return ZK_ERROR;
-    oa = create_buffer_oarchive();
-    rc = add_request_header(oa, opcode);
+    oa = new_request(opcode, 0);
+    rc = oa ? ZK_OK : ZK_ERROR;
 
-    rc = rc < 0 ? rc : send_request(c, oa);
-    if (rc != ZK_OK || !(ia = recv_response(c))) {
-        err = rc != ZK_OK ? rc: c->last_err;
+    rc = rc < 0 ? rc : pipeline_requests(c, &oa, &ia, 1);
+    if (rc != ZK_OK) {
+        err = rc;
         goto ERROR;
     }
 
@@ -484,19 +2673,9 @@ ERROR:
 }
 
 int zk_ping(zk_client *c) {
-    int rc;
-
-    pthread_mutex_lock(&c->lock);
-    rc = do_header_request(c, PING_OPCODE);
-    pthread_mutex_unlock(&c->lock);
-
-    return rc;
+    return do_header_request(c, PING_OPCODE);
 }
 
 int zk_close(zk_client *c) {
-    int rc;
-
-    rc = do_header_request(c, CLOSE_OPCODE);
-    close(c->sock);
-    return rc;
+    return do_header_request(c, CLOSE_OPCODE);
 }
@@ -1,17 +1,127 @@
 #ifndef __REQUEST_H_
 #define __REQUEST_H_
 
+#include <stdint.h>
 #include "zkclient.h"
 
+#define NOTIFY_OPCODE 0
+#define CREATE_OPCODE 1
+#define DELETE_OPCODE 2
+#define EXISTS_OPCODE 3
+#define GETDATA_OPCODE 4
+#define SETDATA_OPCODE 5
+#define GETACL_OPCODE 6
+#define SETACL_OPCODE 7
+#define GETCHILDREN_OPCODE 8
+#define SYNC_OPCODE 9
+#define PING_OPCODE 11
+#define GETCHILDREN2_OPCODE 12
+#define CHECK_OPCODE 13
+#define MULTI_OPCODE 14
+#define SETAUTH_OPCODE 100
+#define SETWATCHES_OPCODE 101
+#define CLOSE_OPCODE -11
+
+// IO_CLOSED in c->submitted means no I/O thread is running, requests then
+// fail at once with ZK_SOCKET_ERR.
+#define IO_CLOSED ((struct zk_call *)1)
+
+// Requests are written lane by lane. Control traffic goes first, bulk
+// requests are held back so they don't queue ahead of interactive ones.
+#define ZK_LANE_CONTROL 0
+#define ZK_LANE_INTERACTIVE 1
+#define ZK_LANE_BULK 2
+
+// a burst with a frame larger than this is bulk whatever the lane of its
+// caller
+#define BULK_FRAME_SIZE (64 * 1024)
+
+#define ZOO_EPHEMERAL 1
+#define ZOO_SEQUENCE 2
+
+// read modes of zk_get_opts and zk_get_children_opts, they trade freshness
+// for latency per call
+#define ZK_READ_STRICT 0 // ask the server
+#define ZK_READ_WATCH 1 // cached with a watch, until the node changes
+#define ZK_READ_TTL 2 // cached for ttl ms
+#define ZK_READ_SWR 3 // cached, refreshed in the background once older than ttl ms
+
+struct zk_read_opts {
+    int mode;
+    int ttl; // ms
+};
+
+// types of watch notifications
+#define ZOO_CREATED_EVENT 1
+#define ZOO_DELETED_EVENT 2
+#define ZOO_CHANGED_EVENT 3
+#define ZOO_CHILD_EVENT 4
+#define ZOO_SESSION_EVENT -1
+
+// one operation of a multi transaction, type is one of CREATE_OPCODE,
+// DELETE_OPCODE, SETDATA_OPCODE or CHECK_OPCODE.
+struct zk_op {
+    int32_t type;
+    char *path;
+    struct buffer data;
+    int32_t flags;
+    int32_t version;
+};
+
+// zk_read is one read of zk_read_batch, type is GETDATA_OPCODE,
+// GETCHILDREN2_OPCODE or EXISTS_OPCODE and watch leaves a watch on path.
+// When err is ZOK the read carries the stat and the data or children.
+struct zk_read {
+    int32_t type;
+    char *path;
+    int watch;
+    int32_t err;
+    struct buffer data;
+    struct String_vector children;
+    struct Stat stat;
+};
+
+// zk_children is a children listing in one allocation, the i-th name is the
+// NUL-terminated string at names + offsets[i].
+struct zk_children {
+    int32_t count;
+    int32_t names_len;
+    char *names;
+    uint32_t offsets[];
+};
+
+static inline const char *zk_child(struct zk_children *children, int i) {
+    return children->names + children->offsets[i];
+}
+
 int authenticate(zk_client *c);
+int start_io_thread(zk_client *c);
+void stop_io_thread(zk_client *c);
+void request_ping(zk_client *c);
+void zk_set_lane(int lane);
+void exists_cache_clear(zk_client *c);
+void read_cache_clear(zk_client *c);
 int zk_del(zk_client *c, char *path);
 int zk_stat(zk_client *c, char *path, struct Stat *stat); 
 int zk_exists(zk_client *c, char *path, struct Stat *stat);
 int zk_set(zk_client *c, char *path, struct buffer *data); 
 int zk_get(zk_client *c, char *path,  struct buffer* data); 
+int zk_get_opts(zk_client *c, char *path, struct buffer *data, struct Stat *stat,
+        struct zk_read_opts *opts);
 int zk_create(zk_client *c, char *path, char *data, int size, int flags); 
 int zk_mkdir(zk_client *c, char *path); 
 int zk_get_children(zk_client *c, char *path, struct String_vector *children); 
+int zk_get_children_opts(zk_client *c, char *path, struct String_vector *children,
+        struct zk_read_opts *opts);
+int zk_get_children_view(zk_client *c, char *path, struct String_vector *children, char **frame);
+void zk_release_children_view(struct String_vector *children, char *frame);
+int zk_get_children_packed(zk_client *c, char *path, struct zk_children **children);
+struct zk_children *pack_children(struct String_vector *v);
+int zk_get_batch(zk_client *c, char **paths, int n, struct buffer *data, struct Stat *stats, int *errs);
+int zk_multi(zk_client *c, struct zk_op *ops, int n, int *errs);
+int zk_read_batch(zk_client *c, struct zk_read *reads, int n);
+int zk_add_watcher(zk_client *c, zk_watch_fn fn, void *arg);
+void zk_remove_watcher(zk_client *c, zk_watch_fn fn, void *arg);
 int zk_ping(zk_client *c);
 int zk_close(zk_client *c);
 
@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "util.h"
+#include "codec.h"
+#include "snapshot.h"
+#include "statblock.h"
+#include "zkclient.h"
+
+// The snapshot is decoded in place from the mapping, fields are read with
+// bounds checks against the end of the file instead of going through an
+// iarchive, which would copy every path and data buffer (and can't address
+// files over 2GB).
+static inline int read_int(const char **pos, const char *end, int32_t *v) {
+    if (end - *pos < 4) return ZK_ERROR;
+    *v = load_be32(*pos);
+    *pos += 4;
+    return ZK_OK;
+}
+
+static inline int read_long(const char **pos, const char *end, int64_t *v) {
+    if (end - *pos < 8) return ZK_ERROR;
+    *v = load_be64(*pos);
+    *pos += 8;
+    return ZK_OK;
+}
+
+// read_view returns a length-prefixed string or buffer without copying it,
+// len is -1 for null.
+static inline int read_view(const char **pos, const char *end, const char **ptr, int32_t *len) {
+    if (read_int(pos, end, len) != ZK_OK) return ZK_ERROR;
+    if (*len < 0) {
+        *len = -1;
+        *ptr = NULL;
+        return ZK_OK;
+    }
+    if (end - *pos < *len) return ZK_ERROR;
+    *ptr = *pos;
+    *pos += *len;
+    return ZK_OK;
+}
+
+static int skip_acl_vector(const char **pos, const char *end, int32_t count) {
+    int32_t i, perms, len;
+    const char *ptr;
+
+    for (i = 0; i < count; i++) {
+        if (read_int(pos, end, &perms) != ZK_OK ||
+            read_view(pos, end, &ptr, &len) != ZK_OK ||
+            read_view(pos, end, &ptr, &len) != ZK_OK) {
+            return ZK_ERROR;
+        }
+    }
+    return ZK_OK;
+}
+
+static int read_stat_persisted(const char **pos, const char *end, struct StatPersisted *stat) {
+    const char *p = *pos;
+
+    if (end - p < STAT_PERSISTED_SIZE) return ZK_ERROR;
+    stat->czxid = load_be64(p);
+    stat->mzxid = load_be64(p + 8);
+    stat->ctime = load_be64(p + 16);
+    stat->mtime = load_be64(p + 24);
+    stat->version = load_be32(p + 32);
+    stat->cversion = load_be32(p + 36);
+    stat->aversion = load_be32(p + 40);
+    stat->ephemeralOwner = load_be64(p + 44);
+    stat->pzxid = load_be64(p + 52);
+    *pos = p + STAT_PERSISTED_SIZE;
+    return ZK_OK;
+}
+
+struct snapshot *snapshot_open(const char *filename) {
+    int i;
+    int32_t count;
+    int64_t id;
+    const char *pos, *end;
+    struct stat st;
+    struct snapshot *s;
+
+    if (!filename || !(s = calloc(1, sizeof(*s)))) return NULL;
+    if ((s->fd = open(filename, O_RDONLY)) < 0) {
+        free(s);
+        return NULL;
+    }
+    if (fstat(s->fd, &st) != 0 || st.st_size < 16) goto ERROR;
+    s->size = st.st_size;
+    s->base = mmap(NULL, s->size, PROT_READ, MAP_PRIVATE, s->fd, 0);
+    if (s->base == MAP_FAILED) {
+        s->base = NULL;
+        goto ERROR;
+    }
+    madvise(s->base, s->size, MADV_SEQUENTIAL);
+
+    pos = s->base;
+    end = s->base + s->size;
+    read_int(&pos, end, &s->header.magic);
+    read_int(&pos, end, &s->header.version);
+    read_long(&pos, end, &s->header.dbid);
+    if (s->header.magic != SNAP_MAGIC) goto ERROR;
+
+    // sessions: count * (id, timeout)
+    if (read_int(&pos, end, &s->nsessions) != ZK_OK || s->nsessions < 0 ||
+        (end - pos) / 12 < s->nsessions) {
+        goto ERROR;
+    }
+    s->sessions = pos;
+    pos += (size_t)s->nsessions * 12;
+
+    // acl cache: count * (id, vector<ACL>)
+    if (read_int(&pos, end, &s->nacls) != ZK_OK || s->nacls < 0) goto ERROR;
+    s->acl_cache = pos;
+    for (i = 0; i < s->nacls; i++) {
+        if (read_long(&pos, end, &id) != ZK_OK ||
+            read_int(&pos, end, &count) != ZK_OK ||
+            skip_acl_vector(&pos, end, count) != ZK_OK) {
+            goto ERROR;
+        }
+    }
+    s->nodes = pos;
+    s->end = end;
+    snapshot_rewind(s);
+    return s;
+
+ERROR:
+    snapshot_close(s);
+    return NULL;
+}
+
+void snapshot_close(struct snapshot *s) {
+    if (!s) return;
+    if (s->base) munmap(s->base, s->size);
+    if (s->fd >= 0) close(s->fd);
+    free(s);
+}
+
+void snapshot_rewind(struct snapshot *s) {
+    s->pos = s->nodes;
+    s->nnodes = 0;
+    s->done = 0;
+}
+
+// snapshot_next_session and snapshot_next_acl iterate with a caller owned
+// cursor, *pos must be NULL on the first call. They return 1 while there are
+// entries left and 0 at the end.
+int snapshot_next_session(struct snapshot *s, const char **pos, struct snap_session *session) {
+    const char *end = s->sessions + (size_t)s->nsessions * 12;
+
+    if (!*pos) *pos = s->sessions;
+    if (*pos >= end) return 0;
+    read_long(pos, end, &session->id);
+    read_int(pos, end, &session->timeout);
+    return 1;
+}
+
+int snapshot_next_acl(struct snapshot *s, const char **pos, struct snap_acl *acl) {
+    if (!*pos) *pos = s->acl_cache;
+    if (*pos >= s->nodes) return 0;
+    read_long(pos, s->nodes, &acl->id);
+    read_int(pos, s->nodes, &acl->count);
+    acl->acls = *pos;
+    return skip_acl_vector(pos, s->nodes, acl->count) == ZK_OK ? 1 : ZK_ERROR;
+}
+
+// snapshot_next_node returns 1 and fills node for each node of the tree in
+// the order the server wrote them (parents first), 0 once the "/" end marker
+// is reached and ZK_ERROR on a truncated or corrupt file.
+int snapshot_next_node(struct snapshot *s, struct snap_node *node) {
+    const char *pos = s->pos;
+
+    if (s->done) return 0;
+    if (read_view(&pos, s->end, &node->path, &node->path_len) != ZK_OK) {
+        return ZK_ERROR;
+    }
+    if (node->path_len == 1 && node->path[0] == '/') {
+        s->pos = pos;
+        s->done = 1;
+        return 0;
+    }
+    if (read_view(&pos, s->end, &node->data, &node->data_len) != ZK_OK ||
+        read_long(&pos, s->end, &node->acl) != ZK_OK) {
+        return ZK_ERROR;
+    }
+    node->stat_raw = pos;
+    if (s->raw_stats) {
+        // the caller decodes the stats in bulk
+        if (s->end - pos < STAT_PERSISTED_SIZE) return ZK_ERROR;
+        pos += STAT_PERSISTED_SIZE;
+    } else if (read_stat_persisted(&pos, s->end, &node->stat) != ZK_OK) {
+        return ZK_ERROR;
+    }
+    s->pos = pos;
+    s->nnodes++;
+    return 1;
+}
+
+// snapshot_verify checks the Adler32 checksum the server appends after the
+// end marker. It walks the nodes itself when they haven't been consumed yet.
+int snapshot_verify(struct snapshot *s) {
+    int rc;
+    int64_t val;
+    const char *pos;
+    struct snap_node node;
+
+    if (!s->done) {
+        const char *saved_pos = s->pos;
+        int64_t saved_nnodes = s->nnodes;
+        while ((rc = snapshot_next_node(s, &node)) == 1);
+        pos = s->pos;
+        s->pos = saved_pos;
+        s->nnodes = saved_nnodes;
+        s->done = 0;
+        if (rc != 0) return ZK_ERROR;
+    } else {
+        pos = s->pos;
+    }
+    // the checksum covers everything up to the end marker
+    if (read_long(&pos, s->end, &val) != ZK_OK) return ZK_ERROR;
+    return (uint32_t)val == adler32(1, s->base, pos - 8 - s->base) ? ZK_OK : ZK_ERROR;
+}
+
+// snapshot_zxid returns the zxid encoded in hex in the file name, like
+// snapshot.100000002, or -1.
+int64_t snapshot_zxid(const char *filename) {
+    char *dot, *endp;
+    int64_t zxid;
+
+    if (!filename || !(dot = strrchr(filename, '.'))) return -1;
+    zxid = strtoll(dot + 1, &endp, 16);
+    return endp != dot + 1 && *endp == '\0' ? zxid : -1;
+}
@@ -0,0 +1,61 @@
+#ifndef __SNAPSHOT_H_
+#define __SNAPSHOT_H_
+
+#include <stddef.h>
+#include "zookeeper.jute.h"
+
+#define SNAP_MAGIC 0x5a4b534e // "ZKSN"
+
+// snap_node points straight into the mapped snapshot file, path and data
+// are not NUL-terminated and stay valid until snapshot_close. data_len is -1
+// for a null data buffer. stat_raw points to the serialized StatPersisted,
+// stat is only decoded when the snapshot isn't opened with raw_stats.
+struct snap_node {
+    const char *path;
+    int32_t path_len;
+    const char *data;
+    int32_t data_len;
+    int64_t acl;
+    const char *stat_raw;
+    struct StatPersisted stat;
+};
+
+struct snap_session {
+    int64_t id;
+    int32_t timeout;
+};
+
+// snap_acl is one entry of the ACL cache which nodes refer to by acl id,
+// acls points to count serialized ACL records.
+struct snap_acl {
+    int64_t id;
+    int32_t count;
+    const char *acls;
+};
+
+struct snapshot {
+    int fd;
+    char *base;
+    size_t size;
+    struct FileHeader header;
+    int32_t nsessions;
+    int32_t nacls;
+    const char *sessions;
+    const char *acl_cache;
+    const char *nodes;
+    const char *pos;
+    const char *end;
+    int64_t nnodes;
+    int done;
+    int raw_stats;
+};
+
+struct snapshot *snapshot_open(const char *filename);
+void snapshot_close(struct snapshot *s);
+int snapshot_next_session(struct snapshot *s, const char **pos, struct snap_session *session);
+int snapshot_next_acl(struct snapshot *s, const char **pos, struct snap_acl *acl);
+int snapshot_next_node(struct snapshot *s, struct snap_node *node);
+void snapshot_rewind(struct snapshot *s);
+int snapshot_verify(struct snapshot *s);
+int64_t snapshot_zxid(const char *filename);
+#endif
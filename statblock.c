@@ -0,0 +1,331 @@
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STAT_SIMD 1
+#endif
+
+#include "codec.h"
+#include "statblock.h"
+#include "zkclient.h"
+
+// Serialized stats are decoded four at a time: the big-endian fields are
+// byte-swapped with pshufb and transposed from one record per register to
+// one field per register, which is then stored straight into the columns.
+// The decoder is picked once at startup, AVX2 and SSSE3 on x86 and plain
+// scalar loads everywhere else.
+
+typedef void (*decode4_fn)(struct stat_block *b, uint32_t j, const char **r);
+
+static decode4_fn decode4_persisted;
+static decode4_fn decode4_stat;
+static const char *decoder_name = "scalar";
+
+int stat_block_init(struct stat_block *b, int full) {
+    memset(b, 0, sizeof(*b));
+    b->full = full;
+    return ZK_OK;
+}
+
+static int grow_column(void *column, size_t size, uint32_t cap) {
+    void *p;
+
+    if (!(p = realloc(*(void **)column, size * cap))) return ZK_ERROR;
+    *(void **)column = p;
+    return ZK_OK;
+}
+
+int stat_block_reserve(struct stat_block *b, uint32_t cap) {
+    int rc = ZK_OK;
+
+    if (cap <= b->cap) return ZK_OK;
+    rc |= grow_column(&b->czxid, sizeof(int64_t), cap);
+    rc |= grow_column(&b->mzxid, sizeof(int64_t), cap);
+    rc |= grow_column(&b->ctime, sizeof(int64_t), cap);
+    rc |= grow_column(&b->mtime, sizeof(int64_t), cap);
+    rc |= grow_column(&b->ephemeral_owner, sizeof(int64_t), cap);
+    rc |= grow_column(&b->pzxid, sizeof(int64_t), cap);
+    rc |= grow_column(&b->version, sizeof(int32_t), cap);
+    rc |= grow_column(&b->cversion, sizeof(int32_t), cap);
+    rc |= grow_column(&b->aversion, sizeof(int32_t), cap);
+    if (b->full) {
+        rc |= grow_column(&b->data_length, sizeof(int32_t), cap);
+        rc |= grow_column(&b->num_children, sizeof(int32_t), cap);
+    }
+    if (rc != ZK_OK) return ZK_ERROR;
+    b->cap = cap;
+    return ZK_OK;
+}
+
+void stat_block_free(struct stat_block *b) {
+    free(b->czxid);
+    free(b->mzxid);
+    free(b->ctime);
+    free(b->mtime);
+    free(b->ephemeral_owner);
+    free(b->pzxid);
+    free(b->version);
+    free(b->cversion);
+    free(b->aversion);
+    free(b->data_length);
+    free(b->num_children);
+    stat_block_init(b, b->full);
+}
+
+void stat_block_get(struct stat_block *b, uint32_t i, struct StatPersisted *stat) {
+    stat->czxid = b->czxid[i];
+    stat->mzxid = b->mzxid[i];
+    stat->ctime = b->ctime[i];
+    stat->mtime = b->mtime[i];
+    stat->version = b->version[i];
+    stat->cversion = b->cversion[i];
+    stat->aversion = b->aversion[i];
+    stat->ephemeralOwner = b->ephemeral_owner[i];
+    stat->pzxid = b->pzxid[i];
+}
+
+void stat_block_set(struct stat_block *b, uint32_t i, struct StatPersisted *stat) {
+    b->czxid[i] = stat->czxid;
+    b->mzxid[i] = stat->mzxid;
+    b->ctime[i] = stat->ctime;
+    b->mtime[i] = stat->mtime;
+    b->version[i] = stat->version;
+    b->cversion[i] = stat->cversion;
+    b->aversion[i] = stat->aversion;
+    b->ephemeral_owner[i] = stat->ephemeralOwner;
+    b->pzxid[i] = stat->pzxid;
+}
+
+void stat_block_get_stat(struct stat_block *b, uint32_t i, struct Stat *stat) {
+    stat->czxid = b->czxid[i];
+    stat->mzxid = b->mzxid[i];
+    stat->ctime = b->ctime[i];
+    stat->mtime = b->mtime[i];
+    stat->version = b->version[i];
+    stat->cversion = b->cversion[i];
+    stat->aversion = b->aversion[i];
+    stat->ephemeralOwner = b->ephemeral_owner[i];
+    stat->dataLength = b->full ? b->data_length[i] : 0;
+    stat->numChildren = b->full ? b->num_children[i] : 0;
+    stat->pzxid = b->pzxid[i];
+}
+
+// stat_block_set_stat stores a Stat, dataLength and numChildren only go to
+// a full block.
+void stat_block_set_stat(struct stat_block *b, uint32_t i, struct Stat *stat) {
+    b->czxid[i] = stat->czxid;
+    b->mzxid[i] = stat->mzxid;
+    b->ctime[i] = stat->ctime;
+    b->mtime[i] = stat->mtime;
+    b->version[i] = stat->version;
+    b->cversion[i] = stat->cversion;
+    b->aversion[i] = stat->aversion;
+    b->ephemeral_owner[i] = stat->ephemeralOwner;
+    b->pzxid[i] = stat->pzxid;
+    if (b->full) {
+        b->data_length[i] = stat->dataLength;
+        b->num_children[i] = stat->numChildren;
+    }
+}
+
+// stat_block_copy copies the first n stats of src to dst, which has the
+// same layout.
+int stat_block_copy(struct stat_block *dst, struct stat_block *src, uint32_t n) {
+    if (stat_block_reserve(dst, n) != ZK_OK) return ZK_ERROR;
+    memcpy(dst->czxid, src->czxid, sizeof(int64_t) * n);
+    memcpy(dst->mzxid, src->mzxid, sizeof(int64_t) * n);
+    memcpy(dst->ctime, src->ctime, sizeof(int64_t) * n);
+    memcpy(dst->mtime, src->mtime, sizeof(int64_t) * n);
+    memcpy(dst->ephemeral_owner, src->ephemeral_owner, sizeof(int64_t) * n);
+    memcpy(dst->pzxid, src->pzxid, sizeof(int64_t) * n);
+    memcpy(dst->version, src->version, sizeof(int32_t) * n);
+    memcpy(dst->cversion, src->cversion, sizeof(int32_t) * n);
+    memcpy(dst->aversion, src->aversion, sizeof(int32_t) * n);
+    if (dst->full) {
+        memcpy(dst->data_length, src->data_length, sizeof(int32_t) * n);
+        memcpy(dst->num_children, src->num_children, sizeof(int32_t) * n);
+    }
+    dst->count = n;
+    return ZK_OK;
+}
+
+// both layouts share the first 52 bytes, a Stat then carries dataLength and
+// numChildren before pzxid.
+static inline void decode_one(struct stat_block *b, uint32_t j, const char *p, int full) {
+    b->czxid[j] = load_be64(p);
+    b->mzxid[j] = load_be64(p + 8);
+    b->ctime[j] = load_be64(p + 16);
+    b->mtime[j] = load_be64(p + 24);
+    b->version[j] = load_be32(p + 32);
+    b->cversion[j] = load_be32(p + 36);
+    b->aversion[j] = load_be32(p + 40);
+    b->ephemeral_owner[j] = load_be64(p + 44);
+    if (full) {
+        b->data_length[j] = load_be32(p + 52);
+        b->num_children[j] = load_be32(p + 56);
+        b->pzxid[j] = load_be64(p + 60);
+    } else {
+        b->pzxid[j] = load_be64(p + 52);
+    }
+}
+
+static void decode4_persisted_scalar(struct stat_block *b, uint32_t j, const char **r) {
+    int k;
+
+    for (k = 0; k < 4; k++) decode_one(b, j + k, r[k], 0);
+}
+
+static void decode4_stat_scalar(struct stat_block *b, uint32_t j, const char **r) {
+    int k;
+
+    for (k = 0; k < 4; k++) decode_one(b, j + k, r[k], 1);
+}
+
+#ifdef STAT_SIMD
+// long_pair decodes two adjacent longs at off of four records into a and b
+__attribute__((target("ssse3")))
+static inline void long_pair(const char **r, int off, int64_t *a, int64_t *b) {
+    const __m128i swap64 = _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+    __m128i x0, x1, x2, x3;
+
+    x0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(r[0] + off)), swap64);
+    x1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(r[1] + off)), swap64);
+    x2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(r[2] + off)), swap64);
+    x3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(r[3] + off)), swap64);
+    _mm_storeu_si128((__m128i *)a, _mm_unpacklo_epi64(x0, x1));
+    _mm_storeu_si128((__m128i *)(a + 2), _mm_unpacklo_epi64(x2, x3));
+    _mm_storeu_si128((__m128i *)b, _mm_unpackhi_epi64(x0, x1));
+    _mm_storeu_si128((__m128i *)(b + 2), _mm_unpackhi_epi64(x2, x3));
+}
+
+// int_quad decodes the ints at off of four records and stores the first
+// three (or two when c is NULL) columns.
+__attribute__((target("ssse3")))
+static inline void int_quad(const char **r, int off, int32_t *a, int32_t *b, int32_t *c) {
+    const __m128i swap32 = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m128i x0, x1, x2, x3, t0, t1, t2, t3;
+
+    x0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(r[0] + off)), swap32);
+    x1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(r[1] + off)), swap32);
+    x2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(r[2] + off)), swap32);
+    x3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(r[3] + off)), swap32);
+    t0 = _mm_unpacklo_epi32(x0, x1);
+    t1 = _mm_unpacklo_epi32(x2, x3);
+    _mm_storeu_si128((__m128i *)a, _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128((__m128i *)b, _mm_unpackhi_epi64(t0, t1));
+    if (c) {
+        t2 = _mm_unpackhi_epi32(x0, x1);
+        t3 = _mm_unpackhi_epi32(x2, x3);
+        _mm_storeu_si128((__m128i *)c, _mm_unpacklo_epi64(t2, t3));
+    }
+}
+
+// decode4_tail handles everything behind the first four longs
+__attribute__((target("ssse3")))
+static inline void decode4_tail(struct stat_block *b, uint32_t j, const char **r, int full) {
+    int k;
+
+    int_quad(r, 32, b->version + j, b->cversion + j, b->aversion + j);
+    if (!full) {
+        long_pair(r, 44, b->ephemeral_owner + j, b->pzxid + j);
+        return;
+    }
+    int_quad(r, 52, b->data_length + j, b->num_children + j, NULL);
+    for (k = 0; k < 4; k++) {
+        b->ephemeral_owner[j + k] = load_be64(r[k] + 44);
+        b->pzxid[j + k] = load_be64(r[k] + 60);
+    }
+}
+
+__attribute__((target("ssse3")))
+static void decode4_persisted_ssse3(struct stat_block *b, uint32_t j, const char **r) {
+    long_pair(r, 0, b->czxid + j, b->mzxid + j);
+    long_pair(r, 16, b->ctime + j, b->mtime + j);
+    decode4_tail(b, j, r, 0);
+}
+
+__attribute__((target("ssse3")))
+static void decode4_stat_ssse3(struct stat_block *b, uint32_t j, const char **r) {
+    long_pair(r, 0, b->czxid + j, b->mzxid + j);
+    long_pair(r, 16, b->ctime + j, b->mtime + j);
+    decode4_tail(b, j, r, 1);
+}
+
+// long_quad decodes the four leading longs of four records with a 4x4
+// transpose of 64-bit lanes.
+__attribute__((target("avx2")))
+static inline void long_quad(struct stat_block *b, uint32_t j, const char **r) {
+    const __m256i swap64 = _mm256_set_epi8(
+            8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+            8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i x0, x1, x2, x3, lo01, hi01, lo23, hi23;
+
+    x0 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)r[0]), swap64);
+    x1 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)r[1]), swap64);
+    x2 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)r[2]), swap64);
+    x3 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)r[3]), swap64);
+    lo01 = _mm256_unpacklo_epi64(x0, x1);
+    hi01 = _mm256_unpackhi_epi64(x0, x1);
+    lo23 = _mm256_unpacklo_epi64(x2, x3);
+    hi23 = _mm256_unpackhi_epi64(x2, x3);
+    _mm256_storeu_si256((__m256i *)(b->czxid + j), _mm256_permute2x128_si256(lo01, lo23, 0x20));
+    _mm256_storeu_si256((__m256i *)(b->ctime + j), _mm256_permute2x128_si256(lo01, lo23, 0x31));
+    _mm256_storeu_si256((__m256i *)(b->mzxid + j), _mm256_permute2x128_si256(hi01, hi23, 0x20));
+    _mm256_storeu_si256((__m256i *)(b->mtime + j), _mm256_permute2x128_si256(hi01, hi23, 0x31));
+}
+
+__attribute__((target("avx2")))
+static void decode4_persisted_avx2(struct stat_block *b, uint32_t j, const char **r) {
+    long_quad(b, j, r);
+    decode4_tail(b, j, r, 0);
+}
+
+__attribute__((target("avx2")))
+static void decode4_stat_avx2(struct stat_block *b, uint32_t j, const char **r) {
+    long_quad(b, j, r);
+    decode4_tail(b, j, r, 1);
+}
+#endif
+
+__attribute__((constructor)) static void pick_stat_decoder(void) {
+    decode4_persisted = decode4_persisted_scalar;
+    decode4_stat = decode4_stat_scalar;
+#ifdef STAT_SIMD
+    __builtin_cpu_init();
+    if (getenv("ZK_STAT_SCALAR")) return;
+    if (__builtin_cpu_supports("avx2")) {
+        decode4_persisted = decode4_persisted_avx2;
+        decode4_stat = decode4_stat_avx2;
+        decoder_name = "avx2";
+    } else if (__builtin_cpu_supports("ssse3")) {
+        decode4_persisted = decode4_persisted_ssse3;
+        decode4_stat = decode4_stat_ssse3;
+        decoder_name = "ssse3";
+    }
+#endif
+}
+
+const char *stat_decoder_name(void) {
+    return decoder_name;
+}
+
+// decode_stats_persisted decodes n serialized StatPersisted records, recs[i]
+// points to the 60 bytes of the i-th one, into slots start to start+n-1.
+// The caller reserves the slots.
+void decode_stats_persisted(struct stat_block *b, uint32_t start, const char **recs, int n) {
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4) decode4_persisted(b, start + i, recs + i);
+    for (; i < n; i++) decode_one(b, start + i, recs[i], 0);
+    if (start + n > b->count) b->count = start + n;
+}
+
+// decode_stats is decode_stats_persisted for 68 byte Stat records, the
+// block has to be created with full set.
+void decode_stats(struct stat_block *b, uint32_t start, const char **recs, int n) {
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4) decode4_stat(b, start + i, recs + i);
+    for (; i < n; i++) decode_one(b, start + i, recs[i], 1);
+    if (start + n > b->count) b->count = start + n;
+}
@@ -0,0 +1,42 @@
+#ifndef __STATBLOCK_H_
+#define __STATBLOCK_H_
+
+#include <stdint.h>
+#include "zookeeper.jute.h"
+
+#define STAT_PERSISTED_SIZE 60
+#define STAT_SIZE 68
+
+// stat_block holds stats column-wise, one array per field, so a million
+// nodes don't pay for the padding of struct StatPersisted and scans over a
+// single field stay sequential. data_length and num_children are only kept
+// for blocks of Stat records.
+struct stat_block {
+    uint32_t count;
+    uint32_t cap;
+    int full;
+    int64_t *czxid;
+    int64_t *mzxid;
+    int64_t *ctime;
+    int64_t *mtime;
+    int64_t *ephemeral_owner;
+    int64_t *pzxid;
+    int32_t *version;
+    int32_t *cversion;
+    int32_t *aversion;
+    int32_t *data_length;
+    int32_t *num_children;
+};
+
+int stat_block_init(struct stat_block *b, int full);
+int stat_block_reserve(struct stat_block *b, uint32_t cap);
+void stat_block_free(struct stat_block *b);
+void stat_block_get(struct stat_block *b, uint32_t i, struct StatPersisted *stat);
+void stat_block_set(struct stat_block *b, uint32_t i, struct StatPersisted *stat);
+void stat_block_get_stat(struct stat_block *b, uint32_t i, struct Stat *stat);
+void stat_block_set_stat(struct stat_block *b, uint32_t i, struct Stat *stat);
+int stat_block_copy(struct stat_block *dst, struct stat_block *src, uint32_t n);
+void decode_stats_persisted(struct stat_block *b, uint32_t start, const char **recs, int n);
+void decode_stats(struct stat_block *b, uint32_t start, const char **recs, int n);
+const char *stat_decoder_name(void);
+#endif
@@ -0,0 +1,230 @@
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "timer.h"
+#include "util.h"
+#include "zkclient.h"
+
+// The wheel has WHEEL_LEVELS levels of WHEEL_SIZE slots, a slot of level l
+// spans WHEEL_SIZE^l ticks. A timer is put on the lowest level that reaches
+// its expiry, and the timers of a higher level slot move down a level once
+// the lower level wraps around into that slot, so adding and removing a
+// timer is O(1) however many sessions there are.
+#define WHEEL_TICK 10 // ms
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_FOREVER INT64_MAX
+// timers never fire early, so the expiry rounds up to the next tick
+#define EXPIRE_TICK(ms) (((ms) + WHEEL_TICK - 1) / WHEEL_TICK)
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_cond_t done;
+    pthread_once_t once;
+    int started;
+    int64_t tick; // the last tick handled
+    int64_t wake; // the tick the thread sleeps until
+    struct zk_timer *running;
+    struct zk_timer *expired;
+    struct zk_timer *slots[WHEEL_LEVELS][WHEEL_SIZE];
+} wheel = {
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    PTHREAD_ONCE_INIT,
+};
+
+static void push_timer(struct zk_timer **slot, struct zk_timer *t) {
+    t->next = *slot;
+    if (t->next) t->next->pprev = &t->next;
+    t->pprev = slot;
+    *slot = t;
+}
+
+static void link_timer(struct zk_timer *t) {
+    int level;
+    int64_t expire, delta;
+    struct zk_timer **slot;
+
+    expire = EXPIRE_TICK(t->expire);
+    if (expire <= wheel.tick) expire = wheel.tick + 1;
+    delta = expire - wheel.tick;
+    for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+        if (delta < (int64_t)1 << (WHEEL_BITS * (level + 1))) break;
+    }
+    if (delta >= (int64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)) {
+        // too far out, it is put back in place when its slot comes up
+        expire = wheel.tick + ((int64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+    }
+    slot = &wheel.slots[level][(expire >> (WHEEL_BITS * level)) & WHEEL_MASK];
+    push_timer(slot, t);
+}
+
+static void unlink_timer(struct zk_timer *t) {
+    *t->pprev = t->next;
+    if (t->next) t->next->pprev = t->pprev;
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+// cascade moves the timers of a slot one or more levels down
+static void cascade(int level, int index) {
+    struct zk_timer *t, *next;
+
+    t = wheel.slots[level][index];
+    wheel.slots[level][index] = NULL;
+    for (; t; t = next) {
+        next = t->next;
+        t->pprev = NULL;
+        link_timer(t);
+    }
+}
+
+// next_tick returns the first tick the wheel has work at: a timer that
+// expires, or a slot that has to move down a level.
+static int64_t next_tick(void) {
+    int level, i, index;
+    int64_t tick, next = WHEEL_FOREVER;
+
+    for (i = 1; i <= WHEEL_SIZE; i++) {
+        if (!wheel.slots[0][(wheel.tick + i) & WHEEL_MASK]) continue;
+        next = wheel.tick + i;
+        break;
+    }
+    // a slot that moves down first may hold an earlier timer
+    for (level = 1; level < WHEEL_LEVELS; level++) {
+        index = (wheel.tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+        for (i = 1; i <= WHEEL_SIZE; i++) {
+            if (!wheel.slots[level][(index + i) & WHEEL_MASK]) continue;
+            tick = ((wheel.tick >> (WHEEL_BITS * level)) + i) << (WHEEL_BITS * level);
+            if (tick < next) next = tick;
+            break;
+        }
+    }
+    return next;
+}
+
+// advance handles the ticks up to now and moves the timers that expired
+// to wheel.expired. Ticks without work are skipped.
+static void advance(int64_t now) {
+    int level, index;
+    int64_t next;
+    struct zk_timer *t, *rest;
+
+    while (wheel.tick < now) {
+        if ((next = next_tick()) > now) {
+            wheel.tick = now;
+            break;
+        }
+        wheel.tick = next;
+        for (level = 1; level < WHEEL_LEVELS; level++) {
+            if (wheel.tick & (((int64_t)1 << (WHEEL_BITS * level)) - 1)) break;
+            index = (wheel.tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+            cascade(level, index);
+        }
+        index = wheel.tick & WHEEL_MASK;
+        rest = wheel.slots[0][index];
+        wheel.slots[0][index] = NULL;
+        for (; (t = rest); ) {
+            rest = t->next;
+            if (EXPIRE_TICK(t->expire) > wheel.tick) {
+                // parked on the last level, not due yet
+                link_timer(t);
+            } else {
+                push_timer(&wheel.expired, t);
+            }
+        }
+    }
+}
+
+static void *timer_loop(void *arg) {
+    int64_t now, wake;
+    struct timespec ts;
+    struct zk_timer *t;
+
+    pthread_mutex_lock(&wheel.lock);
+    for (;;) {
+        now = mstime() / WHEEL_TICK;
+        advance(now);
+        // expired timers stay linked until they run, so timer_del can
+        // still cancel them
+        while ((t = wheel.expired)) {
+            unlink_timer(t);
+            wheel.running = t;
+            pthread_mutex_unlock(&wheel.lock);
+            t->fn(t, t->arg);
+            pthread_mutex_lock(&wheel.lock);
+            wheel.running = NULL;
+            pthread_cond_broadcast(&wheel.done);
+        }
+        now = mstime() / WHEEL_TICK;
+        wake = next_tick();
+        if (wake <= now) continue;
+        wheel.wake = wake;
+        if (wake == WHEEL_FOREVER) {
+            pthread_cond_wait(&wheel.cond, &wheel.lock);
+        } else {
+            abstime_after(&ts, wake * WHEEL_TICK - mstime());
+            pthread_cond_timedwait(&wheel.cond, &wheel.lock, &ts);
+        }
+    }
+    return NULL;
+}
+
+static void start_timer_thread(void) {
+    pthread_t tid;
+
+    wheel.tick = mstime() / WHEEL_TICK;
+    wheel.wake = WHEEL_FOREVER;
+    if (pthread_create(&tid, NULL, timer_loop, NULL) != 0) {
+        logger(ERROR, "start timer thread err, %s", strerror(errno));
+        return;
+    }
+    pthread_detach(tid);
+    wheel.started = 1;
+}
+
+void timer_init(struct zk_timer *t, timer_fn fn, void *arg) {
+    t->next = NULL;
+    t->pprev = NULL;
+    t->expire = 0;
+    t->fn = fn;
+    t->arg = arg;
+}
+
+// timer_add_at (re)schedules t to fire at expire, ms on the mstime clock
+int timer_add_at(struct zk_timer *t, int64_t expire) {
+    pthread_once(&wheel.once, start_timer_thread);
+    if (!wheel.started) return ZK_ERROR;
+    pthread_mutex_lock(&wheel.lock);
+    if (t->pprev) unlink_timer(t);
+    t->expire = expire;
+    link_timer(t);
+    if (EXPIRE_TICK(expire) < wheel.wake) {
+        wheel.wake = EXPIRE_TICK(expire);
+        pthread_cond_signal(&wheel.cond);
+    }
+    pthread_mutex_unlock(&wheel.lock);
+    return ZK_OK;
+}
+
+// timer_add (re)schedules t to fire delay ms from now
+int timer_add(struct zk_timer *t, int64_t delay) {
+    return timer_add_at(t, mstime() + delay);
+}
+
+// timer_del cancels t, and waits for its callback when it is running, so
+// the owner of t can free it right after. It must not be called from the
+// callback of t itself.
+void timer_del(struct zk_timer *t) {
+    if (!wheel.started) return;
+    pthread_mutex_lock(&wheel.lock);
+    if (t->pprev) unlink_timer(t);
+    while (wheel.running == t) pthread_cond_wait(&wheel.done, &wheel.lock);
+    if (t->pprev) unlink_timer(t); // the callback added it again
+    pthread_mutex_unlock(&wheel.lock);
+}
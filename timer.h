@@ -0,0 +1,24 @@
+#ifndef __TIMER_H_
+#define __TIMER_H_
+
+#include <stdint.h>
+
+// zk_timer is a one-shot timer on the shared timer wheel. A single thread
+// fires the timers of every client, so the callback must not block; it may
+// add the timer again. The thread only wakes up when a timer is due.
+struct zk_timer;
+typedef void (*timer_fn)(struct zk_timer *t, void *arg);
+
+struct zk_timer {
+    struct zk_timer *next;
+    struct zk_timer **pprev; // NULL while the timer isn't pending
+    int64_t expire; // ms on the mstime clock
+    timer_fn fn;
+    void *arg;
+};
+
+void timer_init(struct zk_timer *t, timer_fn fn, void *arg);
+int timer_add(struct zk_timer *t, int64_t delay);
+int timer_add_at(struct zk_timer *t, int64_t expire);
+void timer_del(struct zk_timer *t);
+#endif
@@ -0,0 +1,832 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "util.h"
+#include "request.h"
+#include "treecache.h"
+
+#define TC_TOMB 0xfffffffeu
+#define POOL_SHIFT 21
+#define POOL_MASK ((1u << POOL_SHIFT) - 1)
+// keeps pool offsets below 4GB
+#define POOL_CHUNKS 2047
+// paths read per burst, each path costs a data and a children read
+#define TC_BURST 128
+// ms before a failed refresh is tried again
+#define TC_RETRY 1000
+// more queued changes than this are dropped for a resync
+#define TC_MAX_CHANGES 65536
+
+// tc_pool holds the strings of a tree, nodes only keep offsets into it.
+// Chunks never move, so snapshots share the pool while the updater appends
+// to it. Strings of removed nodes are garbage until the live ones are
+// copied to a new pool.
+struct tc_pool {
+    int refs;
+    uint32_t used;
+    uint32_t garbage;
+    char *chunks[POOL_CHUNKS];
+};
+
+struct tc_change {
+    int type;
+    char *path;
+};
+
+struct tc_changes {
+    struct tc_change *items;
+    int count;
+    int cap;
+};
+
+struct path_list {
+    char **items;
+    int count;
+    int cap;
+};
+
+// tree_cache keeps a snapshot of a subtree current. The updater thread owns
+// the work tree, it applies watch notifications to it and publishes a copy
+// per batch of changes.
+struct tree_cache {
+    zk_client *c;
+    char *root;
+    int32_t root_len;
+    tc_event_fn fn;
+    void *arg;
+    struct tc_snapshot *current;
+    int entering; // readers between loading current and taking a reference
+    struct tc_snapshot work;
+    struct tc_changes events; // events of the batch being applied
+    uint64_t requests;
+    pthread_t tid;
+    pthread_mutex_t lock; // guards the fields below
+    pthread_cond_t cond;
+    int state; // 0 while loading, 1 once loaded, -1 when the load failed
+    int stop;
+    int resync;
+    struct tc_changes changes;
+    struct tc_stats stats;
+};
+
+static struct tc_pool *pool_new(void) {
+    struct tc_pool *p;
+
+    if (!(p = calloc(1, sizeof(*p)))) return NULL;
+    p->refs = 1;
+    return p;
+}
+
+static void pool_release(struct tc_pool *p) {
+    int i;
+
+    if (!p || __atomic_sub_fetch(&p->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+    for (i = 0; i < POOL_CHUNKS && p->chunks[i]; i++) free(p->chunks[i]);
+    free(p);
+}
+
+static inline const char *pool_at(struct tc_pool *p, uint32_t off) {
+    return p->chunks[off >> POOL_SHIFT] + (off & POOL_MASK);
+}
+
+// pool_add appends len bytes and a NUL, it returns the offset or TC_NONE.
+static uint32_t pool_add(struct tc_pool *p, const char *s, int32_t len) {
+    uint32_t off = p->used, chunk;
+
+    if (len < 0 || (uint32_t)len >= POOL_MASK) return TC_NONE;
+    if ((off & POOL_MASK) + len + 1 > POOL_MASK + 1) off = (off | POOL_MASK) + 1;
+    chunk = off >> POOL_SHIFT;
+    if (chunk >= POOL_CHUNKS) return TC_NONE;
+    if (!p->chunks[chunk] && !(p->chunks[chunk] = malloc(POOL_MASK + 1))) return TC_NONE;
+    memcpy(p->chunks[chunk] + (off & POOL_MASK), s, len);
+    p->chunks[chunk][(off & POOL_MASK) + len] = '\0';
+    p->used = off + len + 1;
+    return off;
+}
+
+static int changes_push(struct tc_changes *q, int type, const char *path) {
+    int cap;
+    char *copy = NULL;
+    struct tc_change *items;
+
+    if (q->count == q->cap) {
+        cap = q->cap ? q->cap * 2 : 64;
+        if (!(items = realloc(q->items, sizeof(*items) * cap))) return ZK_ERROR;
+        q->items = items;
+        q->cap = cap;
+    }
+    if (path && !(copy = strdup(path))) return ZK_ERROR;
+    q->items[q->count].type = type;
+    q->items[q->count].path = copy;
+    q->count++;
+    return ZK_OK;
+}
+
+static void changes_free(struct tc_changes *q) {
+    int i;
+
+    for (i = 0; i < q->count; i++) free(q->items[i].path);
+    free(q->items);
+    memset(q, 0, sizeof(*q));
+}
+
+// list_push takes over path, it's freed when the push fails
+static int list_push(struct path_list *l, char *path) {
+    int cap;
+    char **items;
+
+    if (!path) return ZK_ERROR;
+    if (l->count == l->cap) {
+        cap = l->cap ? l->cap * 2 : 64;
+        if (!(items = realloc(l->items, sizeof(*items) * cap))) {
+            free(path);
+            return ZK_ERROR;
+        }
+        l->items = items;
+        l->cap = cap;
+    }
+    l->items[l->count++] = path;
+    return ZK_OK;
+}
+
+static void list_free(struct path_list *l) {
+    int i;
+
+    for (i = 0; i < l->count; i++) free(l->items[i]);
+    free(l->items);
+    memset(l, 0, sizeof(*l));
+}
+
+static uint32_t hash_path(const char *path, int32_t len) {
+    int32_t i;
+    uint32_t h = 2166136261u;
+
+    for (i = 0; i < len; i++) {
+        h ^= (uint8_t)path[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// find_slot returns the slot which holds path, or the empty slot where it
+// would be inserted.
+static uint32_t find_slot(struct tc_snapshot *s, const char *path, int32_t len, int *found) {
+    uint32_t i, idx, mask = s->nslots - 1, tomb = TC_NONE;
+    struct tc_node *n;
+
+    *found = 0;
+    for (i = hash_path(path, len) & mask; ; i = (i + 1) & mask) {
+        idx = s->slots[i];
+        if (idx == TC_NONE) return tomb != TC_NONE ? tomb : i;
+        if (idx == TC_TOMB) {
+            if (tomb == TC_NONE) tomb = i;
+            continue;
+        }
+        n = &s->nodes[idx];
+        if (n->path_len == len && !memcmp(pool_at(s->paths, n->path), path, len)) {
+            *found = 1;
+            return i;
+        }
+    }
+}
+
+static int grow_slots(struct tc_snapshot *s) {
+    int found;
+    uint32_t i, nslots, *old = s->slots, old_nslots = s->nslots;
+    struct tc_node *n;
+
+    for (nslots = 1024; nslots < s->live * 4; nslots *= 2);
+    if (!(s->slots = malloc(sizeof(uint32_t) * nslots))) {
+        s->slots = old;
+        return ZK_ERROR;
+    }
+    memset(s->slots, 0xff, sizeof(uint32_t) * nslots);
+    s->nslots = nslots;
+    s->used_slots = 0;
+    for (i = 0; i < old_nslots; i++) {
+        if (old[i] == TC_NONE || old[i] == TC_TOMB) continue;
+        n = &s->nodes[old[i]];
+        s->slots[find_slot(s, pool_at(s->paths, n->path), n->path_len, &found)] = old[i];
+        s->used_slots++;
+    }
+    free(old);
+    return ZK_OK;
+}
+
+static uint32_t lookup_index(struct tc_snapshot *s, const char *path, int32_t len) {
+    int found;
+    uint32_t slot;
+
+    slot = find_slot(s, path, len, &found);
+    return found ? s->slots[slot] : TC_NONE;
+}
+
+static uint32_t parent_index(struct tc_snapshot *s, const char *path, int32_t len) {
+    int32_t i;
+
+    for (i = len - 1; i > 0 && path[i] != '/'; i--);
+    return lookup_index(s, path, i > 0 ? i : 1);
+}
+
+static void add_event(struct tree_cache *tc, int type, const char *path) {
+    if (changes_push(&tc->events, type, path) != ZK_OK) {
+        logger(WARN, "Tree cache of %s dropped an event of %s.", tc->root, path);
+    }
+}
+
+// add_node inserts a node under parent, the caller made sure path is not in
+// the tree yet. Returns the index of the node or TC_NONE.
+static uint32_t add_node(struct tc_snapshot *s, const char *path, int32_t len, uint32_t parent) {
+    int found;
+    uint32_t idx, cap, slot, off;
+    struct tc_node *n, *nodes, *p;
+    struct Stat zero = {0};
+
+    if ((s->used_slots + 1) * 2 > s->nslots && grow_slots(s) != ZK_OK) return TC_NONE;
+    if (s->free_list == TC_NONE && s->count == s->cap) {
+        cap = s->cap ? s->cap * 2 : 1024;
+        if (!(nodes = realloc(s->nodes, sizeof(*nodes) * cap))) return TC_NONE;
+        s->nodes = nodes;
+        if (stat_block_reserve(&s->stats, cap) != ZK_OK) return TC_NONE;
+        s->cap = cap;
+    }
+    if ((off = pool_add(s->paths, path, len)) == TC_NONE) return TC_NONE;
+    if (s->free_list != TC_NONE) {
+        idx = s->free_list;
+        s->free_list = s->nodes[idx].next_sibling;
+    } else {
+        idx = s->count++;
+    }
+    n = &s->nodes[idx];
+    n->path = off;
+    n->path_len = len;
+    n->data = TC_NONE;
+    n->data_len = 0;
+    n->parent = parent;
+    n->first_child = TC_NONE;
+    n->prev_sibling = TC_NONE;
+    n->next_sibling = TC_NONE;
+    if (parent != TC_NONE) {
+        p = &s->nodes[parent];
+        n->next_sibling = p->first_child;
+        if (p->first_child != TC_NONE) s->nodes[p->first_child].prev_sibling = idx;
+        p->first_child = idx;
+    }
+    stat_block_set_stat(&s->stats, idx, &zero);
+    slot = find_slot(s, path, len, &found);
+    if (s->slots[slot] == TC_NONE) s->used_slots++;
+    s->slots[slot] = idx;
+    s->live++;
+    return idx;
+}
+
+// remove_node drops a node and its subtree, children are reported first
+static void remove_node(struct tree_cache *tc, uint32_t idx) {
+    int found;
+    uint32_t slot;
+    struct tc_snapshot *s = &tc->work;
+    struct tc_node *n = &s->nodes[idx];
+    const char *path = pool_at(s->paths, n->path);
+
+    while (n->first_child != TC_NONE) remove_node(tc, n->first_child);
+    add_event(tc, TC_NODE_REMOVED, path);
+    if (n->prev_sibling != TC_NONE) {
+        s->nodes[n->prev_sibling].next_sibling = n->next_sibling;
+    } else if (n->parent != TC_NONE) {
+        s->nodes[n->parent].first_child = n->next_sibling;
+    }
+    if (n->next_sibling != TC_NONE) s->nodes[n->next_sibling].prev_sibling = n->prev_sibling;
+    slot = find_slot(s, path, n->path_len, &found);
+    if (found) s->slots[slot] = TC_TOMB;
+    s->paths->garbage += n->path_len + 1;
+    if (n->data != TC_NONE) s->datas->garbage += n->data_len + 1;
+    if (idx == s->root) s->root = TC_NONE;
+    n->path = TC_NONE;
+    n->data = TC_NONE;
+    n->parent = TC_NONE;
+    n->prev_sibling = TC_NONE;
+    n->next_sibling = s->free_list;
+    s->free_list = idx;
+    s->live--;
+}
+
+static int set_data(struct tc_snapshot *s, uint32_t idx, struct zk_read *r) {
+    uint32_t off = TC_NONE;
+    struct tc_node *n = &s->nodes[idx];
+
+    if (r->data.len > 0 && (off = pool_add(s->datas, r->data.buff, r->data.len)) == TC_NONE) {
+        return ZK_ERROR;
+    }
+    if (n->data != TC_NONE) s->datas->garbage += n->data_len + 1;
+    n->data = off;
+    n->data_len = off != TC_NONE ? r->data.len : 0;
+    stat_block_set_stat(&s->stats, idx, &r->stat);
+    return ZK_OK;
+}
+
+static char *child_path(const char *parent, const char *name) {
+    char *path;
+    size_t len = strlen(parent), name_len = strlen(name);
+
+    if (len == 1) len = 0; // the root
+    if (!(path = malloc(len + name_len + 2))) return NULL;
+    memcpy(path, parent, len);
+    path[len] = '/';
+    memcpy(path + len + 1, name, name_len + 1);
+    return path;
+}
+
+static int cmp_name(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+// apply_read reconciles the node at path with its data and children reads.
+// Listed children go to next when they aren't in the tree, or always when
+// full is set.
+static int apply_read(struct tree_cache *tc, const char *path, struct zk_read *data,
+        struct zk_read *children, int full, struct path_list *next) {
+    int32_t len = strlen(path);
+    uint32_t idx, parent, i, sibling;
+    char *name, *child;
+    struct tc_snapshot *s = &tc->work;
+    struct String_vector *v = &children->children;
+
+    idx = lookup_index(s, path, len);
+    if (data->err == ZNONODE || children->err == ZNONODE) {
+        if (idx != TC_NONE) remove_node(tc, idx);
+        return ZK_OK;
+    }
+    if (data->err != ZOK || children->err != ZOK) return ZK_ERROR;
+    if (idx == TC_NONE) {
+        parent = TC_NONE;
+        // a node whose parent went away meanwhile is skipped
+        if (len != tc->root_len && (parent = parent_index(s, path, len)) == TC_NONE) return ZK_OK;
+        if ((idx = add_node(s, path, len, parent)) == TC_NONE) return ZK_ERROR;
+        if (parent == TC_NONE) s->root = idx;
+        add_event(tc, TC_NODE_ADDED, path);
+    } else if (s->stats.mzxid[idx] != data->stat.mzxid) {
+        add_event(tc, TC_NODE_UPDATED, path);
+    }
+    if (set_data(s, idx, data) != ZK_OK) return ZK_ERROR;
+
+    qsort(v->data, v->count, sizeof(char *), cmp_name);
+    for (i = s->nodes[idx].first_child; i != TC_NONE; i = sibling) {
+        sibling = s->nodes[i].next_sibling;
+        name = strrchr(pool_at(s->paths, s->nodes[i].path), '/') + 1;
+        if (!bsearch(&name, v->data, v->count, sizeof(char *), cmp_name)) remove_node(tc, i);
+    }
+    for (i = 0; i < (uint32_t)v->count; i++) {
+        if (!(child = child_path(path, v->data[i]))) return ZK_ERROR;
+        if (!full && lookup_index(s, child, strlen(child)) != TC_NONE) {
+            free(child);
+            continue;
+        }
+        if (list_push(next, child) != ZK_OK) return ZK_ERROR;
+    }
+    return ZK_OK;
+}
+
+// load reads paths with data and child watches and reconciles the work tree
+// with the replies, a level of the subtree per round of pipelined bursts.
+static int load(struct tree_cache *tc, char **paths, int n, int full) {
+    int i, k, start, rc = ZK_ERROR;
+    struct zk_read *reads, *r;
+    struct path_list level = {0}, next = {0};
+
+    if (!(reads = malloc(sizeof(*reads) * TC_BURST * 2))) return ZK_ERROR;
+    for (i = 0; i < n; i++) {
+        if (list_push(&level, strdup(paths[i])) != ZK_OK) goto cleanup;
+    }
+    while (level.count > 0) {
+        for (start = 0; start < level.count; start += TC_BURST) {
+            k = level.count - start < TC_BURST ? level.count - start : TC_BURST;
+            memset(reads, 0, sizeof(*reads) * k * 2);
+            for (i = 0; i < k; i++) {
+                r = &reads[i * 2];
+                r[0].type = GETDATA_OPCODE;
+                r[1].type = GETCHILDREN2_OPCODE;
+                r[0].path = r[1].path = level.items[start + i];
+                r[0].watch = r[1].watch = 1;
+            }
+            tc->requests += k * 2;
+            rc = zk_read_batch(tc->c, reads, k * 2);
+            for (i = 0; i < k && rc == ZK_OK; i++) {
+                r = &reads[i * 2];
+                rc = apply_read(tc, r[0].path, &r[0], &r[1], full, &next);
+            }
+            for (i = 0; i < k * 2; i++) {
+                deallocate_Buffer(&reads[i].data);
+                deallocate_String_vector(&reads[i].children);
+            }
+            if (rc != ZK_OK) goto cleanup;
+        }
+        list_free(&level);
+        level = next;
+        memset(&next, 0, sizeof(next));
+    }
+    rc = ZK_OK;
+
+cleanup:
+    list_free(&level);
+    list_free(&next);
+    free(reads);
+    return rc;
+}
+
+// load_root loads the whole subtree, while the root is missing it leaves an
+// exists watch to hear of its creation.
+static int load_root(struct tree_cache *tc) {
+    struct zk_read r;
+
+    for (;;) {
+        if (load(tc, &tc->root, 1, 1) != ZK_OK) return ZK_ERROR;
+        if (tc->work.root != TC_NONE) return ZK_OK;
+        memset(&r, 0, sizeof(r));
+        r.type = EXISTS_OPCODE;
+        r.path = tc->root;
+        r.watch = 1;
+        tc->requests++;
+        if (zk_read_batch(tc->c, &r, 1) != ZK_OK) return ZK_ERROR;
+        if (r.err == ZNONODE) return ZK_OK;
+        if (r.err != ZOK) return ZK_ERROR;
+    }
+}
+
+static int cmp_change(const void *a, const void *b) {
+    return strcmp(((struct tc_change *)a)->path, ((struct tc_change *)b)->path);
+}
+
+// apply_changes applies a batch of watch notifications. Deletions go first,
+// a node created again is found in its parent's listing. The rest reload
+// their node, parents before children and each path once.
+static int apply_changes(struct tree_cache *tc, struct tc_changes *q) {
+    int i, n = 0, need_root = 0, rc = ZK_OK;
+    uint32_t idx;
+    char **paths;
+    struct tc_change *ch;
+
+    if (!(paths = malloc(sizeof(char *) * (q->count + 1)))) return ZK_ERROR;
+    qsort(q->items, q->count, sizeof(*q->items), cmp_change);
+    for (i = 0; i < q->count; i++) {
+        ch = &q->items[i];
+        if (ch->type == ZOO_CREATED_EVENT || (ch->type == ZOO_DELETED_EVENT && !strcmp(ch->path, tc->root))) {
+            need_root = 1;
+        }
+        if (ch->type != ZOO_DELETED_EVENT) continue;
+        idx = lookup_index(&tc->work, ch->path, strlen(ch->path));
+        if (idx != TC_NONE) remove_node(tc, idx);
+    }
+    for (i = 0; i < q->count; i++) {
+        ch = &q->items[i];
+        if (ch->type == ZOO_DELETED_EVENT || ch->type == ZOO_CREATED_EVENT) continue;
+        if (n > 0 && !strcmp(paths[n - 1], ch->path)) continue;
+        if (lookup_index(&tc->work, ch->path, strlen(ch->path)) == TC_NONE) continue;
+        paths[n++] = ch->path;
+    }
+    if (n > 0) rc = load(tc, paths, n, 0);
+    if (rc == ZK_OK && (need_root || tc->work.root == TC_NONE)) rc = load_root(tc);
+    free(paths);
+    return rc;
+}
+
+// compact copies the live strings of the work tree to new pools once half
+// of a pool is garbage, published snapshots keep the old pools.
+static int compact(struct tree_cache *tc) {
+    uint32_t i, *offs;
+    struct tc_pool *paths, *datas;
+    struct tc_snapshot *s = &tc->work;
+    struct tc_node *n;
+
+    if ((s->paths->used < POOL_MASK || s->paths->garbage * 2 < s->paths->used)
+            && (s->datas->used < POOL_MASK || s->datas->garbage * 2 < s->datas->used)) {
+        return ZK_OK;
+    }
+    paths = pool_new();
+    datas = pool_new();
+    offs = malloc(sizeof(uint32_t) * 2 * (s->count + 1));
+    if (!paths || !datas || !offs) goto ERROR;
+    for (i = 0; i < s->count; i++) {
+        n = &s->nodes[i];
+        if (n->path == TC_NONE) continue;
+        offs[i * 2] = pool_add(paths, pool_at(s->paths, n->path), n->path_len);
+        if (offs[i * 2] == TC_NONE) goto ERROR;
+        offs[i * 2 + 1] = TC_NONE;
+        if (n->data == TC_NONE) continue;
+        offs[i * 2 + 1] = pool_add(datas, pool_at(s->datas, n->data), n->data_len);
+        if (offs[i * 2 + 1] == TC_NONE) goto ERROR;
+    }
+    for (i = 0; i < s->count; i++) {
+        n = &s->nodes[i];
+        if (n->path == TC_NONE) continue;
+        n->path = offs[i * 2];
+        n->data = offs[i * 2 + 1];
+    }
+    pool_release(s->paths);
+    pool_release(s->datas);
+    s->paths = paths;
+    s->datas = datas;
+    free(offs);
+    return ZK_OK;
+
+ERROR:
+    pool_release(paths);
+    pool_release(datas);
+    free(offs);
+    return ZK_ERROR;
+}
+
+static void snapshot_destroy(struct tc_snapshot *s) {
+    free(s->nodes);
+    free(s->slots);
+    stat_block_free(&s->stats);
+    pool_release(s->paths);
+    pool_release(s->datas);
+}
+
+// publish swaps a copy of the work tree in as the current snapshot. Readers
+// which may have loaded the old pointer are waited for before it's dropped.
+static int publish(struct tree_cache *tc) {
+    struct tc_snapshot *w = &tc->work, *s, *old;
+
+    if (!(s = malloc(sizeof(*s)))) return ZK_ERROR;
+    *s = *w;
+    s->refs = 1;
+    s->cap = w->count;
+    s->nodes = malloc(sizeof(*s->nodes) * (w->count + 1));
+    s->slots = malloc(sizeof(uint32_t) * w->nslots);
+    stat_block_init(&s->stats, 1);
+    if (!s->nodes || !s->slots || stat_block_copy(&s->stats, &w->stats, w->count) != ZK_OK) {
+        free(s->nodes);
+        free(s->slots);
+        stat_block_free(&s->stats);
+        free(s);
+        return ZK_ERROR;
+    }
+    memcpy(s->nodes, w->nodes, sizeof(*s->nodes) * w->count);
+    memcpy(s->slots, w->slots, sizeof(uint32_t) * w->nslots);
+    __atomic_add_fetch(&s->paths->refs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&s->datas->refs, 1, __ATOMIC_RELAXED);
+    s->version = ++w->version;
+
+    old = __atomic_exchange_n(&tc->current, s, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&tc->entering, __ATOMIC_SEQ_CST)) sched_yield();
+    tc_snapshot_put(old);
+    return ZK_OK;
+}
+
+static void fire_events(struct tree_cache *tc) {
+    int i;
+    struct tc_event ev;
+
+    for (i = 0; tc->fn && i < tc->events.count; i++) {
+        ev.type = tc->events.items[i].type;
+        ev.path = tc->events.items[i].path;
+        ev.version = tc->work.version;
+        tc->fn(&ev, tc->arg);
+    }
+    changes_free(&tc->events);
+}
+
+static uint64_t tree_bytes(struct tc_snapshot *s) {
+    return s->paths->used + s->datas->used + (uint64_t)s->cap * (sizeof(struct tc_node) + STAT_SIZE)
+        + (uint64_t)s->nslots * sizeof(uint32_t);
+}
+
+static void *update_loop(void *arg) {
+    int rc, resync, loaded = 0;
+    int64_t start, cost;
+    uint64_t requests;
+    struct tree_cache *tc = arg;
+    struct tc_changes q;
+    struct tc_event ev;
+    struct timespec ts;
+
+    pthread_mutex_lock(&tc->lock);
+    while (!tc->stop) {
+        if (!tc->resync && tc->changes.count == 0) {
+            pthread_cond_wait(&tc->cond, &tc->lock);
+            continue;
+        }
+        q = tc->changes;
+        memset(&tc->changes, 0, sizeof(tc->changes));
+        resync = tc->resync;
+        tc->resync = 0;
+        pthread_mutex_unlock(&tc->lock);
+
+        start = ustime();
+        requests = tc->requests;
+        rc = resync ? load_root(tc) : apply_changes(tc, &q);
+        changes_free(&q);
+        if (rc == ZK_OK) rc = compact(tc);
+        // a failed refresh still publishes what it got, the resync fixes the rest
+        if ((tc->events.count > 0 || !loaded) && publish(tc) != ZK_OK) rc = ZK_ERROR;
+        cost = ustime() - start;
+
+        pthread_mutex_lock(&tc->lock);
+        if (!loaded) {
+            if (rc != ZK_OK) {
+                tc->state = -1;
+                pthread_cond_broadcast(&tc->cond);
+                break;
+            }
+            loaded = 1;
+            tc->state = 1;
+            pthread_cond_broadcast(&tc->cond);
+            tc->stats.bootstrap_us = cost;
+            tc->stats.bootstrap_nodes = tc->work.live;
+            tc->stats.bootstrap_requests = tc->requests - requests;
+            tc->stats.bytes = tree_bytes(&tc->work);
+            logger(INFO, "Tree cache of %s loaded, %u nodes in %lld ms with %llu requests.",
+                    tc->root, tc->work.live, (long long)cost / 1000,
+                    (unsigned long long)(tc->requests - requests));
+            pthread_mutex_unlock(&tc->lock);
+            fire_events(tc);
+            if (tc->fn) {
+                memset(&ev, 0, sizeof(ev));
+                ev.type = TC_INITIALIZED;
+                ev.version = tc->work.version;
+                tc->fn(&ev, tc->arg);
+            }
+            pthread_mutex_lock(&tc->lock);
+            continue;
+        }
+        tc->stats.changes += tc->events.count;
+        tc->stats.change_batches++;
+        tc->stats.change_requests += tc->requests - requests;
+        tc->stats.change_us += cost;
+        tc->stats.last_change_us = cost;
+        tc->stats.resyncs += resync;
+        tc->stats.bytes = tree_bytes(&tc->work);
+        logger(DEBUG, "Tree cache of %s applied %d changes in %lld us with %llu requests.",
+                tc->root, tc->events.count, (long long)cost,
+                (unsigned long long)(tc->requests - requests));
+        pthread_mutex_unlock(&tc->lock);
+        fire_events(tc);
+        pthread_mutex_lock(&tc->lock);
+        if (rc != ZK_OK) {
+            logger(WARN, "Failed to refresh tree cache of %s, resync in %d ms.", tc->root, TC_RETRY);
+            tc->resync = 1;
+            abstime_after(&ts, TC_RETRY);
+            while (!tc->stop && pthread_cond_timedwait(&tc->cond, &tc->lock, &ts) != ETIMEDOUT);
+        }
+    }
+    pthread_mutex_unlock(&tc->lock);
+    return NULL;
+}
+
+static int in_subtree(struct tree_cache *tc, const char *path) {
+    if (tc->root_len == 1) return path[0] == '/';
+    return !strncmp(path, tc->root, tc->root_len)
+        && (path[tc->root_len] == '\0' || path[tc->root_len] == '/');
+}
+
+// on_watch runs on the I/O thread, it only queues the notification
+static void on_watch(zk_client *c, int type, const char *path, void *arg) {
+    struct tree_cache *tc = arg;
+
+    if (path && !in_subtree(tc, path)) return;
+    pthread_mutex_lock(&tc->lock);
+    if (!path) {
+        tc->resync = 1;
+    } else if (tc->changes.count >= TC_MAX_CHANGES || changes_push(&tc->changes, type, path) != ZK_OK) {
+        changes_free(&tc->changes);
+        tc->resync = 1;
+    }
+    if (tc->resync) changes_free(&tc->changes);
+    pthread_cond_signal(&tc->cond);
+    pthread_mutex_unlock(&tc->lock);
+}
+
+// treecache_new mirrors the subtree at root and keeps it current with
+// watches. It returns once the subtree is loaded, fn gets the events of the
+// load and every later change from the updater thread.
+struct tree_cache *treecache_new(zk_client *c, const char *root, tc_event_fn fn, void *arg) {
+    int state;
+    struct tree_cache *tc;
+    struct tc_snapshot *w;
+
+    if (!c || !root || root[0] != '/') return NULL;
+    if (!(tc = calloc(1, sizeof(*tc)))) return NULL;
+    tc->c = c;
+    tc->fn = fn;
+    tc->arg = arg;
+    tc->resync = 1;
+    pthread_mutex_init(&tc->lock, NULL);
+    pthread_cond_init(&tc->cond, NULL);
+    w = &tc->work;
+    w->root = TC_NONE;
+    w->free_list = TC_NONE;
+    w->nslots = 1024;
+    stat_block_init(&w->stats, 1);
+    if (!(tc->root = strdup(root))) goto ERROR;
+    tc->root_len = strlen(root);
+    // a trailing slash would never match the paths of notifications
+    if (tc->root_len > 1 && root[tc->root_len - 1] == '/') tc->root[--tc->root_len] = '\0';
+    w->slots = malloc(sizeof(uint32_t) * w->nslots);
+    w->paths = pool_new();
+    w->datas = pool_new();
+    if (!w->slots || !w->paths || !w->datas) goto ERROR;
+    memset(w->slots, 0xff, sizeof(uint32_t) * w->nslots);
+    if (zk_add_watcher(c, on_watch, tc) != ZK_OK) goto ERROR;
+    if (pthread_create(&tc->tid, NULL, update_loop, tc) != 0) {
+        zk_remove_watcher(c, on_watch, tc);
+        goto ERROR;
+    }
+
+    pthread_mutex_lock(&tc->lock);
+    while (!tc->state) pthread_cond_wait(&tc->cond, &tc->lock);
+    state = tc->state;
+    pthread_mutex_unlock(&tc->lock);
+    if (state < 0) {
+        logger(WARN, "Failed to load tree cache of %s.", tc->root);
+        treecache_free(tc);
+        return NULL;
+    }
+    return tc;
+
+ERROR:
+    snapshot_destroy(w);
+    free(tc->root);
+    pthread_mutex_destroy(&tc->lock);
+    pthread_cond_destroy(&tc->cond);
+    free(tc);
+    return NULL;
+}
+
+// treecache_free stops the updates, snapshots still held stay readable
+void treecache_free(struct tree_cache *tc) {
+    if (!tc) return;
+    zk_remove_watcher(tc->c, on_watch, tc);
+    pthread_mutex_lock(&tc->lock);
+    tc->stop = 1;
+    pthread_cond_signal(&tc->cond);
+    pthread_mutex_unlock(&tc->lock);
+    pthread_join(tc->tid, NULL);
+
+    tc_snapshot_put(tc->current);
+    snapshot_destroy(&tc->work);
+    changes_free(&tc->changes);
+    changes_free(&tc->events);
+    free(tc->root);
+    pthread_mutex_destroy(&tc->lock);
+    pthread_cond_destroy(&tc->cond);
+    free(tc);
+}
+
+void treecache_stats(struct tree_cache *tc, struct tc_stats *stats) {
+    pthread_mutex_lock(&tc->lock);
+    *stats = tc->stats;
+    pthread_mutex_unlock(&tc->lock);
+}
+
+// tc_snapshot_get returns the current snapshot without taking a lock, it
+// must be released with tc_snapshot_put.
+struct tc_snapshot *tc_snapshot_get(struct tree_cache *tc) {
+    struct tc_snapshot *s;
+
+    __atomic_add_fetch(&tc->entering, 1, __ATOMIC_SEQ_CST);
+    s = __atomic_load_n(&tc->current, __ATOMIC_SEQ_CST);
+    if (s) __atomic_add_fetch(&s->refs, 1, __ATOMIC_SEQ_CST);
+    __atomic_sub_fetch(&tc->entering, 1, __ATOMIC_SEQ_CST);
+    return s;
+}
+
+void tc_snapshot_put(struct tc_snapshot *s) {
+    if (!s || __atomic_sub_fetch(&s->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+    snapshot_destroy(s);
+    free(s);
+}
+
+struct tc_node *tc_lookup(struct tc_snapshot *s, const char *path) {
+    uint32_t idx;
+
+    if (!s || !path) return NULL;
+    idx = lookup_index(s, path, strlen(path));
+    return idx != TC_NONE ? &s->nodes[idx] : NULL;
+}
+
+struct tc_node *tc_child(struct tc_snapshot *s, struct tc_node *n) {
+    return n->first_child != TC_NONE ? &s->nodes[n->first_child] : NULL;
+}
+
+struct tc_node *tc_sibling(struct tc_snapshot *s, struct tc_node *n) {
+    return n->next_sibling != TC_NONE ? &s->nodes[n->next_sibling] : NULL;
+}
+
+const char *tc_path(struct tc_snapshot *s, struct tc_node *n) {
+    return pool_at(s->paths, n->path);
+}
+
+// tc_data returns the data of n, which is NUL terminated, or NULL when the
+// node has none.
+const char *tc_data(struct tc_snapshot *s, struct tc_node *n) {
+    return n->data != TC_NONE ? pool_at(s->datas, n->data) : NULL;
+}
+
+void tc_stat(struct tc_snapshot *s, struct tc_node *n, struct Stat *stat) {
+    stat_block_get_stat(&s->stats, n - s->nodes, stat);
+}
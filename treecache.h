@@ -0,0 +1,88 @@
+#ifndef __TREECACHE_H_
+#define __TREECACHE_H_
+
+#include <stdint.h>
+#include "statblock.h"
+#include "zkclient.h"
+#include "zookeeper.jute.h"
+
+#define TC_NONE 0xffffffffu
+
+// types of tree cache events
+#define TC_NODE_ADDED 1
+#define TC_NODE_UPDATED 2
+#define TC_NODE_REMOVED 3
+#define TC_INITIALIZED 4
+
+// tc_node is one node of a tree cache snapshot. path and data are offsets
+// into the snapshot's pools, data is TC_NONE for a node without data. Stats
+// live in the snapshot's stat block at the node's index.
+struct tc_node {
+    uint32_t path;
+    uint32_t data;
+    int32_t path_len;
+    int32_t data_len;
+    uint32_t parent;
+    uint32_t first_child;
+    uint32_t next_sibling;
+    uint32_t prev_sibling;
+};
+
+struct tc_pool;
+
+// tc_snapshot is an immutable view of the subtree, readers take it with
+// tc_snapshot_get and release it with tc_snapshot_put. Removed nodes keep
+// their index with path set to TC_NONE until the slot is reused.
+struct tc_snapshot {
+    int refs;
+    uint64_t version;
+    uint32_t root; // TC_NONE while the root doesn't exist
+    uint32_t count;
+    uint32_t cap;
+    uint32_t live;
+    uint32_t free_list;
+    struct tc_node *nodes;
+    struct stat_block stats;
+    uint32_t *slots;
+    uint32_t nslots;
+    uint32_t used_slots;
+    struct tc_pool *paths;
+    struct tc_pool *datas;
+};
+
+struct tc_event {
+    int type;
+    const char *path; // NULL for TC_INITIALIZED
+    uint64_t version; // snapshot which holds the change
+};
+
+typedef void (*tc_event_fn)(struct tc_event *ev, void *arg);
+
+// tc_stats reports what the cache cost, times are in microseconds.
+struct tc_stats {
+    int64_t bootstrap_us;
+    uint32_t bootstrap_nodes;
+    uint64_t bootstrap_requests;
+    uint64_t changes;
+    uint64_t change_batches;
+    uint64_t change_requests;
+    int64_t change_us;
+    int64_t last_change_us;
+    uint64_t resyncs;
+    uint64_t bytes;
+};
+
+struct tree_cache;
+
+struct tree_cache *treecache_new(zk_client *c, const char *root, tc_event_fn fn, void *arg);
+void treecache_free(struct tree_cache *tc);
+void treecache_stats(struct tree_cache *tc, struct tc_stats *stats);
+struct tc_snapshot *tc_snapshot_get(struct tree_cache *tc);
+void tc_snapshot_put(struct tc_snapshot *s);
+struct tc_node *tc_lookup(struct tc_snapshot *s, const char *path);
+struct tc_node *tc_child(struct tc_snapshot *s, struct tc_node *n);
+struct tc_node *tc_sibling(struct tc_snapshot *s, struct tc_node *n);
+const char *tc_path(struct tc_snapshot *s, struct tc_node *n);
+const char *tc_data(struct tc_snapshot *s, struct tc_node *n);
+void tc_stat(struct tc_snapshot *s, struct tc_node *n, struct Stat *stat);
+#endif
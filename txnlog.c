@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "util.h"
+#include "txnlog.h"
+#include "zkclient.h"
+#include "request.h"
+#include "recordio.h"
+#include "zookeeper.codec.h"
+#include "codec.h"
+
+#define TXN_EOR 0x42 // 'B', terminates every entry
+
+static int read_int32(FILE *fp, int32_t *v) {
+    char b[4];
+
+    if (fread(b, 4, 1, fp) != 1) return ZK_ERROR;
+    *v = (int32_t)load_be32(b);
+    return ZK_OK;
+}
+
+static int read_int64(FILE *fp, int64_t *v) {
+    char b[8];
+
+    if (fread(b, 8, 1, fp) != 1) return ZK_ERROR;
+    *v = (int64_t)load_be64(b);
+    return ZK_OK;
+}
+
+struct txnlog *txnlog_open(const char *filename) {
+    struct txnlog *log;
+
+    if (!filename || !(log = calloc(1, sizeof(*log)))) return NULL;
+    if (!(log->fp = fopen(filename, "rb"))) {
+        free(log);
+        return NULL;
+    }
+    log->filename = strdup(filename);
+    if (read_int32(log->fp, &log->header.magic) != ZK_OK ||
+        read_int32(log->fp, &log->header.version) != ZK_OK ||
+        read_int64(log->fp, &log->header.dbid) != ZK_OK ||
+        log->header.magic != TXNLOG_MAGIC) {
+        txnlog_close(log);
+        return NULL;
+    }
+    log->offset = ftell(log->fp);
+    return log;
+}
+
+void txnlog_close(struct txnlog *log) {
+    if (!log) return;
+    if (log->fp) fclose(log->fp);
+    free(log->filename);
+    free(log->buf);
+    free(log);
+}
+
+// txnlog_next returns 1 and fills entry while complete entries are left, 0
+// at the end of the written part of the log and ZK_ERROR on a checksum or
+// framing error. Logs are preallocated with zeros, so a zero length marks the
+// end. On anything but 1 the read position is left at the start of the
+// entry, so a follower can simply retry once the server appended more.
+int txnlog_next(struct txnlog *log, struct txn_entry *entry) {
+    int rc, eor;
+    int32_t len = 0;
+    char *buf;
+    struct iarchive *ia;
+
+    clearerr(log->fp);
+    // the stream may still buffer the zeros read last time, fseek doesn't
+    // drop a buffer it can seek within.
+    if (log->retry) fflush(log->fp);
+    log->retry = 1;
+    if (fseek(log->fp, log->offset, SEEK_SET) != 0) return ZK_ERROR;
+    if (read_int64(log->fp, &entry->crc) != ZK_OK ||
+        read_int32(log->fp, &len) != ZK_OK || len <= 0) {
+        return len < 0 ? ZK_ERROR : 0;
+    }
+    if (len > log->cap) {
+        if (!(buf = realloc(log->buf, len))) return ZK_ERROR;
+        log->buf = buf;
+        log->cap = len;
+    }
+    if (fread(log->buf, len, 1, log->fp) != 1 || (eor = fgetc(log->fp)) == EOF) {
+        return 0;
+    }
+    if (eor != TXN_EOR || (uint32_t)entry->crc != adler32(1, log->buf, len)) {
+        return ZK_ERROR;
+    }
+    if (!(ia = create_buffer_iarchive(log->buf, len))) return ZK_ERROR;
+    rc = jute_decode_TxnHeader(ia, &entry->header);
+    entry->body_len = len - get_iarchive_offset(ia);
+    entry->body = log->buf + len - entry->body_len;
+    close_buffer_iarchive(&ia);
+    if (rc < 0) return ZK_ERROR;
+    entry->offset = log->offset;
+    log->offset = ftell(log->fp);
+    log->retry = 0;
+    return 1;
+}
+
+// txnlog_next_file returns the log which follows filename in its directory,
+// the server rolls over to log.<first zxid> once a log grows large enough.
+char *txnlog_next_file(const char *filename) {
+    int dir_len;
+    int64_t zxid, cur, best = -1;
+    char *slash, *dot, *endp, *next = NULL;
+    const char *dir;
+    DIR *dp;
+    struct dirent *ent;
+
+    if (!(dot = strrchr(filename, '.'))) return NULL;
+    slash = strrchr(filename, '/');
+    dir = slash ? filename : ".";
+    dir_len = slash ? slash - filename : 1;
+    cur = strtoll(dot + 1, NULL, 16);
+    char path[dir_len + 1];
+    memcpy(path, dir, dir_len);
+    path[dir_len] = '\0';
+    if (!(dp = opendir(path))) return NULL;
+    while ((ent = readdir(dp))) {
+        if (strncmp(ent->d_name, "log.", 4)) continue;
+        zxid = strtoll(ent->d_name + 4, &endp, 16);
+        if (*endp != '\0' || zxid <= cur) continue;
+        if (best == -1 || zxid < best) {
+            best = zxid;
+            free(next);
+            next = malloc(dir_len + strlen(ent->d_name) + 2);
+            sprintf(next, "%s/%s", path, ent->d_name);
+        }
+    }
+    closedir(dp);
+    return next;
+}
+
+static int deserialize_create(struct iarchive *ia, int32_t type, struct CreateTxn *v) {
+    int rc;
+    int64_t ttl;
+
+    if (type == CREATE_OPCODE || type == CREATE2_TXN) {
+        return jute_decode_CreateTxn(ia, v);
+    }
+    // CreateContainerTxn and CreateTTLTxn have no ephemeral flag, the TTL
+    // one carries a trailing ttl.
+    v->ephemeral = 0;
+    rc = ia->deserialize_String(ia, "path", &v->path);
+    rc = rc < 0 ? rc : ia->deserialize_Buffer(ia, "data", &v->data);
+    rc = rc < 0 ? rc : jute_decode_ACL_vector(ia, &v->acl);
+    rc = rc < 0 ? rc : ia->deserialize_Int(ia, "parentCVersion", &v->parentCVersion);
+    if (rc == 0 && type == CREATE_TTL_TXN) {
+        rc = ia->deserialize_Long(ia, "ttl", &ttl);
+    }
+    return rc;
+}
+
+// txn_decode decodes the body of a txn of the given type, which is either an
+// entry body or one of the sub txns of a multi. Newer servers append a digest
+// to the entry, trailing bytes are therefore ignored.
+int txn_decode(int32_t type, char *buf, int32_t len, struct txn_body *body) {
+    int rc = 0;
+    struct iarchive *ia;
+
+    memset(body, 0, sizeof(*body));
+    body->type = type;
+    if (!(ia = create_buffer_iarchive(buf, len))) return ZK_ERROR;
+    switch (type) {
+        case CREATE_OPCODE:
+        case CREATE2_TXN:
+        case CREATE_CONTAINER_TXN:
+        case CREATE_TTL_TXN:
+            rc = deserialize_create(ia, type, &body->u.create);
+            break;
+        case DELETE_OPCODE:
+        case DELETE_CONTAINER_TXN:
+            rc = jute_decode_DeleteTxn(ia, &body->u.del);
+            break;
+        case SETDATA_OPCODE:
+            rc = jute_decode_SetDataTxn(ia, &body->u.set_data);
+            break;
+        case SETACL_OPCODE:
+            rc = jute_decode_SetACLTxn(ia, &body->u.set_acl);
+            break;
+        case CHECK_OPCODE:
+            rc = jute_decode_CheckVersionTxn(ia, &body->u.check);
+            break;
+        case MULTI_OPCODE:
+            rc = jute_decode_MultiTxn(ia, &body->u.multi);
+            break;
+        case CREATE_SESSION_TXN:
+            rc = jute_decode_CreateSessionTxn(ia, &body->u.create_session);
+            break;
+        case ERROR_TXN:
+            rc = jute_decode_ErrorTxn(ia, &body->u.error);
+            break;
+    }
+    close_buffer_iarchive(&ia);
+    if (rc < 0) {
+        deallocate_txn_body(body);
+        return ZK_ERROR;
+    }
+    return ZK_OK;
+}
+
+void deallocate_txn_body(struct txn_body *body) {
+    switch (body->type) {
+        case CREATE_OPCODE:
+        case CREATE2_TXN:
+        case CREATE_CONTAINER_TXN:
+        case CREATE_TTL_TXN:
+            deallocate_CreateTxn(&body->u.create);
+            break;
+        case DELETE_OPCODE:
+        case DELETE_CONTAINER_TXN:
+            deallocate_DeleteTxn(&body->u.del);
+            break;
+        case SETDATA_OPCODE:
+            deallocate_SetDataTxn(&body->u.set_data);
+            break;
+        case SETACL_OPCODE:
+            deallocate_SetACLTxn(&body->u.set_acl);
+            break;
+        case CHECK_OPCODE:
+            deallocate_CheckVersionTxn(&body->u.check);
+            break;
+        case MULTI_OPCODE:
+            deallocate_MultiTxn(&body->u.multi);
+            break;
+    }
+    memset(body, 0, sizeof(*body));
+}
+
+// txn_path returns the path a txn writes to, or NULL for session and
+// multi txns.
+const char *txn_path(struct txn_body *body) {
+    switch (body->type) {
+        case CREATE_OPCODE:
+        case CREATE2_TXN:
+        case CREATE_CONTAINER_TXN:
+        case CREATE_TTL_TXN:
+            return body->u.create.path;
+        case DELETE_OPCODE:
+        case DELETE_CONTAINER_TXN:
+            return body->u.del.path;
+        case SETDATA_OPCODE:
+            return body->u.set_data.path;
+        case SETACL_OPCODE:
+            return body->u.set_acl.path;
+        case CHECK_OPCODE:
+            return body->u.check.path;
+    }
+    return NULL;
+}
+
+const char *txn_type_name(int32_t type) {
+    switch (type) {
+        case CREATE_OPCODE: return "create";
+        case CREATE2_TXN: return "create2";
+        case CREATE_CONTAINER_TXN: return "createContainer";
+        case CREATE_TTL_TXN: return "createTTL";
+        case DELETE_OPCODE: return "delete";
+        case DELETE_CONTAINER_TXN: return "deleteContainer";
+        case SETDATA_OPCODE: return "setData";
+        case SETACL_OPCODE: return "setACL";
+        case CHECK_OPCODE: return "check";
+        case MULTI_OPCODE: return "multi";
+        case CREATE_SESSION_TXN: return "createSession";
+        case CLOSE_SESSION_TXN: return "closeSession";
+        case ERROR_TXN: return "error";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef __TXNLOG_H_
+#define __TXNLOG_H_
+
+#include <stdio.h>
+#include "zookeeper.jute.h"
+
+#define TXNLOG_MAGIC 0x5a4b4c47 // "ZKLG"
+
+// txn types which only show up in the log
+#define CREATE2_TXN 15
+#define CREATE_CONTAINER_TXN 19
+#define DELETE_CONTAINER_TXN 20
+#define CREATE_TTL_TXN 21
+#define CREATE_SESSION_TXN -10
+#define CLOSE_SESSION_TXN -11
+#define ERROR_TXN -1
+
+struct txnlog {
+    FILE *fp;
+    char *filename;
+    struct FileHeader header;
+    char *buf;
+    int32_t cap;
+    long offset;
+    int retry; // the last read stopped before a complete entry
+};
+
+// txn_entry is one entry of the log, body points into the log's buffer and
+// is only valid until the next call to txnlog_next.
+struct txn_entry {
+    int64_t crc;
+    long offset;
+    struct TxnHeader header;
+    char *body;
+    int32_t body_len;
+};
+
+// txn_body is a decoded txn, all the create flavours decode into create.
+struct txn_body {
+    int32_t type;
+    union {
+        struct CreateTxn create;
+        struct DeleteTxn del;
+        struct SetDataTxn set_data;
+        struct SetACLTxn set_acl;
+        struct CheckVersionTxn check;
+        struct CreateSessionTxn create_session;
+        struct ErrorTxn error;
+        struct MultiTxn multi;
+    } u;
+};
+
+struct txnlog *txnlog_open(const char *filename);
+void txnlog_close(struct txnlog *log);
+int txnlog_next(struct txnlog *log, struct txn_entry *entry);
+char *txnlog_next_file(const char *filename);
+int txn_decode(int32_t type, char *buf, int32_t len, struct txn_body *body);
+void deallocate_txn_body(struct txn_body *body);
+const char *txn_path(struct txn_body *body);
+const char *txn_type_name(int32_t type);
+#endif
@@ -0,0 +1,392 @@
+#include <stdlib.h>
+#include <string.h>
+#include "uring.h"
+#include "zkclient.h"
+
+#if defined(USE_IO_URING) && defined(__linux__)
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "util.h"
+
+// One ring per connection, used by the I/O thread only:
+//  - replies are read by a multishot recv into a ring of provided buffers,
+//    which go back to the kernel as soon as their bytes are consumed.
+//  - the wakeup pipe is read through the ring too, so a wakeup costs no
+//    syscall of its own.
+//  - a burst of frames is copied into a registered send buffer and written
+//    with WRITE_FIXED, bursts larger than that are sent from a copy on the
+//    heap. Only one send is in flight at a time, which keeps frames in
+//    order, callers queue up behind it and go out as the next burst.
+#define URING_ENTRIES 64
+#define RECV_BUFS 64 // power of two
+#define RECV_BUF_SIZE (16 * 1024)
+#define SEND_BUF_SIZE (256 * 1024)
+#define RECV_GROUP 0
+
+enum {
+    TAG_RECV = 1,
+    TAG_WAKE,
+    TAG_SEND
+};
+
+struct uring {
+    int fd;
+    int sock;
+    int wake_fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_entries;
+    unsigned pending;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *ring;
+    size_t ring_size;
+    size_t sqes_size;
+    struct io_uring_buf_ring *bufs;
+    char *recv_bufs;
+    uint16_t bufs_tail;
+    int recv_armed;
+    int wake_armed;
+    char *send_buf;
+    int send_fixed;
+    char *send_heap;
+    char *send_pos;
+    int send_left;
+    char wake_buf[64];
+};
+
+static int uring_setup(unsigned entries, struct io_uring_params *p) {
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_register(int fd, unsigned op, void *arg, unsigned n) {
+    return syscall(__NR_io_uring_register, fd, op, arg, n);
+}
+
+static int uring_enter(struct uring *u, unsigned min_complete, int timeout) {
+    unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+
+    if (timeout < 0 || !min_complete) {
+        return syscall(__NR_io_uring_enter, u->fd, u->pending, min_complete, flags, NULL, 0);
+    }
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000LL;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)(uintptr_t)&ts;
+    return syscall(__NR_io_uring_enter, u->fd, u->pending, min_complete,
+            flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+static int flush_sqes(struct uring *u) {
+    int rc;
+
+    while (u->pending > 0) {
+        rc = uring_enter(u, 0, -1);
+        if (rc < 0 && errno != EINTR) return ZK_ERROR;
+        if (rc > 0) u->pending -= rc;
+    }
+    return ZK_OK;
+}
+
+static struct io_uring_sqe *get_sqe(struct uring *u) {
+    unsigned tail = *u->sq_tail, idx;
+    struct io_uring_sqe *sqe;
+
+    if (tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) {
+        if (flush_sqes(u) != ZK_OK) return NULL;
+    }
+    idx = tail & *u->sq_mask;
+    sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[idx] = idx;
+    return sqe;
+}
+
+static void push_sqe(struct uring *u) {
+    __atomic_store_n(u->sq_tail, *u->sq_tail + 1, __ATOMIC_RELEASE);
+    u->pending++;
+}
+
+static int arm_recv(struct uring *u) {
+    struct io_uring_sqe *sqe;
+
+    if (!(sqe = get_sqe(u))) return ZK_ERROR;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = u->sock;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_GROUP;
+    sqe->user_data = TAG_RECV;
+    push_sqe(u);
+    u->recv_armed = 1;
+    return ZK_OK;
+}
+
+static int arm_wake(struct uring *u) {
+    struct io_uring_sqe *sqe;
+
+    if (!(sqe = get_sqe(u))) return ZK_ERROR;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = u->wake_fd;
+    sqe->addr = (uint64_t)(uintptr_t)u->wake_buf;
+    sqe->len = sizeof(u->wake_buf);
+    sqe->off = (uint64_t)-1;
+    sqe->user_data = TAG_WAKE;
+    push_sqe(u);
+    u->wake_armed = 1;
+    return ZK_OK;
+}
+
+static int queue_send(struct uring *u) {
+    struct io_uring_sqe *sqe;
+
+    if (!(sqe = get_sqe(u))) return ZK_ERROR;
+    if (u->send_fixed && !u->send_heap) {
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->buf_index = 0;
+        sqe->off = (uint64_t)-1;
+    } else {
+        sqe->opcode = IORING_OP_SEND;
+        sqe->msg_flags = MSG_NOSIGNAL;
+    }
+    sqe->fd = u->sock;
+    sqe->addr = (uint64_t)(uintptr_t)u->send_pos;
+    sqe->len = u->send_left;
+    sqe->user_data = TAG_SEND;
+    push_sqe(u);
+    return ZK_OK;
+}
+
+static void recycle_buf(struct uring *u, int bid) {
+    struct io_uring_buf *buf = &u->bufs->bufs[u->bufs_tail & (RECV_BUFS - 1)];
+
+    buf->addr = (uint64_t)(uintptr_t)(u->recv_bufs + (size_t)bid * RECV_BUF_SIZE);
+    buf->len = RECV_BUF_SIZE;
+    buf->bid = bid;
+    u->bufs_tail++;
+}
+
+static int setup_bufs(struct uring *u) {
+    int i;
+    struct io_uring_buf_reg reg;
+    struct iovec iov;
+
+    u->bufs = mmap(NULL, RECV_BUFS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+            MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (u->bufs == MAP_FAILED) {
+        u->bufs = NULL;
+        return ZK_ERROR;
+    }
+    if (!(u->recv_bufs = malloc((size_t)RECV_BUFS * RECV_BUF_SIZE))) return ZK_ERROR;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)u->bufs;
+    reg.ring_entries = RECV_BUFS;
+    reg.bgid = RECV_GROUP;
+    if (uring_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) return ZK_ERROR;
+    for (i = 0; i < RECV_BUFS; i++) recycle_buf(u, i);
+    __atomic_store_n(&u->bufs->tail, u->bufs_tail, __ATOMIC_RELEASE);
+
+    if (!(u->send_buf = malloc(SEND_BUF_SIZE))) return ZK_ERROR;
+    iov.iov_base = u->send_buf;
+    iov.iov_len = SEND_BUF_SIZE;
+    // pinning may exceed RLIMIT_MEMLOCK, plain sends work as well
+    u->send_fixed = uring_register(u->fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0;
+    return ZK_OK;
+}
+
+// uring_new sets up a ring for sock, it returns NULL when the kernel lacks
+// io_uring or one of the features used here, and the caller falls back to
+// poll.
+struct uring *uring_new(int sock, int wake_fd) {
+    struct uring *u;
+    struct io_uring_params p;
+    char *ring;
+
+    if (!(u = calloc(1, sizeof(*u)))) return NULL;
+    u->sock = sock;
+    u->wake_fd = wake_fd;
+    memset(&p, 0, sizeof(p));
+    if ((u->fd = uring_setup(URING_ENTRIES, &p)) < 0) {
+        logger(DEBUG, "io_uring is unavailable, %s", strerror(errno));
+        free(u);
+        return NULL;
+    }
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG)) {
+        goto ERROR;
+    }
+    u->ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    if (p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe) > u->ring_size) {
+        u->ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    }
+    u->ring = mmap(NULL, u->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            u->fd, IORING_OFF_SQ_RING);
+    if (u->ring == MAP_FAILED) {
+        u->ring = NULL;
+        goto ERROR;
+    }
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        goto ERROR;
+    }
+    ring = u->ring;
+    u->sq_head = (unsigned *)(ring + p.sq_off.head);
+    u->sq_tail = (unsigned *)(ring + p.sq_off.tail);
+    u->sq_mask = (unsigned *)(ring + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)(ring + p.sq_off.array);
+    u->sq_entries = p.sq_entries;
+    u->cq_head = (unsigned *)(ring + p.cq_off.head);
+    u->cq_tail = (unsigned *)(ring + p.cq_off.tail);
+    u->cq_mask = (unsigned *)(ring + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(ring + p.cq_off.cqes);
+
+    if (setup_bufs(u) != ZK_OK) {
+        logger(DEBUG, "io_uring lacks provided buffer rings, %s", strerror(errno));
+        goto ERROR;
+    }
+    if (arm_recv(u) != ZK_OK || arm_wake(u) != ZK_OK || flush_sqes(u) != ZK_OK) goto ERROR;
+    return u;
+
+ERROR:
+    uring_free(u);
+    return NULL;
+}
+
+void uring_free(struct uring *u) {
+    if (!u) return;
+    // closing the ring cancels the recv and the pipe read
+    close(u->fd);
+    if (u->sqes) munmap(u->sqes, u->sqes_size);
+    if (u->ring) munmap(u->ring, u->ring_size);
+    if (u->bufs) munmap(u->bufs, RECV_BUFS * sizeof(struct io_uring_buf));
+    free(u->recv_bufs);
+    free(u->send_buf);
+    free(u->send_heap);
+    free(u);
+}
+
+int uring_sending(struct uring *u) {
+    return u->send_left > 0;
+}
+
+// uring_send queues the n frames as one write, the caller waits for the
+// previous one to finish first.
+int uring_send(struct uring *u, struct iovec *iov, int n) {
+    int i;
+    size_t len = 0;
+    char *pos;
+
+    for (i = 0; i < n; i++) len += iov[i].iov_len;
+    if (len == 0) return ZK_OK;
+    if (len > SEND_BUF_SIZE || len > INT32_MAX) {
+        if (len > INT32_MAX || !(u->send_heap = malloc(len))) return ZK_ERROR;
+        pos = u->send_heap;
+    } else {
+        pos = u->send_buf;
+    }
+    u->send_pos = pos;
+    u->send_left = len;
+    for (i = 0; i < n; i++) {
+        memcpy(pos, iov[i].iov_base, iov[i].iov_len);
+        pos += iov[i].iov_len;
+    }
+    return queue_send(u);
+}
+
+// uring_wait submits the queued work and handles completions, waiting up
+// to timeout ms (-1 is forever) for the first one. woken is set when the
+// wakeup pipe was read. It returns ZK_OK, ZK_TIMEOUT, or ZK_SOCKET_ERR
+// once the connection is broken.
+int uring_wait(struct uring *u, int timeout, uring_data_fn on_data, void *arg, int *woken) {
+    int rc, ret = ZK_OK, bid, seen = 0, timed_out;
+    unsigned head, tail;
+    struct io_uring_cqe *cqe;
+
+    *woken = 0;
+    rc = uring_enter(u, 1, timeout);
+    if (rc > 0) u->pending -= rc < (int)u->pending ? rc : u->pending;
+    if (rc < 0 && errno != ETIME && errno != EINTR) return ZK_SOCKET_ERR;
+    timed_out = rc < 0 && errno == ETIME;
+
+    head = *u->cq_head;
+    tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++, seen++) {
+        cqe = &u->cqes[head & *u->cq_mask];
+        switch (cqe->user_data) {
+            case TAG_RECV:
+                if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+                    bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+                    if (ret == ZK_OK) {
+                        ret = on_data(arg, u->recv_bufs + (size_t)bid * RECV_BUF_SIZE, cqe->res);
+                    }
+                    recycle_buf(u, bid);
+                } else if (cqe->res != -ENOBUFS) {
+                    // 0 is the server closing the connection
+                    ret = ZK_SOCKET_ERR;
+                }
+                if (!(cqe->flags & IORING_CQE_F_MORE)) u->recv_armed = 0;
+                break;
+            case TAG_WAKE:
+                *woken = 1;
+                u->wake_armed = 0;
+                break;
+            case TAG_SEND:
+                if (cqe->res <= 0) {
+                    ret = ZK_SOCKET_ERR;
+                    break;
+                }
+                u->send_pos += cqe->res;
+                u->send_left -= cqe->res;
+                if (u->send_left > 0) {
+                    if (queue_send(u) != ZK_OK) ret = ZK_SOCKET_ERR;
+                } else {
+                    free(u->send_heap);
+                    u->send_heap = NULL;
+                }
+                break;
+        }
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+    __atomic_store_n(&u->bufs->tail, u->bufs_tail, __ATOMIC_RELEASE);
+    if (ret == ZK_OK && !u->recv_armed && arm_recv(u) != ZK_OK) ret = ZK_SOCKET_ERR;
+    if (!u->wake_armed && arm_wake(u) != ZK_OK) ret = ZK_SOCKET_ERR;
+    if (ret == ZK_OK && seen == 0 && timed_out) ret = ZK_TIMEOUT;
+    return ret;
+}
+
+#else
+
+struct uring *uring_new(int sock, int wake_fd) {
+    return NULL;
+}
+
+void uring_free(struct uring *u) {
+}
+
+int uring_sending(struct uring *u) {
+    return 0;
+}
+
+int uring_send(struct uring *u, struct iovec *iov, int n) {
+    return ZK_ERROR;
+}
+
+int uring_wait(struct uring *u, int timeout, uring_data_fn on_data, void *arg, int *woken) {
+    return ZK_ERROR;
+}
+#endif
@@ -0,0 +1,20 @@
+#ifndef __URING_H_
+#define __URING_H_
+
+#include <sys/uio.h>
+
+// uring is the io_uring transport of the I/O thread. It is only built with
+// `make IO_URING=1` on Linux, otherwise uring_new always fails and the
+// thread keeps using poll, read and sendmsg.
+struct uring;
+
+// uring_data_fn receives the bytes read from the socket, anything but ZK_OK
+// breaks the connection.
+typedef int (*uring_data_fn)(void *arg, const char *buf, int len);
+
+struct uring *uring_new(int sock, int wake_fd);
+void uring_free(struct uring *u);
+int uring_sending(struct uring *u);
+int uring_send(struct uring *u, struct iovec *iov, int n);
+int uring_wait(struct uring *u, int timeout, uring_data_fn on_data, void *arg, int *woken);
+#endif
@@ -4,10 +4,38 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define LOG_RING_SIZE 1024 // must be a power of two
+#define LOG_MSG_SIZE 4096 // the limit of the synchronous path
 
 static char *log_file = NULL;
 static enum LEVEL log_level = INFO;
 
+// Once a log file is set, messages go through a bounded multi-producer ring
+// (one sequence number per slot, as in Vyukov's queue) and a writer thread
+// appends them to the file, which it keeps open. Producers never block: a
+// message that finds the ring full is counted in log_dropped and the writer
+// reports the count.
+struct log_slot {
+    uint64_t seq;
+    time_t time;
+    enum LEVEL level;
+    int32_t len;
+    char msg[LOG_MSG_SIZE];
+};
+
+static struct log_slot *log_ring;
+static uint64_t log_tail;
+static uint64_t log_head;
+static uint64_t log_dropped;
+static int log_writer_sleeping;
+static int log_writer_stop;
+static pthread_t log_writer;
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_cond = PTHREAD_COND_INITIALIZER;
+
 int32_t atomic_inc(volatile int32_t* operand, int incr) {
     int32_t result;
     asm __volatile__(
@@ -26,6 +54,34 @@ __attribute__((constructor)) int32_t get_xid() {
     return atomic_inc(&xid,1);
 }
 
+// mstime returns a monotonic clock in milliseconds, for timeouts only.
+int64_t mstime(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// abstime_after sets ts to ms from now on the wall clock, which is what
+// pthread_cond_timedwait expects.
+void abstime_after(struct timespec *ts, int64_t ms) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+// ustime is mstime in microseconds
+int64_t ustime(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 char *ll2string(long long v) {
     int i, len = 2;
     long long tmp;
@@ -50,6 +106,26 @@ char *ll2string(long long v) {
     return buf;
 }
 
+// adler32 is the checksum ZooKeeper uses for snapshots and transaction
+// logs, start with adler = 1.
+uint32_t adler32(uint32_t adler, const char *buf, size_t len) {
+    uint32_t a = adler & 0xffff, b = adler >> 16;
+    size_t n;
+
+    while (len > 0) {
+        // 5552 is the largest n keeping b below 2^32 before the modulo
+        n = len < 5552 ? len : 5552;
+        len -= n;
+        while (n--) {
+            a += (uint8_t)*buf++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return b << 16 | a;
+}
+
 // This function was copied from redis/sds.c
 char **sdssplitlen(const char *s, int len, const char *sep, int seplen, int *count) {
     int elements = 0, slots = 5, start = 0, j;
@@ -137,8 +213,159 @@ void set_log_level(enum LEVEL level) {
     log_level  = level;
 } 
 
+static const char *level_name(enum LEVEL level, const char **color) {
+    switch(level) {
+        case DEBUG: *color = C_YELLOW; return "DEBUG";
+        case INFO:  *color = C_GREEN; return "INFO";
+        case WARN:  *color = C_PURPLE; return "WARN";
+        case ERROR: *color = C_RED; return "ERROR";
+    }
+    *color = "";
+    return "";
+}
+
+static int log_slot_ready(uint64_t pos) {
+    return __atomic_load_n(&log_ring[pos & (LOG_RING_SIZE - 1)].seq, __ATOMIC_ACQUIRE) == pos + 1;
+}
+
+static void log_wake_writer(void) {
+    pthread_mutex_lock(&log_mutex);
+    pthread_cond_signal(&log_cond);
+    pthread_mutex_unlock(&log_mutex);
+}
+
+static void *log_writer_loop(void *arg) {
+    int n;
+    FILE *fp = NULL;
+    const char *name = NULL, *cur, *color;
+    char t_buf[64];
+    time_t last = 0, now;
+    uint64_t reported = 0, dropped;
+    struct log_slot *slot;
+    struct timespec deadline;
+
+    for (;;) {
+        cur = __atomic_load_n(&log_file, __ATOMIC_ACQUIRE);
+        if (cur != name) {
+            if (fp && fp != stderr) fclose(fp);
+            if (!(fp = fopen(cur, "a"))) fp = stderr;
+            name = cur;
+        }
+        for (n = 0; log_slot_ready(log_head); n++) {
+            slot = &log_ring[log_head & (LOG_RING_SIZE - 1)];
+            if (slot->time != last) {
+                last = slot->time;
+                strftime(t_buf, sizeof(t_buf), "%Y-%m-%d %H:%M:%S", localtime(&last));
+            }
+            fprintf(fp, "[%s] [%s] %.*s\n", t_buf, level_name(slot->level, &color), slot->len, slot->msg);
+            __atomic_store_n(&slot->seq, log_head + LOG_RING_SIZE, __ATOMIC_RELEASE);
+            log_head++;
+        }
+        dropped = __atomic_load_n(&log_dropped, __ATOMIC_RELAXED);
+        if (dropped != reported) {
+            now = time(NULL);
+            strftime(t_buf, sizeof(t_buf), "%Y-%m-%d %H:%M:%S", localtime(&now));
+            last = now;
+            fprintf(fp, "[%s] [WARN] %llu log messages were dropped as the log ring was full\n",
+                    t_buf, (unsigned long long)(dropped - reported));
+            reported = dropped;
+            n++;
+        }
+        if (n > 0) {
+            fflush(fp);
+            continue;
+        }
+        if (__atomic_load_n(&log_writer_stop, __ATOMIC_ACQUIRE)) break;
+
+        // producers only signal when they see the writer asleep, so check
+        // the ring once more after raising the flag.
+        __atomic_store_n(&log_writer_sleeping, 1, __ATOMIC_SEQ_CST);
+        if (!log_slot_ready(log_head) && !__atomic_load_n(&log_writer_stop, __ATOMIC_SEQ_CST)) {
+            abstime_after(&deadline, 100);
+            pthread_mutex_lock(&log_mutex);
+            pthread_cond_timedwait(&log_cond, &log_mutex, &deadline);
+            pthread_mutex_unlock(&log_mutex);
+        }
+        __atomic_store_n(&log_writer_sleeping, 0, __ATOMIC_SEQ_CST);
+    }
+    if (fp && fp != stderr) fclose(fp);
+    return NULL;
+}
+
+// log_shutdown drains the ring at exit, so the messages logged right before
+// exit(), including the ERROR that triggered it, reach the file.
+static void log_shutdown(void) {
+    __atomic_store_n(&log_writer_stop, 1, __ATOMIC_SEQ_CST);
+    log_wake_writer();
+    pthread_join(log_writer, NULL);
+}
+
+static int log_start_writer(void) {
+    uint64_t i;
+
+    if (!(log_ring = calloc(LOG_RING_SIZE, sizeof(*log_ring)))) return -1;
+    for (i = 0; i < LOG_RING_SIZE; i++) log_ring[i].seq = i;
+    if (pthread_create(&log_writer, NULL, log_writer_loop, NULL) != 0) {
+        free(log_ring);
+        log_ring = NULL;
+        return -1;
+    }
+    atexit(log_shutdown);
+    return 0;
+}
+
+// log_push formats the message straight into a claimed slot, returns -1
+// and counts the message as dropped when the ring is full. Errors are never
+// dropped.
+static int log_push(enum LEVEL level, const char *fmt, va_list ap) {
+    int len;
+    int64_t diff;
+    uint64_t pos, seq;
+    struct log_slot *slot;
+
+    pos = __atomic_load_n(&log_tail, __ATOMIC_RELAXED);
+    for (;;) {
+        slot = &log_ring[pos & (LOG_RING_SIZE - 1)];
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        diff = (int64_t)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&log_tail, &pos, pos + 1, 1,
+                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+        } else if (diff < 0 && level >= ERROR) {
+            // the process exits right after an error, wait for a slot
+            sched_yield();
+            pos = __atomic_load_n(&log_tail, __ATOMIC_RELAXED);
+        } else if (diff < 0) {
+            __atomic_fetch_add(&log_dropped, 1, __ATOMIC_RELAXED);
+            return -1;
+        } else {
+            pos = __atomic_load_n(&log_tail, __ATOMIC_RELAXED);
+        }
+    }
+    slot->time = time(NULL);
+    slot->level = level;
+    len = vsnprintf(slot->msg, LOG_MSG_SIZE, fmt, ap);
+    slot->len = len < 0 ? 0 : (len >= LOG_MSG_SIZE ? LOG_MSG_SIZE - 1 : len);
+    // mark a message that didn't fit instead of cutting it silently
+    if (len >= LOG_MSG_SIZE) memcpy(slot->msg + LOG_MSG_SIZE - 4, "...", 4);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&log_writer_sleeping, __ATOMIC_SEQ_CST)) log_wake_writer();
+    return 0;
+}
+
+uint64_t log_dropped_count(void) {
+    return __atomic_load_n(&log_dropped, __ATOMIC_RELAXED);
+}
+
+// set_log_file sends the log to filename through the async writer, it falls
+// back to opening the file for every message when the writer can't start.
 void set_log_file(char *filename) {
-    log_file = filename;
+    __atomic_store_n(&log_file, filename, __ATOMIC_RELEASE);
+    if (filename && !log_ring) {
+        log_start_writer();
+    } else if (log_ring) {
+        log_wake_writer();
+    }
 }
 
 void logger(enum LEVEL loglevel,char *fmt, ...) {
@@ -147,27 +374,31 @@ void logger(enum LEVEL loglevel,char *fmt, ...) {
     time_t now;
     char buf[4096];
     char t_buf[64];
-    char *msg = NULL;
+    const char *msg;
     const char *color = "";
 
     if(loglevel < log_level) {
         return;
     }
 
+    if (log_ring && log_file) {
+        va_start(ap, fmt);
+        log_push(loglevel, fmt, ap);
+        va_end(ap);
+        if (loglevel >= ERROR) exit(1);
+        return;
+    }
+
     va_start(ap, fmt);
     vsnprintf(buf, sizeof(buf), fmt, ap);
     va_end(ap);
-    switch(loglevel) {
-        case DEBUG: msg = "DEBUG"; color = C_YELLOW; break;
-        case INFO:  msg = "INFO";  color = C_GREEN; break;
-        case WARN:  msg = "WARN";  color = C_PURPLE; break;
-        case ERROR: msg = "ERROR"; color = C_RED; break;
-    }
+    msg = level_name(loglevel, &color);
 
     now = time(NULL);
     strftime(t_buf,64,"%Y-%m-%d %H:%M:%S",localtime(&now));
     fp = (log_file == NULL) ? stdout : fopen(log_file,"a");
-    if(log_file) {
+    if (!fp) fp = stderr;
+    if(log_file && fp != stderr) {
         fprintf(fp, "[%s] [%s] %s\n", t_buf, msg, buf);
         fclose(fp);
     } else {
@@ -2,7 +2,9 @@
 #define __UTIL_H_
 
 #include <stdint.h>
+#include <stddef.h>
 #include <sys/time.h>
+#include <time.h>
 
 #define C_RED "\033[31m"
 #define C_GREEN "\033[32m"
@@ -32,11 +34,16 @@ enum LEVEL {
 
 void logger(enum LEVEL loglevel, char *fmt, ...);
 void set_log_file(char *filename);
+uint64_t log_dropped_count(void);
 void set_log_level(enum LEVEL level);
 void set_loglevel_by_string(const char *level);
 
 __attribute__((constructor)) int32_t get_xid();
+int64_t mstime(void);
+int64_t ustime(void);
+void abstime_after(struct timespec *ts, int64_t ms);
 char *ll2string(long long v);
+uint32_t adler32(uint32_t adler, const char *buf, size_t len);
 char **sdssplitlen(const char *s, int len, const char *sep, int seplen, int *count);
 void sdsfreesplitres(char **tokens, int count); 
 #endif
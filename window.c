@@ -0,0 +1,133 @@
+#include <errno.h>
+
+#include "window.h"
+#include "util.h"
+#include "zkclient.h"
+
+void window_init(struct zk_window *w) {
+    w->limit = 0;
+    w->nonblock = 0;
+    w->inflight = 0;
+    w->waiters = 0;
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    w->target = 0;
+    w->min = w->max = 0;
+    w->gen = w->seen_gen = 0;
+    w->size = 0;
+    w->last_cut = 0;
+}
+
+void window_destroy(struct zk_window *w) {
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+}
+
+static void wake_waiters(struct zk_window *w) {
+    if (__atomic_load_n(&w->waiters, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&w->lock);
+        pthread_cond_broadcast(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+    }
+}
+
+void window_set_limit(struct zk_window *w, int limit, int nonblock) {
+    __atomic_store_n(&w->nonblock, nonblock, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&w->target, 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&w->limit, limit > 0 ? limit : 0, __ATOMIC_SEQ_CST);
+    wake_waiters(w);
+}
+
+// window_set_adaptive starts the controller at min, target is the reply
+// latency in microseconds it steers to.
+void window_set_adaptive(struct zk_window *w, int min, int max, int64_t target) {
+    if (min < 1) min = 1;
+    if (max < min) max = min;
+    __atomic_store_n(&w->min, min, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&w->max, max, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&w->target, target, __ATOMIC_SEQ_CST);
+    // the I/O thread restarts the controller at min once it sees the bump
+    __atomic_add_fetch(&w->gen, 1, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&w->limit, min, __ATOMIC_SEQ_CST);
+    wake_waiters(w);
+}
+
+static int fits(struct zk_window *w, int cur, int n) {
+    int limit = __atomic_load_n(&w->limit, __ATOMIC_SEQ_CST);
+
+    // a burst larger than the window still goes out once the window is empty
+    return limit == 0 || cur == 0 || cur + n <= limit;
+}
+
+// window_acquire reserves n requests in the window, it returns ZK_OK,
+// ZK_WOULDBLOCK in nonblock mode or ZOPERATIONTIMEOUT once the deadline
+// (ms on the mstime clock, 0 is none) passes.
+int window_acquire(struct zk_window *w, int n, int64_t deadline) {
+    int cur, rc = 0;
+    int64_t left;
+    struct timespec ts;
+
+    for (;;) {
+        cur = __atomic_load_n(&w->inflight, __ATOMIC_SEQ_CST);
+        while (fits(w, cur, n)) {
+            if (__atomic_compare_exchange_n(&w->inflight, &cur, cur + n, 1,
+                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+                return ZK_OK;
+            }
+        }
+        if (__atomic_load_n(&w->nonblock, __ATOMIC_SEQ_CST)) return ZK_WOULDBLOCK;
+        if (rc == ETIMEDOUT || (deadline && (left = deadline - mstime()) <= 0)) {
+            return ZOPERATIONTIMEOUT;
+        }
+        pthread_mutex_lock(&w->lock);
+        __atomic_add_fetch(&w->waiters, 1, __ATOMIC_SEQ_CST);
+        // window_release checks for waiters after it decrements, so the
+        // check has to be repeated once we are registered.
+        if (!fits(w, __atomic_load_n(&w->inflight, __ATOMIC_SEQ_CST), n)) {
+            if (deadline) {
+                abstime_after(&ts, left);
+                rc = pthread_cond_timedwait(&w->cond, &w->lock, &ts);
+            } else {
+                pthread_cond_wait(&w->cond, &w->lock);
+            }
+        }
+        __atomic_sub_fetch(&w->waiters, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&w->lock);
+    }
+}
+
+void window_release(struct zk_window *w, int n) {
+    __atomic_sub_fetch(&w->inflight, n, __ATOMIC_SEQ_CST);
+    wake_waiters(w);
+}
+
+// window_observe feeds the latency of a reply to the controller, it is
+// only called by the I/O thread.
+void window_observe(struct zk_window *w, int64_t latency, int64_t now) {
+    int limit, gen, min, max;
+    int64_t target = __atomic_load_n(&w->target, __ATOMIC_SEQ_CST);
+
+    if (target <= 0) return;
+    gen = __atomic_load_n(&w->gen, __ATOMIC_SEQ_CST);
+    min = __atomic_load_n(&w->min, __ATOMIC_SEQ_CST);
+    max = __atomic_load_n(&w->max, __ATOMIC_SEQ_CST);
+    if (gen != w->seen_gen) {
+        w->seen_gen = gen;
+        w->size = min;
+        w->last_cut = 0;
+    }
+    if (latency > target) {
+        if (now - w->last_cut < latency) return;
+        w->size /= 2;
+        if (w->size < min) w->size = min;
+        w->last_cut = now;
+    } else {
+        w->size += 1.0 / w->size;
+        if (w->size > max) w->size = max;
+    }
+    limit = (int)w->size;
+    if (limit != __atomic_load_n(&w->limit, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&w->limit, limit, __ATOMIC_SEQ_CST);
+        wake_waiters(w);
+    }
+}
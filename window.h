@@ -0,0 +1,38 @@
+#ifndef __WINDOW_H_
+#define __WINDOW_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+// zk_window bounds the requests a session has in flight. A full window
+// blocks new requests, or fails them with ZK_WOULDBLOCK in nonblock mode.
+// With a latency target set, the limit follows an AIMD controller between
+// min and max: it grows by one per window of replies under the target and
+// halves, at most once per round trip, when a reply takes longer.
+struct zk_window {
+    int limit; // 0 is unlimited
+    int nonblock;
+    int inflight;
+    int waiters;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    // set by the caller's thread and read by the I/O thread, so they go
+    // through atomics; size and last_cut belong to the I/O thread, which
+    // resets them when it sees a new gen.
+    int64_t target; // us, 0 disables the controller
+    int min;
+    int max;
+    int gen;
+    int seen_gen;
+    double size;
+    int64_t last_cut;
+};
+
+void window_init(struct zk_window *w);
+void window_destroy(struct zk_window *w);
+void window_set_limit(struct zk_window *w, int limit, int nonblock);
+void window_set_adaptive(struct zk_window *w, int min, int max, int64_t target);
+int window_acquire(struct zk_window *w, int n, int64_t deadline);
+void window_release(struct zk_window *w, int n);
+void window_observe(struct zk_window *w, int64_t latency, int64_t now);
+#endif
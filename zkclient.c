@@ -11,63 +11,69 @@
 #include "request.h"
 #include "zkclient.h"
 
-static void* do_ping_loop(void *v) {
-    int now;
-    zk_client *c = v;
-
-    while(c->state != ZK_STATE_STOP) {
-        now = time(NULL);
-        // session timeout is ms, so we need to div 6 *1000
-        if(now - c->last_ping >= c->session_timeout/1000/6) {
-            // send ping
-            zk_ping(c);
-            //logger(DEBUG, "PING %s", rc == ZK_OK ? "success":"failed");
-            c->last_ping = now;
-        }
-        usleep(200000);
-    }
-    return NULL;
-}
+// on_ping_timer runs on the shared timer thread. The session only needs a
+// ping once nothing was sent for a third of the session timeout, the I/O
+// thread writes it.
+static void on_ping_timer(struct zk_timer *t, void *arg) {
+    zk_client *c = arg;
+    int64_t now, last, interval;
 
-static void start_ping_thread(zk_client *c) {
-    int rc;
-    rc = pthread_create(&c->ping_tid, NULL, do_ping_loop, c);
-    if (rc != 0) {
-        logger(ERROR, "start ping thread err, %s", strerror(errno));
-        exit(1);
+    interval = c->session_timeout / 3;
+    now = mstime();
+    last = __atomic_load_n(&c->last_send, __ATOMIC_RELAXED);
+    if (now - last >= interval) {
+        request_ping(c);
+        last = now;
     }
+    timer_add_at(t, last + interval);
 }
 
-void reset_zkclient(zk_client *c) {
-    // prevent ping thread didn't unlock when call pthread_cancel, and case deadlock
-    // so we trylock, and then unlock here
-    pthread_mutex_trylock(&c->lock);
-    pthread_mutex_unlock(&c->lock);
-    // wait for ping thread
-    if (c->ping_tid) {
-        pthread_cancel(c->ping_tid);
-    }
-    if (c->sock) {
+// disconnect closes the connection but keeps the session, so the client
+// can resume it on the next connect.
+void disconnect(zk_client *c) {
+    timer_del(&c->ping_timer);
+    if (c->sock >= 0) {
         close(c->sock);
     }
     c->sock = -1;
-    c->state = ZK_STATE_INIT;
-    c->last_ping = 0;
+    if (c->state != ZK_STATE_STOP) c->state = ZK_STATE_INIT;
+}
+
+// reset_zkclient drops the session, the I/O thread connects again in the
+// background with a new one. It fails when the I/O thread can't start,
+// requests fail then until the next reset.
+int reset_zkclient(zk_client *c) {
+    // the timer goes first, it writes to the pipe of the I/O thread
+    timer_del(&c->ping_timer);
+    stop_io_thread(c);
+    disconnect(c);
     c->session_id = 0;
-    c->last_zxid = 0;
+    // last_zxid is kept, the new session mustn't see older state either
+    c->srtt = c->rttvar = 0;
     c->passwd.len = 16;
     if (c->passwd.buff) {
         free(c->passwd.buff);
     }
     c->passwd.buff = malloc(c->passwd.len);
     memset(c->passwd.buff, 0, c->passwd.len);
+    if (start_io_thread(c) != ZK_OK) {
+        logger(WARN, "start io thread err, %s", strerror(errno));
+        return ZK_ERROR;
+    }
+    return ZK_OK;
 }
 
+// do_connect tries every server once. It resumes the session when there is
+// one, and starts a new one when the server says it has expired.
 int do_connect(zk_client *c) {
-    int i, start, retries, sock, port;
+    int i, rc, start, retries, sock, port, expired = 0;
     char host[512], *pos;
 
     start = rand() % c->nservers;
+    // a hedge session stays off the server of its client when it can
+    if (c->avoid && c->avoid->server >= 0 && c->nservers > 1) {
+        start = c->avoid->server + 1 + rand() % (c->nservers - 1);
+    }
     retries = c->nservers;
     while(--retries >= 0){
         i = start++ % c->nservers; 
@@ -85,11 +91,27 @@ int do_connect(zk_client *c) {
 
         c->sock = sock;
         c->state = ZK_STATE_CONNECTED;
-        if (authenticate(c) == ZK_OK) {
-            start_ping_thread(c);
+        if ((rc = authenticate(c)) == ZK_OK) {
             c->state = ZK_STATE_AUTHED;
+            c->server = i;
+            c->last_send = mstime();
+            if (timer_add(&c->ping_timer, c->session_timeout / 3) != ZK_OK) {
+                logger(WARN, "start ping timer err");
+            }
             return ZK_OK;
         }
+        close(sock);
+        c->sock = -1;
+        c->state = ZK_STATE_INIT;
+        if (rc == ZSESSIONEXPIRED && !expired) {
+            logger(WARN, "Session 0x%llx expired, start a new one.", (long long)c->session_id);
+            expired = 1;
+            c->session_id = 0;
+            memset(c->passwd.buff, 0, c->passwd.len);
+            // try the same server again
+            start--;
+            retries++;
+        }
     }
     return ZK_ERROR;
 }
@@ -109,7 +131,126 @@ void set_socket_timeout(zk_client *c, int timeout) {
     c->write_timeout = timeout;
 }
 
-zk_client *new_client(const char *zk_list, int session_timeout, int timeout) {
+// set_write_delay makes the I/O thread hold a burst for usec microseconds
+// while earlier requests are still in flight, so more requests share one
+// write. The I/O thread keeps reading replies meanwhile. 0, the default,
+// writes right away.
+void set_write_delay(zk_client *c, int usec) {
+    if (!c || usec < 0) {
+        return;
+    }
+    c->write_delay = usec;
+}
+
+// set_request_timeout gives every request a deadline timeout ms after it
+// is issued, a request that misses it fails with ZOPERATIONTIMEOUT and its
+// reply is dropped when it arrives. 0, the default, is no deadline.
+void set_request_timeout(zk_client *c, int timeout) {
+    if (!c || timeout < 0) {
+        return;
+    }
+    c->request_timeout = timeout;
+}
+
+// set_max_inflight bounds the requests in flight on the session, a request
+// beyond max waits for a reply, or fails with ZK_WOULDBLOCK in nonblock
+// mode. 0, the default, is unlimited.
+void set_max_inflight(zk_client *c, int max, int nonblock) {
+    if (!c || max < 0) {
+        return;
+    }
+    window_set_limit(&c->window, max, nonblock);
+}
+
+// set_adaptive_inflight lets the bound float between min and max: it grows
+// while replies take less than target_us and halves when they don't.
+void set_adaptive_inflight(zk_client *c, int min, int max, int target_us) {
+    if (!c || min <= 0 || max < min || target_us <= 0) {
+        return;
+    }
+    window_set_adaptive(&c->window, min, max, target_us);
+}
+
+// set_reconnect_backoff sets the delay before a reconnect attempt to grow
+// from min to max ms, doubling with every failed attempt.
+void set_reconnect_backoff(zk_client *c, int min, int max) {
+    if (!c || min <= 0 || max < min) {
+        return;
+    }
+    c->reconnect_min = min;
+    c->reconnect_max = max;
+}
+
+// set_max_queued bounds the requests that wait for a reconnect, later ones
+// fail with ZK_SOCKET_ERR right away.
+void set_max_queued(zk_client *c, int max) {
+    if (!c || max < 0) {
+        return;
+    }
+    c->max_queued = max;
+}
+
+// set_bulk_depth bounds the bulk requests in flight on the session, the
+// rest wait in the client until one of them is answered. Interactive
+// requests queue behind at most depth bulk replies.
+void set_bulk_depth(zk_client *c, int depth) {
+    if (!c || depth <= 0) {
+        return;
+    }
+    c->bulk_depth = depth;
+}
+
+// set_bulk_session sends the bulk requests through another client, so they
+// never share a connection with interactive ones. NULL undoes it, the
+// caller still owns bulk and destroys it after c.
+void set_bulk_session(zk_client *c, zk_client *bulk) {
+    if (!c || bulk == c) {
+        return;
+    }
+    c->bulk = bulk;
+}
+
+// set_coalesce_reads turns the sharing of identical reads on or off. On,
+// the default, a get, exists or children read issued while the same read
+// is in flight waits for that one's reply instead of sending its own.
+void set_coalesce_reads(zk_client *c, int on) {
+    if (!c) {
+        return;
+    }
+    c->coalesce_reads = on ? 1 : 0;
+}
+
+// set_exists_cache makes zk_exists remember up to max paths it found
+// missing, with a watch on each, and answer for them locally until the
+// node is created. 0, the default, turns it off.
+void set_exists_cache(zk_client *c, int max) {
+    if (!c || max < 0) {
+        return;
+    }
+    c->neg_max = max;
+    if (max == 0) exists_cache_clear(c);
+}
+
+// set_read_cache bounds the replies kept for the cached read modes of
+// zk_get_opts and zk_get_children_opts, 1024 by default. Once full, new
+// paths are read strictly. 0 turns the cache off.
+void set_read_cache(zk_client *c, int max) {
+    if (!c || max < 0) {
+        return;
+    }
+    c->cache_max = max;
+    if (max == 0) read_cache_clear(c);
+}
+
+// get_rtt returns the smoothed round trip time to the server and its mean
+// deviation in microseconds, both are 0 until the first ping is answered.
+void get_rtt(zk_client *c, int64_t *srtt, int64_t *rttvar) {
+    *srtt = __atomic_load_n(&c->srtt, __ATOMIC_RELAXED);
+    *rttvar = __atomic_load_n(&c->rttvar, __ATOMIC_RELAXED);
+}
+
+static zk_client *create_client(const char *zk_list, int session_timeout, int timeout,
+        zk_client *avoid) {
     int connect_timeout;
     if (!zk_list) return NULL;
 
@@ -122,6 +263,7 @@ zk_client *new_client(const char *zk_list, int session_timeout, int timeout) {
     if(c->nservers == 0 || !c->servers) {
         return NULL;
     }
+    c->server = -1;
     c->state = ZK_STATE_INIT;
     c->session_id = 0;
     c->last_zxid = 0;
@@ -134,37 +276,149 @@ zk_client *new_client(const char *zk_list, int session_timeout, int timeout) {
     c->connect_timeout = connect_timeout;
     c->read_timeout = connect_timeout;
     c->write_timeout = connect_timeout;
+    c->write_delay = 0;
+    c->request_timeout = 0;
     c->sock = -1; 
     c->passwd.len = 16;
     c->passwd.buff = malloc(c->passwd.len);
     memset(c->passwd.buff, 0, c->passwd.len);
-    c->last_ping = time(NULL);
-    pthread_mutex_init(&c->lock, NULL);
+    c->last_send = 0;
+    c->ping_due = 0;
+    c->srtt = c->rttvar = 0;
+    timer_init(&c->ping_timer, on_ping_timer, c);
+    c->reconnect_min = 100;
+    c->reconnect_max = 10000;
+    c->reconnect_due = 0;
+    c->max_queued = 1024;
+    c->bulk_depth = 4;
+    c->bulk = NULL;
+    hedge_init(&c->hedge);
+    c->hedge_session = NULL;
+    c->hedge_swapped = 0;
+    c->coalesce_reads = 1;
+    c->write_seq = 0;
+    pthread_mutex_init(&c->flight_lock, NULL);
+    pthread_cond_init(&c->flight_cond, NULL);
+    memset(c->flights, 0, sizeof(c->flights));
+    c->neg_max = 0;
+    c->neg_count = 0;
+    c->neg_epoch = 0;
+    pthread_mutex_init(&c->neg_lock, NULL);
+    memset(c->neg, 0, sizeof(c->neg));
+    c->cache_max = 1024;
+    c->cache_count = 0;
+    c->cache_epoch = 0;
+    pthread_mutex_init(&c->cache_lock, NULL);
+    memset(c->cache, 0, sizeof(c->cache));
+    pthread_mutex_init(&c->watch_lock, NULL);
+    c->watchers = NULL;
+    c->avoid = avoid;
+    c->io_pipe[0] = c->io_pipe[1] = -1;
+    c->submitted = IO_CLOSED;
+    window_init(&c->window);
 
     if (do_connect(c) != ZK_OK) {
-        logger(ERROR, "Connect to zookeeper[%s] failed.", zk_list);
-        exit(1);
+        // requests wait for the I/O thread to reconnect
+        logger(WARN, "Connect to zookeeper[%s] failed, retry in the background.", zk_list);
+    }
+    if (start_io_thread(c) != ZK_OK) {
+        logger(WARN, "start io thread err, %s", strerror(errno));
+        disconnect(c);
+        sdsfreesplitres(c->servers, c->nservers);
+        free(c->passwd.buff);
+        window_destroy(&c->window);
+        hedge_destroy(&c->hedge);
+        pthread_mutex_destroy(&c->flight_lock);
+        pthread_cond_destroy(&c->flight_cond);
+        pthread_mutex_destroy(&c->neg_lock);
+        pthread_mutex_destroy(&c->cache_lock);
+        pthread_mutex_destroy(&c->watch_lock);
+        free(c);
+        return NULL;
     }
-
     return c;
 }
 
+zk_client *new_client(const char *zk_list, int session_timeout, int timeout) {
+    return create_client(zk_list, session_timeout, timeout, NULL);
+}
+
+// set_hedged_reads sends a get, exists or children read again on a second
+// session, connected to another server when there is one, if no reply came
+// within the percentile of the recent read latencies. The first answer
+// wins. At most max_pct of 100 reads are hedged, 0 percentile stops it.
+int set_hedged_reads(zk_client *c, int percentile, int max_pct) {
+    int i;
+    char *list, *pos;
+    size_t len = 0;
+
+    if (!c || percentile < 0 || percentile >= 100 || max_pct < 0 || max_pct > 100) {
+        return ZK_ERROR;
+    }
+    if (percentile > 0 && !c->hedge_session) {
+        for (i = 0; i < c->nservers; i++) len += strlen(c->servers[i]) + 1;
+        if (!(list = malloc(len))) return ZK_ERROR;
+        for (pos = list, i = 0; i < c->nservers; i++) {
+            pos += sprintf(pos, i > 0 ? ",%s" : "%s", c->servers[i]);
+        }
+        c->hedge_session = create_client(list, c->session_timeout / 1000, -1, c);
+        free(list);
+        if (!c->hedge_session) return ZK_ERROR;
+        c->hedge_session->connect_timeout = c->connect_timeout;
+        c->hedge_session->read_timeout = c->read_timeout;
+        c->hedge_session->write_timeout = c->write_timeout;
+    }
+    hedge_configure(&c->hedge, percentile, max_pct);
+    return ZK_OK;
+}
+
 void destroy_client(zk_client *c) {
+    int authed = c->state == ZK_STATE_AUTHED;
+    struct zk_watcher *w;
+
     c->state = ZK_STATE_STOP;
-    pthread_join(c->ping_tid, NULL);
-    zk_close(c);
+    timer_del(&c->ping_timer);
+    if (authed) zk_close(c);
+    stop_io_thread(c);
+    if (c->hedge_session) destroy_client(c->hedge_session);
     sdsfreesplitres(c->servers, c->nservers);
     if (c->sock > 0) close(c->sock);
     if (c->passwd.buff) free(c->passwd.buff);
+    window_destroy(&c->window);
+    hedge_destroy(&c->hedge);
+    pthread_mutex_destroy(&c->flight_lock);
+    pthread_cond_destroy(&c->flight_cond);
+    exists_cache_clear(c);
+    pthread_mutex_destroy(&c->neg_lock);
+    read_cache_clear(c);
+    pthread_mutex_destroy(&c->cache_lock);
+    while ((w = c->watchers)) {
+        c->watchers = w->next;
+        free(w);
+    }
+    pthread_mutex_destroy(&c->watch_lock);
     free(c);
 }
 
+// the error of the last request is kept per thread like errno, threads
+// sharing a client don't see each other's errors
+static __thread int32_t last_err;
+
+int zk_last_error(zk_client *c) {
+    return last_err;
+}
+
+void set_last_error(int err) {
+    last_err = err;
+}
+
 const char *zk_error(zk_client *c) {
-    switch(c->last_err) {
+    switch(zk_last_error(c)) {
         case 0: return "null";
         case ZK_SOCKET_ERR: return "Zkclient socket error";
         case ZK_ERROR: return "Inner error";
         case ZK_TIMEOUT: return "Connection timeout";
+        case ZK_WOULDBLOCK: return "Too many requests in flight";
         case ZSYSTEMERROR: return "System error";
         case ZRUNTIMEINCONSISTENCY: return "A runtime inconsistency was found";
         case ZDATAINCONSISTENCY: return "A data inconsistency was found";
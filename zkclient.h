@@ -3,17 +3,25 @@
 
 #include "zookeeper.jute.h"
 #include <pthread.h>
+#include "window.h"
+#include "timer.h"
+#include "hedge.h"
 
 #define ZK_OK 0
 #define ZK_ERROR -10000
 #define ZK_TIMEOUT -10001
 #define ZK_SOCKET_ERR -10002
+#define ZK_WOULDBLOCK -10003
 
 #define ZK_STATE_INIT 0
 #define ZK_STATE_CONNECTED 1
 #define ZK_STATE_AUTHED 2
 #define ZK_STATE_STOP 3
 
+#define FLIGHT_SLOTS 64
+#define NEG_SLOTS 256
+#define CACHE_SLOTS 256
+
 enum ZK_ERRORS {
   ZOK = 0, /*!< Everything is OK */
 
@@ -47,30 +55,99 @@ enum ZK_ERRORS {
   ZSESSIONMOVED = -118 /*!<session moved to another server, so operation is ignored */
 };
 
+struct zk_call;
+struct _zk_client;
+struct read_flight;
+struct neg_entry;
+struct cache_entry;
+
+typedef void (*zk_watch_fn)(struct _zk_client *c, int type, const char *path, void *arg);
+
+// zk_watcher gets the watch notifications of the session on the I/O
+// thread, path is NULL once the connection and so the watches are lost.
+struct zk_watcher {
+    struct zk_watcher *next;
+    zk_watch_fn fn;
+    void *arg;
+};
+
 struct _zk_client {
     int sock;
     int nservers;
     char **servers;
-    int last_zxid;
-    int session_id;
+    int server; // index of the connected server, -1 before the first connect
+    int64_t last_zxid;
+    int64_t session_id;
     int session_timeout;
     int connect_timeout;
     int read_timeout;
     int write_timeout;
+    int write_delay;
+    int request_timeout;
     int state;
-    int32_t last_err;
     struct buffer passwd;
-    int last_ping;
-    pthread_t ping_tid;
-    pthread_mutex_t lock;
+    int64_t last_send; // ms
+    int ping_due;
+    int64_t srtt; // us, 0 until the first ping reply
+    int64_t rttvar;
+    struct zk_timer ping_timer;
+    int reconnect_min; // ms
+    int reconnect_max;
+    int reconnect_due;
+    int max_queued;
+    struct zk_timer reconnect_timer;
+    int bulk_depth;
+    struct _zk_client *bulk;
+    struct zk_hedge hedge;
+    struct _zk_client *hedge_session; // owned by the client
+    int hedge_swapped; // reads go to hedge_session first
+    int coalesce_reads;
+    uint64_t write_seq; // writes issued so far, under flight_lock
+    pthread_mutex_t flight_lock;
+    pthread_cond_t flight_cond;
+    struct read_flight *flights[FLIGHT_SLOTS];
+    int neg_max; // 0 disables the exists cache
+    int neg_count;
+    uint64_t neg_epoch; // bumped by every watch event and clear
+    pthread_mutex_t neg_lock;
+    struct neg_entry *neg[NEG_SLOTS];
+    int cache_max; // 0 makes every read strict
+    int cache_count;
+    uint64_t cache_epoch; // bumped by every watch event on a cached read
+    pthread_mutex_t cache_lock;
+    struct cache_entry *cache[CACHE_SLOTS];
+    pthread_mutex_t watch_lock;
+    struct zk_watcher *watchers;
+    struct _zk_client *avoid; // connect to another server than this client
+    pthread_t io_tid;
+    int io_pipe[2];
+    int io_stop;
+    struct zk_call *submitted;
+    struct zk_window window;
 };
 
 typedef struct _zk_client zk_client;
 zk_client *new_client(const char *zk_list, int session_timeout, int timeout); 
 int do_connect(zk_client *c); 
+void disconnect(zk_client *c);
 void set_connect_timeout(zk_client *c, int timeout); 
 void set_socket_timeout(zk_client *c, int timeout); 
+void set_write_delay(zk_client *c, int usec);
+void set_request_timeout(zk_client *c, int timeout);
+void set_max_inflight(zk_client *c, int max, int nonblock);
+void set_adaptive_inflight(zk_client *c, int min, int max, int target_us);
+void set_reconnect_backoff(zk_client *c, int min, int max);
+void set_max_queued(zk_client *c, int max);
+void set_bulk_depth(zk_client *c, int depth);
+void set_bulk_session(zk_client *c, zk_client *bulk);
+int set_hedged_reads(zk_client *c, int percentile, int max_pct);
+void set_coalesce_reads(zk_client *c, int on);
+void set_exists_cache(zk_client *c, int max);
+void set_read_cache(zk_client *c, int max);
+void get_rtt(zk_client *c, int64_t *srtt, int64_t *rttvar);
 void destroy_client(zk_client *c); 
-void reset_zkclient(zk_client *c); 
+int reset_zkclient(zk_client *c); 
 const char *zk_error(zk_client *c);
+int zk_last_error(zk_client *c);
+void set_last_error(int err);
 #endif
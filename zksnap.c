@@ -0,0 +1,398 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "exportfile.h"
+#include "datatree.h"
+#include "snapshot.h"
+#include "txnlog.h"
+#include "request.h"
+#include "zkclient.h"
+
+static int show_data;
+static int summary_only;
+
+static void print_node(struct snap_node *node) {
+    // the root is stored with an empty path
+    printf("%.*s\tczxid=0x%llx\tmzxid=0x%llx\tpzxid=0x%llx\tversion=%d\tcversion=%d"
+            "\taversion=%d\tacl=%lld\tephemeralOwner=0x%llx\tdataLength=%d",
+            node->path_len > 0 ? node->path_len : 1, node->path_len > 0 ? node->path : "/",
+            (long long)node->stat.czxid, (long long)node->stat.mzxid,
+            (long long)node->stat.pzxid, node->stat.version, node->stat.cversion,
+            node->stat.aversion, (long long)node->acl,
+            (long long)node->stat.ephemeralOwner, node->data_len < 0 ? 0 : node->data_len);
+    if (show_data && node->data_len > 0) {
+        printf("\tdata=%.*s", node->data_len, node->data);
+    }
+    printf("\n");
+}
+
+static int dump_snapshot(const char *filename, int verify) {
+    int rc;
+    int64_t data_bytes = 0, ephemerals = 0;
+    const char *pos;
+    struct snapshot *s;
+    struct snap_node node;
+    struct snap_acl acl;
+    struct snap_session session;
+
+    if (!(s = snapshot_open(filename))) {
+        fprintf(stderr, "open snapshot %s failed.\n", filename);
+        return ZK_ERROR;
+    }
+    printf("# snapshot %s version=%d dbid=%lld zxid=0x%llx sessions=%d acls=%d\n",
+            filename, s->header.version, (long long)s->header.dbid,
+            (long long)snapshot_zxid(filename), s->nsessions, s->nacls);
+    if (!summary_only) {
+        pos = NULL;
+        while (snapshot_next_session(s, &pos, &session) == 1) {
+            printf("# session 0x%llx timeout=%d\n", (long long)session.id, session.timeout);
+        }
+        pos = NULL;
+        while (snapshot_next_acl(s, &pos, &acl) == 1) {
+            printf("# acl %lld entries=%d\n", (long long)acl.id, acl.count);
+        }
+    }
+    while ((rc = snapshot_next_node(s, &node)) == 1) {
+        if (node.data_len > 0) data_bytes += node.data_len;
+        if (node.stat.ephemeralOwner) ephemerals++;
+        if (!summary_only) print_node(&node);
+    }
+    if (rc != 0) {
+        fprintf(stderr, "snapshot %s is corrupt after %lld nodes.\n",
+                filename, (long long)s->nnodes);
+        snapshot_close(s);
+        return ZK_ERROR;
+    }
+    printf("# nodes=%lld ephemerals=%lld data_bytes=%lld\n",
+            (long long)s->nnodes, (long long)ephemerals, (long long)data_bytes);
+    if (verify) {
+        rc = snapshot_verify(s);
+        printf("# checksum %s\n", rc == ZK_OK ? "ok" : "mismatch");
+    }
+    snapshot_close(s);
+    return rc;
+}
+
+// path_count tallies the writes per path while summarizing a log
+struct path_count {
+    char *path;
+    int64_t count;
+    int64_t bytes;
+    struct path_count *next;
+};
+
+#define PATH_BUCKETS 65536
+#define TOP_PATHS 20
+
+static struct path_count **path_counts;
+static int64_t npaths;
+static int64_t type_counts[256];
+
+static void count_path(const char *path, int32_t bytes) {
+    uint32_t h = 5381;
+    const char *p;
+    struct path_count *pc;
+
+    for (p = path; *p; p++) h = h * 33 + (uint8_t)*p;
+    h %= PATH_BUCKETS;
+    for (pc = path_counts[h]; pc; pc = pc->next) {
+        if (!strcmp(pc->path, path)) break;
+    }
+    if (!pc) {
+        pc = calloc(1, sizeof(*pc));
+        pc->path = strdup(path);
+        pc->next = path_counts[h];
+        path_counts[h] = pc;
+        npaths++;
+    }
+    pc->count++;
+    pc->bytes += bytes > 0 ? bytes : 0;
+}
+
+static int compare_path_count(const void *a, const void *b) {
+    int64_t ca = (*(struct path_count **)a)->count, cb = (*(struct path_count **)b)->count;
+    return ca < cb ? 1 : (ca > cb ? -1 : 0);
+}
+
+static void print_log_summary(void) {
+    int i, n = 0;
+    struct path_count **all, *pc;
+
+    for (i = 0; i < 256; i++) {
+        if (type_counts[i]) printf("# %s=%lld\n", txn_type_name((int8_t)i), (long long)type_counts[i]);
+    }
+    all = malloc(sizeof(*all) * (npaths + 1));
+    for (i = 0; i < PATH_BUCKETS; i++) {
+        for (pc = path_counts[i]; pc; pc = pc->next) all[n++] = pc;
+    }
+    qsort(all, n, sizeof(*all), compare_path_count);
+    printf("# top written paths:\n");
+    for (i = 0; i < n && i < TOP_PATHS; i++) {
+        printf("%lld\t%lld\t%s\n", (long long)all[i]->count, (long long)all[i]->bytes, all[i]->path);
+    }
+    free(all);
+}
+
+static int is_create(int32_t type) {
+    return type == CREATE_OPCODE || type == CREATE2_TXN ||
+        type == CREATE_CONTAINER_TXN || type == CREATE_TTL_TXN;
+}
+
+static void print_txn(struct txn_entry *entry, int32_t type, char *buf, int32_t len, int depth) {
+    int i;
+    const char *path;
+    struct txn_body body;
+    struct Txn *sub;
+
+    if (txn_decode(type, buf, len, &body) != ZK_OK) {
+        fprintf(stderr, "decode txn 0x%llx failed.\n", (long long)entry->header.zxid);
+        return;
+    }
+    path = txn_path(&body);
+    if (summary_only) {
+        type_counts[(uint8_t)type]++;
+        if (path) {
+            count_path(path, type == SETDATA_OPCODE ? body.u.set_data.data.len :
+                    (is_create(type) ? body.u.create.data.len : 0));
+        }
+    } else {
+        printf("%*szxid=0x%llx\ttime=%lld\tsession=0x%llx\tcxid=%d\ttype=%s",
+                depth * 2, "", (long long)entry->header.zxid, (long long)entry->header.time,
+                (long long)entry->header.clientId, entry->header.cxid, txn_type_name(type));
+        if (path) printf("\tpath=%s", path);
+        if (type == SETDATA_OPCODE) {
+            printf("\tversion=%d\tdataLength=%d", body.u.set_data.version, body.u.set_data.data.len);
+        } else if (type == ERROR_TXN) {
+            printf("\terr=%d", body.u.error.err);
+        } else if (type == CREATE_SESSION_TXN) {
+            printf("\ttimeout=%d", body.u.create_session.timeOut);
+        } else if (is_create(type)) {
+            printf("\tephemeral=%d\tdataLength=%d", body.u.create.ephemeral, body.u.create.data.len);
+        }
+        if (show_data && type == SETDATA_OPCODE && body.u.set_data.data.len > 0) {
+            printf("\tdata=%.*s", body.u.set_data.data.len, body.u.set_data.data.buff);
+        }
+        printf("\n");
+    }
+    if (type == MULTI_OPCODE) {
+        for (i = 0; i < body.u.multi.txns.count; i++) {
+            sub = &body.u.multi.txns.data[i];
+            print_txn(entry, sub->type, sub->data.buff, sub->data.len, depth + 1);
+        }
+    }
+    deallocate_txn_body(&body);
+}
+
+// dump_log prints every txn of a log. In follow mode it keeps polling for
+// appended entries and moves on to the next log once the server rolled over.
+static int dump_log(const char *filename, int follow) {
+    int rc;
+    char *next;
+    struct txnlog *log;
+    struct txn_entry entry;
+
+    if (!(log = txnlog_open(filename))) {
+        fprintf(stderr, "open txn log %s failed.\n", filename);
+        return ZK_ERROR;
+    }
+    if (summary_only) path_counts = calloc(PATH_BUCKETS, sizeof(*path_counts));
+    printf("# txn log %s version=%d dbid=%lld\n", filename, log->header.version,
+            (long long)log->header.dbid);
+    while (1) {
+        if ((rc = txnlog_next(log, &entry)) == 1) {
+            print_txn(&entry, entry.header.type, entry.body, entry.body_len, 0);
+            continue;
+        }
+        if (!follow) break;
+        fflush(stdout);
+        // once a newer log exists nothing is appended to this one anymore,
+        // check once more for entries written before the roll over.
+        if ((next = txnlog_next_file(log->filename))) {
+            if ((rc = txnlog_next(log, &entry)) == 1) {
+                print_txn(&entry, entry.header.type, entry.body, entry.body_len, 0);
+                free(next);
+                continue;
+            }
+            if (rc != 0) {
+                free(next);
+                break;
+            }
+            txnlog_close(log);
+            log = txnlog_open(next);
+            printf("# txn log %s\n", next);
+            free(next);
+            if (!log) {
+                fprintf(stderr, "open next txn log failed.\n");
+                return ZK_ERROR;
+            }
+            continue;
+        }
+        // a bad entry at the tail may only be partly flushed, the log is
+        // preallocated with zeros, so it is read again from its start.
+        usleep(200000);
+    }
+    if (rc != 0) {
+        fprintf(stderr, "txn log %s is corrupt at offset %ld.\n", log->filename, log->offset);
+    }
+    if (summary_only) print_log_summary();
+    txnlog_close(log);
+    return rc == 0 ? ZK_OK : ZK_ERROR;
+}
+
+static void print_dt_node(struct datatree *t, struct dt_node *n) {
+    struct snap_node node;
+
+    node.path = n->path;
+    node.path_len = n->path_len;
+    node.data = n->data;
+    node.data_len = n->data_len;
+    node.acl = n->acl;
+    datatree_stat_persisted(t, n, &node.stat);
+    print_node(&node);
+}
+
+// export_tree writes n and its subtree in pre-order, the record paths are
+// relative to the exported root like the ones zk_export writes.
+static int export_tree(struct datatree *t, FILE *fp, struct dt_node *n, int32_t root_len) {
+    int rc;
+    char *path;
+    struct dt_node *child;
+    struct export_record rec;
+
+    if (!(path = malloc(n->path_len - root_len + 1))) return ZK_ERROR;
+    memcpy(path, n->path + root_len, n->path_len - root_len);
+    path[n->path_len - root_len] = '\0';
+    rec.path = path;
+    rec.data.buff = (char *)n->data;
+    rec.data.len = n->data_len;
+    datatree_stat(t, n, &rec.stat);
+    rec.flags = rec.stat.ephemeralOwner ? ZOO_EPHEMERAL : 0;
+    rc = export_write_record(fp, &rec);
+    free(path);
+    for (child = datatree_child(t, n); child && rc == ZK_OK; child = datatree_sibling(t, child)) {
+        rc = export_tree(t, fp, child, root_len);
+    }
+    return rc;
+}
+
+static int export_subtree(struct datatree *t, struct dt_node *n, const char *filename) {
+    int rc;
+    FILE *fp;
+
+    if (!(fp = fopen(filename, "wb"))) return ZK_ERROR;
+    rc = export_write_header(fp);
+    if (rc == ZK_OK) rc = export_tree(t, fp, n, n->path_len);
+    if (rc == ZK_OK) rc = export_write_trailer(fp);
+    if (fclose(fp) != 0 && rc == ZK_OK) rc = ZK_ERROR;
+    return rc;
+}
+
+// query_tree answers get/ls/stat/export commands about the rebuilt tree,
+// one command per line on stdin.
+static void query_tree(struct datatree *t) {
+    int narg;
+    char line[4096], **args;
+    struct dt_node *n, *child;
+
+    while (fgets(line, sizeof(line), stdin)) {
+        args = sdssplitlen(line, strcspn(line, "\r\n"), " ", 1, &narg);
+        if (!args || narg == 0 || !args[0][0]) {
+            sdsfreesplitres(args, narg);
+            continue;
+        }
+        if (!strcmp(args[0], "quit")) {
+            sdsfreesplitres(args, narg);
+            break;
+        }
+        if (narg < 2 || !(n = datatree_lookup(t, args[1], strlen(args[1])))) {
+            printf(narg < 2 ? "%s needs a path.\n" : "%s %s failed, node not exists.\n",
+                    args[0], narg < 2 ? "" : args[1]);
+        } else if (!strcmp(args[0], "get")) {
+            if (n->data_len > 0) printf("%.*s", n->data_len, n->data);
+            printf("\n");
+        } else if (!strcmp(args[0], "ls")) {
+            for (child = datatree_child(t, n); child; child = datatree_sibling(t, child)) {
+                printf("%.*s\t", child->path_len - n->path_len - 1, child->path + n->path_len + 1);
+            }
+            if (n->num_children > 0) printf("\n");
+        } else if (!strcmp(args[0], "stat")) {
+            print_dt_node(t, n);
+        } else if (!strcmp(args[0], "export") && narg >= 3) {
+            if (export_subtree(t, n, args[2]) != ZK_OK) printf("export %s failed.\n", args[1]);
+        } else {
+            printf("unknown command %s, use get, ls, stat, export or quit.\n", args[0]);
+        }
+        fflush(stdout);
+        sdsfreesplitres(args, narg);
+    }
+}
+
+static int replay(const char *snapshot, char **logs, int nlogs, int64_t zxid) {
+    int rc;
+    struct datatree *t;
+
+    if (!(t = datatree_new())) return ZK_ERROR;
+    TIME_START();
+    rc = datatree_replay(t, snapshot, logs, nlogs, zxid);
+    TIME_END();
+    if (rc != ZK_OK) {
+        fprintf(stderr, "rebuild tree from %s failed.\n", snapshot);
+        datatree_free(t);
+        return ZK_ERROR;
+    }
+    printf("# tree at zxid=0x%llx nodes=%u snapshot_zxid=0x%llx txns=%lld cost=%ldms stats=%s\n",
+            (long long)t->zxid, t->live, (long long)t->snap_zxid,
+            (long long)t->applied, (long)TIME_COST(), stat_decoder_name());
+    if (zxid >= 0 && t->zxid < zxid) {
+        printf("# the logs end at zxid 0x%llx before the requested zxid.\n", (long long)t->zxid);
+    }
+    fflush(stdout);
+    query_tree(t);
+    datatree_free(t);
+    return ZK_OK;
+}
+
+static void usage(const char *prog_name) {
+    fprintf(stderr, "Usage: %s [-d] [-s] [-c] snapshot\n", prog_name);
+    fprintf(stderr, "       %s -l [-f] [-d] [-s] log\n", prog_name);
+    fprintf(stderr, "       %s -r [-z zxid] [-d] snapshot [log ...]\n", prog_name);
+    fprintf(stderr, "\t-d print node data.\n");
+    fprintf(stderr, "\t-s print the summary only, for a log the txn count per type and the most written paths.\n");
+    fprintf(stderr, "\t-c verify the snapshot checksum.\n");
+    fprintf(stderr, "\t-l read a transaction log instead of a snapshot.\n");
+    fprintf(stderr, "\t-f follow the log as the server appends to it.\n");
+    fprintf(stderr, "\t-r rebuild the tree from the snapshot and logs, then read get/ls/stat/export commands from stdin.\n");
+    fprintf(stderr, "\t-z replay the logs up to this zxid only, defaults to the end of the logs.\n");
+    fprintf(stderr, "\t-h help\n");
+    exit(0);
+}
+
+int main(int argc, char **argv) {
+    int ch, verify = 0, log = 0, follow = 0, rebuild = 0;
+    int64_t zxid = -1;
+
+    while((ch = getopt(argc, argv, "dsclfrz:h")) != -1) {
+        switch(ch) {
+            case 'r': rebuild = 1; break;
+            case 'z': zxid = strtoll(optarg, NULL, 0); break;
+            case 'l': log = 1; break;
+            case 'f': follow = 1; break;
+            case 'd': show_data = 1; break;
+            case 's': summary_only = 1; break;
+            case 'c': verify = 1; break;
+            case 'h':
+            default: usage(argv[0]);
+        }
+    }
+    if (optind >= argc) usage(argv[0]);
+    if (rebuild) {
+        return replay(argv[optind], argv + optind + 1, argc - optind - 1, zxid) == ZK_OK ? 0 : 1;
+    }
+    if (log) {
+        return dump_log(argv[optind], follow) == ZK_OK ? 0 : 1;
+    }
+    return dump_snapshot(argv[optind], verify) == ZK_OK ? 0 : 1;
+}
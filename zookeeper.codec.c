@@ -0,0 +1,2044 @@
+/* generated by gen_codec.py from zookeeper.jute.c, do not edit. */
+
+#include "codec.h"
+#include "zookeeper.codec.h"
+
+int32_t serialized_size_Id(struct Id *v) {
+    return 8 + (v->scheme ? strlen(v->scheme) : 0) + (v->id ? strlen(v->id) : 0);
+}
+
+int32_t serialized_size_ACL(struct ACL *v) {
+    return 4 + serialized_size_Id(&v->id);
+}
+
+int32_t serialized_size_Stat(struct Stat *v) {
+    return 68;
+}
+
+int32_t serialized_size_StatPersisted(struct StatPersisted *v) {
+    return 60;
+}
+
+int32_t serialized_size_StatPersistedV1(struct StatPersistedV1 *v) {
+    return 52;
+}
+
+int32_t serialized_size_ConnectRequest(struct ConnectRequest *v) {
+    return 28 + (v->passwd.len > 0 ? v->passwd.len : 0);
+}
+
+int32_t serialized_size_ConnectResponse(struct ConnectResponse *v) {
+    return 20 + (v->passwd.len > 0 ? v->passwd.len : 0);
+}
+
+int32_t serialized_size_String_vector(struct String_vector *v) {
+    int32_t i, size = 4;
+
+    for (i = 0; i < v->count; i++) {
+        size += 4 + (v->data[i] ? strlen(v->data[i]) : 0);
+    }
+    return size;
+}
+
+int32_t serialized_size_SetWatches(struct SetWatches *v) {
+    return 8 + serialized_size_String_vector(&v->dataWatches) + serialized_size_String_vector(&v->existWatches) + serialized_size_String_vector(&v->childWatches);
+}
+
+int32_t serialized_size_RequestHeader(struct RequestHeader *v) {
+    return 8;
+}
+
+int32_t serialized_size_MultiHeader(struct MultiHeader *v) {
+    return 9;
+}
+
+int32_t serialized_size_AuthPacket(struct AuthPacket *v) {
+    return 12 + (v->scheme ? strlen(v->scheme) : 0) + (v->auth.len > 0 ? v->auth.len : 0);
+}
+
+int32_t serialized_size_ReplyHeader(struct ReplyHeader *v) {
+    return 16;
+}
+
+int32_t serialized_size_GetDataRequest(struct GetDataRequest *v) {
+    return 5 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_SetDataRequest(struct SetDataRequest *v) {
+    return 12 + (v->path ? strlen(v->path) : 0) + (v->data.len > 0 ? v->data.len : 0);
+}
+
+int32_t serialized_size_SetDataResponse(struct SetDataResponse *v) {
+    return 68;
+}
+
+int32_t serialized_size_GetSASLRequest(struct GetSASLRequest *v) {
+    return 4 + (v->token.len > 0 ? v->token.len : 0);
+}
+
+int32_t serialized_size_SetSASLRequest(struct SetSASLRequest *v) {
+    return 4 + (v->token.len > 0 ? v->token.len : 0);
+}
+
+int32_t serialized_size_SetSASLResponse(struct SetSASLResponse *v) {
+    return 4 + (v->token.len > 0 ? v->token.len : 0);
+}
+
+int32_t serialized_size_ACL_vector(struct ACL_vector *v) {
+    int32_t i, size = 4;
+
+    for (i = 0; i < v->count; i++) {
+        size += serialized_size_ACL(&v->data[i]);
+    }
+    return size;
+}
+
+int32_t serialized_size_CreateRequest(struct CreateRequest *v) {
+    return 12 + (v->path ? strlen(v->path) : 0) + (v->data.len > 0 ? v->data.len : 0) + serialized_size_ACL_vector(&v->acl);
+}
+
+int32_t serialized_size_DeleteRequest(struct DeleteRequest *v) {
+    return 8 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_GetChildrenRequest(struct GetChildrenRequest *v) {
+    return 5 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_GetChildren2Request(struct GetChildren2Request *v) {
+    return 5 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_CheckVersionRequest(struct CheckVersionRequest *v) {
+    return 8 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_GetMaxChildrenRequest(struct GetMaxChildrenRequest *v) {
+    return 4 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_GetMaxChildrenResponse(struct GetMaxChildrenResponse *v) {
+    return 4;
+}
+
+int32_t serialized_size_SetMaxChildrenRequest(struct SetMaxChildrenRequest *v) {
+    return 8 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_SyncRequest(struct SyncRequest *v) {
+    return 4 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_SyncResponse(struct SyncResponse *v) {
+    return 4 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_GetACLRequest(struct GetACLRequest *v) {
+    return 4 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_SetACLRequest(struct SetACLRequest *v) {
+    return 8 + (v->path ? strlen(v->path) : 0) + serialized_size_ACL_vector(&v->acl);
+}
+
+int32_t serialized_size_SetACLResponse(struct SetACLResponse *v) {
+    return 68;
+}
+
+int32_t serialized_size_WatcherEvent(struct WatcherEvent *v) {
+    return 12 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_ErrorResponse(struct ErrorResponse *v) {
+    return 4;
+}
+
+int32_t serialized_size_CreateResponse(struct CreateResponse *v) {
+    return 4 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_ExistsRequest(struct ExistsRequest *v) {
+    return 5 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_ExistsResponse(struct ExistsResponse *v) {
+    return 68;
+}
+
+int32_t serialized_size_GetDataResponse(struct GetDataResponse *v) {
+    return 72 + (v->data.len > 0 ? v->data.len : 0);
+}
+
+int32_t serialized_size_GetChildrenResponse(struct GetChildrenResponse *v) {
+    return 0 + serialized_size_String_vector(&v->children);
+}
+
+int32_t serialized_size_GetChildren2Response(struct GetChildren2Response *v) {
+    return 68 + serialized_size_String_vector(&v->children);
+}
+
+int32_t serialized_size_GetACLResponse(struct GetACLResponse *v) {
+    return 68 + serialized_size_ACL_vector(&v->acl);
+}
+
+int32_t serialized_size_LearnerInfo(struct LearnerInfo *v) {
+    return 12;
+}
+
+int32_t serialized_size_Id_vector(struct Id_vector *v) {
+    int32_t i, size = 4;
+
+    for (i = 0; i < v->count; i++) {
+        size += serialized_size_Id(&v->data[i]);
+    }
+    return size;
+}
+
+int32_t serialized_size_QuorumPacket(struct QuorumPacket *v) {
+    return 16 + (v->data.len > 0 ? v->data.len : 0) + serialized_size_Id_vector(&v->authinfo);
+}
+
+int32_t serialized_size_FileHeader(struct FileHeader *v) {
+    return 16;
+}
+
+int32_t serialized_size_TxnHeader(struct TxnHeader *v) {
+    return 32;
+}
+
+int32_t serialized_size_CreateTxnV0(struct CreateTxnV0 *v) {
+    return 9 + (v->path ? strlen(v->path) : 0) + (v->data.len > 0 ? v->data.len : 0) + serialized_size_ACL_vector(&v->acl);
+}
+
+int32_t serialized_size_CreateTxn(struct CreateTxn *v) {
+    return 13 + (v->path ? strlen(v->path) : 0) + (v->data.len > 0 ? v->data.len : 0) + serialized_size_ACL_vector(&v->acl);
+}
+
+int32_t serialized_size_DeleteTxn(struct DeleteTxn *v) {
+    return 4 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_SetDataTxn(struct SetDataTxn *v) {
+    return 12 + (v->path ? strlen(v->path) : 0) + (v->data.len > 0 ? v->data.len : 0);
+}
+
+int32_t serialized_size_CheckVersionTxn(struct CheckVersionTxn *v) {
+    return 8 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_SetACLTxn(struct SetACLTxn *v) {
+    return 8 + (v->path ? strlen(v->path) : 0) + serialized_size_ACL_vector(&v->acl);
+}
+
+int32_t serialized_size_SetMaxChildrenTxn(struct SetMaxChildrenTxn *v) {
+    return 8 + (v->path ? strlen(v->path) : 0);
+}
+
+int32_t serialized_size_CreateSessionTxn(struct CreateSessionTxn *v) {
+    return 4;
+}
+
+int32_t serialized_size_ErrorTxn(struct ErrorTxn *v) {
+    return 4;
+}
+
+int32_t serialized_size_Txn(struct Txn *v) {
+    return 8 + (v->data.len > 0 ? v->data.len : 0);
+}
+
+int32_t serialized_size_Txn_vector(struct Txn_vector *v) {
+    int32_t i, size = 4;
+
+    for (i = 0; i < v->count; i++) {
+        size += serialized_size_Txn(&v->data[i]);
+    }
+    return size;
+}
+
+int32_t serialized_size_MultiTxn(struct MultiTxn *v) {
+    return 0 + serialized_size_Txn_vector(&v->txns);
+}
+
+static int encode_Id(struct buff_struct *b, struct Id *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->scheme))) return rc;
+    if ((rc = jwrite_string(b, v->id))) return rc;
+    return 0;
+}
+
+static int decode_Id(struct buff_struct *b, struct Id *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->scheme))) return rc;
+    if ((rc = jread_string(b, &v->id))) return rc;
+    return 0;
+}
+
+static int encode_ACL(struct buff_struct *b, struct ACL *v) {
+    int rc;
+
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->perms);
+    if ((rc = encode_Id(b, &v->id))) return rc;
+    return 0;
+}
+
+static int decode_ACL(struct buff_struct *b, struct ACL *v) {
+    int rc;
+
+    if (jneed(b, 4)) return -E2BIG;
+    v->perms = jget_int(b);
+    if ((rc = decode_Id(b, &v->id))) return rc;
+    return 0;
+}
+
+static int encode_Stat(struct buff_struct *b, struct Stat *v) {
+    if (jreserve(b, 68)) return -ENOMEM;
+    jput_long(b, v->czxid);
+    jput_long(b, v->mzxid);
+    jput_long(b, v->ctime);
+    jput_long(b, v->mtime);
+    jput_int(b, v->version);
+    jput_int(b, v->cversion);
+    jput_int(b, v->aversion);
+    jput_long(b, v->ephemeralOwner);
+    jput_int(b, v->dataLength);
+    jput_int(b, v->numChildren);
+    jput_long(b, v->pzxid);
+    return 0;
+}
+
+static int decode_Stat(struct buff_struct *b, struct Stat *v) {
+    if (jneed(b, 68)) return -E2BIG;
+    v->czxid = jget_long(b);
+    v->mzxid = jget_long(b);
+    v->ctime = jget_long(b);
+    v->mtime = jget_long(b);
+    v->version = jget_int(b);
+    v->cversion = jget_int(b);
+    v->aversion = jget_int(b);
+    v->ephemeralOwner = jget_long(b);
+    v->dataLength = jget_int(b);
+    v->numChildren = jget_int(b);
+    v->pzxid = jget_long(b);
+    return 0;
+}
+
+static int encode_StatPersisted(struct buff_struct *b, struct StatPersisted *v) {
+    if (jreserve(b, 60)) return -ENOMEM;
+    jput_long(b, v->czxid);
+    jput_long(b, v->mzxid);
+    jput_long(b, v->ctime);
+    jput_long(b, v->mtime);
+    jput_int(b, v->version);
+    jput_int(b, v->cversion);
+    jput_int(b, v->aversion);
+    jput_long(b, v->ephemeralOwner);
+    jput_long(b, v->pzxid);
+    return 0;
+}
+
+static int decode_StatPersisted(struct buff_struct *b, struct StatPersisted *v) {
+    if (jneed(b, 60)) return -E2BIG;
+    v->czxid = jget_long(b);
+    v->mzxid = jget_long(b);
+    v->ctime = jget_long(b);
+    v->mtime = jget_long(b);
+    v->version = jget_int(b);
+    v->cversion = jget_int(b);
+    v->aversion = jget_int(b);
+    v->ephemeralOwner = jget_long(b);
+    v->pzxid = jget_long(b);
+    return 0;
+}
+
+static int encode_StatPersistedV1(struct buff_struct *b, struct StatPersistedV1 *v) {
+    if (jreserve(b, 52)) return -ENOMEM;
+    jput_long(b, v->czxid);
+    jput_long(b, v->mzxid);
+    jput_long(b, v->ctime);
+    jput_long(b, v->mtime);
+    jput_int(b, v->version);
+    jput_int(b, v->cversion);
+    jput_int(b, v->aversion);
+    jput_long(b, v->ephemeralOwner);
+    return 0;
+}
+
+static int decode_StatPersistedV1(struct buff_struct *b, struct StatPersistedV1 *v) {
+    if (jneed(b, 52)) return -E2BIG;
+    v->czxid = jget_long(b);
+    v->mzxid = jget_long(b);
+    v->ctime = jget_long(b);
+    v->mtime = jget_long(b);
+    v->version = jget_int(b);
+    v->cversion = jget_int(b);
+    v->aversion = jget_int(b);
+    v->ephemeralOwner = jget_long(b);
+    return 0;
+}
+
+static int encode_ConnectRequest(struct buff_struct *b, struct ConnectRequest *v) {
+    int rc;
+
+    if (jreserve(b, 24)) return -ENOMEM;
+    jput_int(b, v->protocolVersion);
+    jput_long(b, v->lastZxidSeen);
+    jput_int(b, v->timeOut);
+    jput_long(b, v->sessionId);
+    if ((rc = jwrite_buffer(b, &v->passwd))) return rc;
+    return 0;
+}
+
+static int decode_ConnectRequest(struct buff_struct *b, struct ConnectRequest *v) {
+    int rc;
+
+    if (jneed(b, 24)) return -E2BIG;
+    v->protocolVersion = jget_int(b);
+    v->lastZxidSeen = jget_long(b);
+    v->timeOut = jget_int(b);
+    v->sessionId = jget_long(b);
+    if ((rc = jread_buffer(b, &v->passwd))) return rc;
+    return 0;
+}
+
+static int encode_ConnectResponse(struct buff_struct *b, struct ConnectResponse *v) {
+    int rc;
+
+    if (jreserve(b, 16)) return -ENOMEM;
+    jput_int(b, v->protocolVersion);
+    jput_int(b, v->timeOut);
+    jput_long(b, v->sessionId);
+    if ((rc = jwrite_buffer(b, &v->passwd))) return rc;
+    return 0;
+}
+
+static int decode_ConnectResponse(struct buff_struct *b, struct ConnectResponse *v) {
+    int rc;
+
+    if (jneed(b, 16)) return -E2BIG;
+    v->protocolVersion = jget_int(b);
+    v->timeOut = jget_int(b);
+    v->sessionId = jget_long(b);
+    if ((rc = jread_buffer(b, &v->passwd))) return rc;
+    return 0;
+}
+
+static int encode_String_vector(struct buff_struct *b, struct String_vector *v) {
+    int rc;
+    int32_t i;
+
+    if ((rc = jwrite_int(b, v->count))) return rc;
+    for (i = 0; i < v->count; i++) {
+        if ((rc = jwrite_string(b, v->data[i]))) return rc;
+    }
+    return 0;
+}
+
+static int decode_String_vector(struct buff_struct *b, struct String_vector *v) {
+    int rc;
+    int32_t i;
+
+    v->data = NULL;
+    if ((rc = jread_int(b, &v->count))) return rc;
+    if (v->count <= 0) return 0;
+    // every element takes at least a byte, a larger count is corrupt
+    if (v->count > b->len - b->off) return -E2BIG;
+    if (!(v->data = calloc(v->count, sizeof(*v->data)))) return -ENOMEM;
+    for (i = 0; i < v->count; i++) {
+        if ((rc = jread_string(b, &v->data[i]))) return rc;
+    }
+    return 0;
+}
+
+static int encode_SetWatches(struct buff_struct *b, struct SetWatches *v) {
+    int rc;
+
+    if (jreserve(b, 8)) return -ENOMEM;
+    jput_long(b, v->relativeZxid);
+    if ((rc = encode_String_vector(b, &v->dataWatches))) return rc;
+    if ((rc = encode_String_vector(b, &v->existWatches))) return rc;
+    if ((rc = encode_String_vector(b, &v->childWatches))) return rc;
+    return 0;
+}
+
+static int decode_SetWatches(struct buff_struct *b, struct SetWatches *v) {
+    int rc;
+
+    if (jneed(b, 8)) return -E2BIG;
+    v->relativeZxid = jget_long(b);
+    if ((rc = decode_String_vector(b, &v->dataWatches))) return rc;
+    if ((rc = decode_String_vector(b, &v->existWatches))) return rc;
+    if ((rc = decode_String_vector(b, &v->childWatches))) return rc;
+    return 0;
+}
+
+static int encode_RequestHeader(struct buff_struct *b, struct RequestHeader *v) {
+    if (jreserve(b, 8)) return -ENOMEM;
+    jput_int(b, v->xid);
+    jput_int(b, v->type);
+    return 0;
+}
+
+static int decode_RequestHeader(struct buff_struct *b, struct RequestHeader *v) {
+    if (jneed(b, 8)) return -E2BIG;
+    v->xid = jget_int(b);
+    v->type = jget_int(b);
+    return 0;
+}
+
+static int encode_MultiHeader(struct buff_struct *b, struct MultiHeader *v) {
+    if (jreserve(b, 9)) return -ENOMEM;
+    jput_int(b, v->type);
+    jput_bool(b, v->done);
+    jput_int(b, v->err);
+    return 0;
+}
+
+static int decode_MultiHeader(struct buff_struct *b, struct MultiHeader *v) {
+    if (jneed(b, 9)) return -E2BIG;
+    v->type = jget_int(b);
+    v->done = jget_bool(b);
+    v->err = jget_int(b);
+    return 0;
+}
+
+static int encode_AuthPacket(struct buff_struct *b, struct AuthPacket *v) {
+    int rc;
+
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->type);
+    if ((rc = jwrite_string(b, v->scheme))) return rc;
+    if ((rc = jwrite_buffer(b, &v->auth))) return rc;
+    return 0;
+}
+
+static int decode_AuthPacket(struct buff_struct *b, struct AuthPacket *v) {
+    int rc;
+
+    if (jneed(b, 4)) return -E2BIG;
+    v->type = jget_int(b);
+    if ((rc = jread_string(b, &v->scheme))) return rc;
+    if ((rc = jread_buffer(b, &v->auth))) return rc;
+    return 0;
+}
+
+static int encode_ReplyHeader(struct buff_struct *b, struct ReplyHeader *v) {
+    if (jreserve(b, 16)) return -ENOMEM;
+    jput_int(b, v->xid);
+    jput_long(b, v->zxid);
+    jput_int(b, v->err);
+    return 0;
+}
+
+static int decode_ReplyHeader(struct buff_struct *b, struct ReplyHeader *v) {
+    if (jneed(b, 16)) return -E2BIG;
+    v->xid = jget_int(b);
+    v->zxid = jget_long(b);
+    v->err = jget_int(b);
+    return 0;
+}
+
+static int encode_GetDataRequest(struct buff_struct *b, struct GetDataRequest *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if (jreserve(b, 1)) return -ENOMEM;
+    jput_bool(b, v->watch);
+    return 0;
+}
+
+static int decode_GetDataRequest(struct buff_struct *b, struct GetDataRequest *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if (jneed(b, 1)) return -E2BIG;
+    v->watch = jget_bool(b);
+    return 0;
+}
+
+static int encode_SetDataRequest(struct buff_struct *b, struct SetDataRequest *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if ((rc = jwrite_buffer(b, &v->data))) return rc;
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->version);
+    return 0;
+}
+
+static int decode_SetDataRequest(struct buff_struct *b, struct SetDataRequest *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if ((rc = jread_buffer(b, &v->data))) return rc;
+    if (jneed(b, 4)) return -E2BIG;
+    v->version = jget_int(b);
+    return 0;
+}
+
+static int encode_SetDataResponse(struct buff_struct *b, struct SetDataResponse *v) {
+    if (jreserve(b, 68)) return -ENOMEM;
+    jput_long(b, v->stat.czxid);
+    jput_long(b, v->stat.mzxid);
+    jput_long(b, v->stat.ctime);
+    jput_long(b, v->stat.mtime);
+    jput_int(b, v->stat.version);
+    jput_int(b, v->stat.cversion);
+    jput_int(b, v->stat.aversion);
+    jput_long(b, v->stat.ephemeralOwner);
+    jput_int(b, v->stat.dataLength);
+    jput_int(b, v->stat.numChildren);
+    jput_long(b, v->stat.pzxid);
+    return 0;
+}
+
+static int decode_SetDataResponse(struct buff_struct *b, struct SetDataResponse *v) {
+    if (jneed(b, 68)) return -E2BIG;
+    v->stat.czxid = jget_long(b);
+    v->stat.mzxid = jget_long(b);
+    v->stat.ctime = jget_long(b);
+    v->stat.mtime = jget_long(b);
+    v->stat.version = jget_int(b);
+    v->stat.cversion = jget_int(b);
+    v->stat.aversion = jget_int(b);
+    v->stat.ephemeralOwner = jget_long(b);
+    v->stat.dataLength = jget_int(b);
+    v->stat.numChildren = jget_int(b);
+    v->stat.pzxid = jget_long(b);
+    return 0;
+}
+
+static int encode_GetSASLRequest(struct buff_struct *b, struct GetSASLRequest *v) {
+    int rc;
+
+    if ((rc = jwrite_buffer(b, &v->token))) return rc;
+    return 0;
+}
+
+static int decode_GetSASLRequest(struct buff_struct *b, struct GetSASLRequest *v) {
+    int rc;
+
+    if ((rc = jread_buffer(b, &v->token))) return rc;
+    return 0;
+}
+
+static int encode_SetSASLRequest(struct buff_struct *b, struct SetSASLRequest *v) {
+    int rc;
+
+    if ((rc = jwrite_buffer(b, &v->token))) return rc;
+    return 0;
+}
+
+static int decode_SetSASLRequest(struct buff_struct *b, struct SetSASLRequest *v) {
+    int rc;
+
+    if ((rc = jread_buffer(b, &v->token))) return rc;
+    return 0;
+}
+
+static int encode_SetSASLResponse(struct buff_struct *b, struct SetSASLResponse *v) {
+    int rc;
+
+    if ((rc = jwrite_buffer(b, &v->token))) return rc;
+    return 0;
+}
+
+static int decode_SetSASLResponse(struct buff_struct *b, struct SetSASLResponse *v) {
+    int rc;
+
+    if ((rc = jread_buffer(b, &v->token))) return rc;
+    return 0;
+}
+
+static int encode_ACL_vector(struct buff_struct *b, struct ACL_vector *v) {
+    int rc;
+    int32_t i;
+
+    if ((rc = jwrite_int(b, v->count))) return rc;
+    for (i = 0; i < v->count; i++) {
+        if ((rc = encode_ACL(b, &v->data[i]))) return rc;
+    }
+    return 0;
+}
+
+static int decode_ACL_vector(struct buff_struct *b, struct ACL_vector *v) {
+    int rc;
+    int32_t i;
+
+    v->data = NULL;
+    if ((rc = jread_int(b, &v->count))) return rc;
+    if (v->count <= 0) return 0;
+    // every element takes at least a byte, a larger count is corrupt
+    if (v->count > b->len - b->off) return -E2BIG;
+    if (!(v->data = calloc(v->count, sizeof(*v->data)))) return -ENOMEM;
+    for (i = 0; i < v->count; i++) {
+        if ((rc = decode_ACL(b, &v->data[i]))) return rc;
+    }
+    return 0;
+}
+
+static int encode_CreateRequest(struct buff_struct *b, struct CreateRequest *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if ((rc = jwrite_buffer(b, &v->data))) return rc;
+    if ((rc = encode_ACL_vector(b, &v->acl))) return rc;
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->flags);
+    return 0;
+}
+
+static int decode_CreateRequest(struct buff_struct *b, struct CreateRequest *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if ((rc = jread_buffer(b, &v->data))) return rc;
+    if ((rc = decode_ACL_vector(b, &v->acl))) return rc;
+    if (jneed(b, 4)) return -E2BIG;
+    v->flags = jget_int(b);
+    return 0;
+}
+
+static int encode_DeleteRequest(struct buff_struct *b, struct DeleteRequest *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->version);
+    return 0;
+}
+
+static int decode_DeleteRequest(struct buff_struct *b, struct DeleteRequest *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if (jneed(b, 4)) return -E2BIG;
+    v->version = jget_int(b);
+    return 0;
+}
+
+static int encode_GetChildrenRequest(struct buff_struct *b, struct GetChildrenRequest *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if (jreserve(b, 1)) return -ENOMEM;
+    jput_bool(b, v->watch);
+    return 0;
+}
+
+static int decode_GetChildrenRequest(struct buff_struct *b, struct GetChildrenRequest *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if (jneed(b, 1)) return -E2BIG;
+    v->watch = jget_bool(b);
+    return 0;
+}
+
+static int encode_GetChildren2Request(struct buff_struct *b, struct GetChildren2Request *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if (jreserve(b, 1)) return -ENOMEM;
+    jput_bool(b, v->watch);
+    return 0;
+}
+
+static int decode_GetChildren2Request(struct buff_struct *b, struct GetChildren2Request *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if (jneed(b, 1)) return -E2BIG;
+    v->watch = jget_bool(b);
+    return 0;
+}
+
+static int encode_CheckVersionRequest(struct buff_struct *b, struct CheckVersionRequest *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->version);
+    return 0;
+}
+
+static int decode_CheckVersionRequest(struct buff_struct *b, struct CheckVersionRequest *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if (jneed(b, 4)) return -E2BIG;
+    v->version = jget_int(b);
+    return 0;
+}
+
+static int encode_GetMaxChildrenRequest(struct buff_struct *b, struct GetMaxChildrenRequest *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    return 0;
+}
+
+static int decode_GetMaxChildrenRequest(struct buff_struct *b, struct GetMaxChildrenRequest *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    return 0;
+}
+
+static int encode_GetMaxChildrenResponse(struct buff_struct *b, struct GetMaxChildrenResponse *v) {
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->max);
+    return 0;
+}
+
+static int decode_GetMaxChildrenResponse(struct buff_struct *b, struct GetMaxChildrenResponse *v) {
+    if (jneed(b, 4)) return -E2BIG;
+    v->max = jget_int(b);
+    return 0;
+}
+
+static int encode_SetMaxChildrenRequest(struct buff_struct *b, struct SetMaxChildrenRequest *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->max);
+    return 0;
+}
+
+static int decode_SetMaxChildrenRequest(struct buff_struct *b, struct SetMaxChildrenRequest *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if (jneed(b, 4)) return -E2BIG;
+    v->max = jget_int(b);
+    return 0;
+}
+
+static int encode_SyncRequest(struct buff_struct *b, struct SyncRequest *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    return 0;
+}
+
+static int decode_SyncRequest(struct buff_struct *b, struct SyncRequest *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    return 0;
+}
+
+static int encode_SyncResponse(struct buff_struct *b, struct SyncResponse *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    return 0;
+}
+
+static int decode_SyncResponse(struct buff_struct *b, struct SyncResponse *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    return 0;
+}
+
+static int encode_GetACLRequest(struct buff_struct *b, struct GetACLRequest *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    return 0;
+}
+
+static int decode_GetACLRequest(struct buff_struct *b, struct GetACLRequest *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    return 0;
+}
+
+static int encode_SetACLRequest(struct buff_struct *b, struct SetACLRequest *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if ((rc = encode_ACL_vector(b, &v->acl))) return rc;
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->version);
+    return 0;
+}
+
+static int decode_SetACLRequest(struct buff_struct *b, struct SetACLRequest *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if ((rc = decode_ACL_vector(b, &v->acl))) return rc;
+    if (jneed(b, 4)) return -E2BIG;
+    v->version = jget_int(b);
+    return 0;
+}
+
+static int encode_SetACLResponse(struct buff_struct *b, struct SetACLResponse *v) {
+    if (jreserve(b, 68)) return -ENOMEM;
+    jput_long(b, v->stat.czxid);
+    jput_long(b, v->stat.mzxid);
+    jput_long(b, v->stat.ctime);
+    jput_long(b, v->stat.mtime);
+    jput_int(b, v->stat.version);
+    jput_int(b, v->stat.cversion);
+    jput_int(b, v->stat.aversion);
+    jput_long(b, v->stat.ephemeralOwner);
+    jput_int(b, v->stat.dataLength);
+    jput_int(b, v->stat.numChildren);
+    jput_long(b, v->stat.pzxid);
+    return 0;
+}
+
+static int decode_SetACLResponse(struct buff_struct *b, struct SetACLResponse *v) {
+    if (jneed(b, 68)) return -E2BIG;
+    v->stat.czxid = jget_long(b);
+    v->stat.mzxid = jget_long(b);
+    v->stat.ctime = jget_long(b);
+    v->stat.mtime = jget_long(b);
+    v->stat.version = jget_int(b);
+    v->stat.cversion = jget_int(b);
+    v->stat.aversion = jget_int(b);
+    v->stat.ephemeralOwner = jget_long(b);
+    v->stat.dataLength = jget_int(b);
+    v->stat.numChildren = jget_int(b);
+    v->stat.pzxid = jget_long(b);
+    return 0;
+}
+
+static int encode_WatcherEvent(struct buff_struct *b, struct WatcherEvent *v) {
+    int rc;
+
+    if (jreserve(b, 8)) return -ENOMEM;
+    jput_int(b, v->type);
+    jput_int(b, v->state);
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    return 0;
+}
+
+static int decode_WatcherEvent(struct buff_struct *b, struct WatcherEvent *v) {
+    int rc;
+
+    if (jneed(b, 8)) return -E2BIG;
+    v->type = jget_int(b);
+    v->state = jget_int(b);
+    if ((rc = jread_string(b, &v->path))) return rc;
+    return 0;
+}
+
+static int encode_ErrorResponse(struct buff_struct *b, struct ErrorResponse *v) {
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->err);
+    return 0;
+}
+
+static int decode_ErrorResponse(struct buff_struct *b, struct ErrorResponse *v) {
+    if (jneed(b, 4)) return -E2BIG;
+    v->err = jget_int(b);
+    return 0;
+}
+
+static int encode_CreateResponse(struct buff_struct *b, struct CreateResponse *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    return 0;
+}
+
+static int decode_CreateResponse(struct buff_struct *b, struct CreateResponse *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    return 0;
+}
+
+static int encode_ExistsRequest(struct buff_struct *b, struct ExistsRequest *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if (jreserve(b, 1)) return -ENOMEM;
+    jput_bool(b, v->watch);
+    return 0;
+}
+
+static int decode_ExistsRequest(struct buff_struct *b, struct ExistsRequest *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if (jneed(b, 1)) return -E2BIG;
+    v->watch = jget_bool(b);
+    return 0;
+}
+
+static int encode_ExistsResponse(struct buff_struct *b, struct ExistsResponse *v) {
+    if (jreserve(b, 68)) return -ENOMEM;
+    jput_long(b, v->stat.czxid);
+    jput_long(b, v->stat.mzxid);
+    jput_long(b, v->stat.ctime);
+    jput_long(b, v->stat.mtime);
+    jput_int(b, v->stat.version);
+    jput_int(b, v->stat.cversion);
+    jput_int(b, v->stat.aversion);
+    jput_long(b, v->stat.ephemeralOwner);
+    jput_int(b, v->stat.dataLength);
+    jput_int(b, v->stat.numChildren);
+    jput_long(b, v->stat.pzxid);
+    return 0;
+}
+
+static int decode_ExistsResponse(struct buff_struct *b, struct ExistsResponse *v) {
+    if (jneed(b, 68)) return -E2BIG;
+    v->stat.czxid = jget_long(b);
+    v->stat.mzxid = jget_long(b);
+    v->stat.ctime = jget_long(b);
+    v->stat.mtime = jget_long(b);
+    v->stat.version = jget_int(b);
+    v->stat.cversion = jget_int(b);
+    v->stat.aversion = jget_int(b);
+    v->stat.ephemeralOwner = jget_long(b);
+    v->stat.dataLength = jget_int(b);
+    v->stat.numChildren = jget_int(b);
+    v->stat.pzxid = jget_long(b);
+    return 0;
+}
+
+static int encode_GetDataResponse(struct buff_struct *b, struct GetDataResponse *v) {
+    int rc;
+
+    if ((rc = jwrite_buffer(b, &v->data))) return rc;
+    if (jreserve(b, 68)) return -ENOMEM;
+    jput_long(b, v->stat.czxid);
+    jput_long(b, v->stat.mzxid);
+    jput_long(b, v->stat.ctime);
+    jput_long(b, v->stat.mtime);
+    jput_int(b, v->stat.version);
+    jput_int(b, v->stat.cversion);
+    jput_int(b, v->stat.aversion);
+    jput_long(b, v->stat.ephemeralOwner);
+    jput_int(b, v->stat.dataLength);
+    jput_int(b, v->stat.numChildren);
+    jput_long(b, v->stat.pzxid);
+    return 0;
+}
+
+static int decode_GetDataResponse(struct buff_struct *b, struct GetDataResponse *v) {
+    int rc;
+
+    if ((rc = jread_buffer(b, &v->data))) return rc;
+    if (jneed(b, 68)) return -E2BIG;
+    v->stat.czxid = jget_long(b);
+    v->stat.mzxid = jget_long(b);
+    v->stat.ctime = jget_long(b);
+    v->stat.mtime = jget_long(b);
+    v->stat.version = jget_int(b);
+    v->stat.cversion = jget_int(b);
+    v->stat.aversion = jget_int(b);
+    v->stat.ephemeralOwner = jget_long(b);
+    v->stat.dataLength = jget_int(b);
+    v->stat.numChildren = jget_int(b);
+    v->stat.pzxid = jget_long(b);
+    return 0;
+}
+
+static int encode_GetChildrenResponse(struct buff_struct *b, struct GetChildrenResponse *v) {
+    int rc;
+
+    if ((rc = encode_String_vector(b, &v->children))) return rc;
+    return 0;
+}
+
+static int decode_GetChildrenResponse(struct buff_struct *b, struct GetChildrenResponse *v) {
+    int rc;
+
+    if ((rc = decode_String_vector(b, &v->children))) return rc;
+    return 0;
+}
+
+static int encode_GetChildren2Response(struct buff_struct *b, struct GetChildren2Response *v) {
+    int rc;
+
+    if ((rc = encode_String_vector(b, &v->children))) return rc;
+    if (jreserve(b, 68)) return -ENOMEM;
+    jput_long(b, v->stat.czxid);
+    jput_long(b, v->stat.mzxid);
+    jput_long(b, v->stat.ctime);
+    jput_long(b, v->stat.mtime);
+    jput_int(b, v->stat.version);
+    jput_int(b, v->stat.cversion);
+    jput_int(b, v->stat.aversion);
+    jput_long(b, v->stat.ephemeralOwner);
+    jput_int(b, v->stat.dataLength);
+    jput_int(b, v->stat.numChildren);
+    jput_long(b, v->stat.pzxid);
+    return 0;
+}
+
+static int decode_GetChildren2Response(struct buff_struct *b, struct GetChildren2Response *v) {
+    int rc;
+
+    if ((rc = decode_String_vector(b, &v->children))) return rc;
+    if (jneed(b, 68)) return -E2BIG;
+    v->stat.czxid = jget_long(b);
+    v->stat.mzxid = jget_long(b);
+    v->stat.ctime = jget_long(b);
+    v->stat.mtime = jget_long(b);
+    v->stat.version = jget_int(b);
+    v->stat.cversion = jget_int(b);
+    v->stat.aversion = jget_int(b);
+    v->stat.ephemeralOwner = jget_long(b);
+    v->stat.dataLength = jget_int(b);
+    v->stat.numChildren = jget_int(b);
+    v->stat.pzxid = jget_long(b);
+    return 0;
+}
+
+static int encode_GetACLResponse(struct buff_struct *b, struct GetACLResponse *v) {
+    int rc;
+
+    if ((rc = encode_ACL_vector(b, &v->acl))) return rc;
+    if (jreserve(b, 68)) return -ENOMEM;
+    jput_long(b, v->stat.czxid);
+    jput_long(b, v->stat.mzxid);
+    jput_long(b, v->stat.ctime);
+    jput_long(b, v->stat.mtime);
+    jput_int(b, v->stat.version);
+    jput_int(b, v->stat.cversion);
+    jput_int(b, v->stat.aversion);
+    jput_long(b, v->stat.ephemeralOwner);
+    jput_int(b, v->stat.dataLength);
+    jput_int(b, v->stat.numChildren);
+    jput_long(b, v->stat.pzxid);
+    return 0;
+}
+
+static int decode_GetACLResponse(struct buff_struct *b, struct GetACLResponse *v) {
+    int rc;
+
+    if ((rc = decode_ACL_vector(b, &v->acl))) return rc;
+    if (jneed(b, 68)) return -E2BIG;
+    v->stat.czxid = jget_long(b);
+    v->stat.mzxid = jget_long(b);
+    v->stat.ctime = jget_long(b);
+    v->stat.mtime = jget_long(b);
+    v->stat.version = jget_int(b);
+    v->stat.cversion = jget_int(b);
+    v->stat.aversion = jget_int(b);
+    v->stat.ephemeralOwner = jget_long(b);
+    v->stat.dataLength = jget_int(b);
+    v->stat.numChildren = jget_int(b);
+    v->stat.pzxid = jget_long(b);
+    return 0;
+}
+
+static int encode_LearnerInfo(struct buff_struct *b, struct LearnerInfo *v) {
+    if (jreserve(b, 12)) return -ENOMEM;
+    jput_long(b, v->serverid);
+    jput_int(b, v->protocolVersion);
+    return 0;
+}
+
+static int decode_LearnerInfo(struct buff_struct *b, struct LearnerInfo *v) {
+    if (jneed(b, 12)) return -E2BIG;
+    v->serverid = jget_long(b);
+    v->protocolVersion = jget_int(b);
+    return 0;
+}
+
+static int encode_Id_vector(struct buff_struct *b, struct Id_vector *v) {
+    int rc;
+    int32_t i;
+
+    if ((rc = jwrite_int(b, v->count))) return rc;
+    for (i = 0; i < v->count; i++) {
+        if ((rc = encode_Id(b, &v->data[i]))) return rc;
+    }
+    return 0;
+}
+
+static int decode_Id_vector(struct buff_struct *b, struct Id_vector *v) {
+    int rc;
+    int32_t i;
+
+    v->data = NULL;
+    if ((rc = jread_int(b, &v->count))) return rc;
+    if (v->count <= 0) return 0;
+    // every element takes at least a byte, a larger count is corrupt
+    if (v->count > b->len - b->off) return -E2BIG;
+    if (!(v->data = calloc(v->count, sizeof(*v->data)))) return -ENOMEM;
+    for (i = 0; i < v->count; i++) {
+        if ((rc = decode_Id(b, &v->data[i]))) return rc;
+    }
+    return 0;
+}
+
+static int encode_QuorumPacket(struct buff_struct *b, struct QuorumPacket *v) {
+    int rc;
+
+    if (jreserve(b, 12)) return -ENOMEM;
+    jput_int(b, v->type);
+    jput_long(b, v->zxid);
+    if ((rc = jwrite_buffer(b, &v->data))) return rc;
+    if ((rc = encode_Id_vector(b, &v->authinfo))) return rc;
+    return 0;
+}
+
+static int decode_QuorumPacket(struct buff_struct *b, struct QuorumPacket *v) {
+    int rc;
+
+    if (jneed(b, 12)) return -E2BIG;
+    v->type = jget_int(b);
+    v->zxid = jget_long(b);
+    if ((rc = jread_buffer(b, &v->data))) return rc;
+    if ((rc = decode_Id_vector(b, &v->authinfo))) return rc;
+    return 0;
+}
+
+static int encode_FileHeader(struct buff_struct *b, struct FileHeader *v) {
+    if (jreserve(b, 16)) return -ENOMEM;
+    jput_int(b, v->magic);
+    jput_int(b, v->version);
+    jput_long(b, v->dbid);
+    return 0;
+}
+
+static int decode_FileHeader(struct buff_struct *b, struct FileHeader *v) {
+    if (jneed(b, 16)) return -E2BIG;
+    v->magic = jget_int(b);
+    v->version = jget_int(b);
+    v->dbid = jget_long(b);
+    return 0;
+}
+
+static int encode_TxnHeader(struct buff_struct *b, struct TxnHeader *v) {
+    if (jreserve(b, 32)) return -ENOMEM;
+    jput_long(b, v->clientId);
+    jput_int(b, v->cxid);
+    jput_long(b, v->zxid);
+    jput_long(b, v->time);
+    jput_int(b, v->type);
+    return 0;
+}
+
+static int decode_TxnHeader(struct buff_struct *b, struct TxnHeader *v) {
+    if (jneed(b, 32)) return -E2BIG;
+    v->clientId = jget_long(b);
+    v->cxid = jget_int(b);
+    v->zxid = jget_long(b);
+    v->time = jget_long(b);
+    v->type = jget_int(b);
+    return 0;
+}
+
+static int encode_CreateTxnV0(struct buff_struct *b, struct CreateTxnV0 *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if ((rc = jwrite_buffer(b, &v->data))) return rc;
+    if ((rc = encode_ACL_vector(b, &v->acl))) return rc;
+    if (jreserve(b, 1)) return -ENOMEM;
+    jput_bool(b, v->ephemeral);
+    return 0;
+}
+
+static int decode_CreateTxnV0(struct buff_struct *b, struct CreateTxnV0 *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if ((rc = jread_buffer(b, &v->data))) return rc;
+    if ((rc = decode_ACL_vector(b, &v->acl))) return rc;
+    if (jneed(b, 1)) return -E2BIG;
+    v->ephemeral = jget_bool(b);
+    return 0;
+}
+
+static int encode_CreateTxn(struct buff_struct *b, struct CreateTxn *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if ((rc = jwrite_buffer(b, &v->data))) return rc;
+    if ((rc = encode_ACL_vector(b, &v->acl))) return rc;
+    if (jreserve(b, 5)) return -ENOMEM;
+    jput_bool(b, v->ephemeral);
+    jput_int(b, v->parentCVersion);
+    return 0;
+}
+
+static int decode_CreateTxn(struct buff_struct *b, struct CreateTxn *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if ((rc = jread_buffer(b, &v->data))) return rc;
+    if ((rc = decode_ACL_vector(b, &v->acl))) return rc;
+    if (jneed(b, 5)) return -E2BIG;
+    v->ephemeral = jget_bool(b);
+    v->parentCVersion = jget_int(b);
+    return 0;
+}
+
+static int encode_DeleteTxn(struct buff_struct *b, struct DeleteTxn *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    return 0;
+}
+
+static int decode_DeleteTxn(struct buff_struct *b, struct DeleteTxn *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    return 0;
+}
+
+static int encode_SetDataTxn(struct buff_struct *b, struct SetDataTxn *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if ((rc = jwrite_buffer(b, &v->data))) return rc;
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->version);
+    return 0;
+}
+
+static int decode_SetDataTxn(struct buff_struct *b, struct SetDataTxn *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if ((rc = jread_buffer(b, &v->data))) return rc;
+    if (jneed(b, 4)) return -E2BIG;
+    v->version = jget_int(b);
+    return 0;
+}
+
+static int encode_CheckVersionTxn(struct buff_struct *b, struct CheckVersionTxn *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->version);
+    return 0;
+}
+
+static int decode_CheckVersionTxn(struct buff_struct *b, struct CheckVersionTxn *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if (jneed(b, 4)) return -E2BIG;
+    v->version = jget_int(b);
+    return 0;
+}
+
+static int encode_SetACLTxn(struct buff_struct *b, struct SetACLTxn *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if ((rc = encode_ACL_vector(b, &v->acl))) return rc;
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->version);
+    return 0;
+}
+
+static int decode_SetACLTxn(struct buff_struct *b, struct SetACLTxn *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if ((rc = decode_ACL_vector(b, &v->acl))) return rc;
+    if (jneed(b, 4)) return -E2BIG;
+    v->version = jget_int(b);
+    return 0;
+}
+
+static int encode_SetMaxChildrenTxn(struct buff_struct *b, struct SetMaxChildrenTxn *v) {
+    int rc;
+
+    if ((rc = jwrite_string(b, v->path))) return rc;
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->max);
+    return 0;
+}
+
+static int decode_SetMaxChildrenTxn(struct buff_struct *b, struct SetMaxChildrenTxn *v) {
+    int rc;
+
+    if ((rc = jread_string(b, &v->path))) return rc;
+    if (jneed(b, 4)) return -E2BIG;
+    v->max = jget_int(b);
+    return 0;
+}
+
+static int encode_CreateSessionTxn(struct buff_struct *b, struct CreateSessionTxn *v) {
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->timeOut);
+    return 0;
+}
+
+static int decode_CreateSessionTxn(struct buff_struct *b, struct CreateSessionTxn *v) {
+    if (jneed(b, 4)) return -E2BIG;
+    v->timeOut = jget_int(b);
+    return 0;
+}
+
+static int encode_ErrorTxn(struct buff_struct *b, struct ErrorTxn *v) {
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->err);
+    return 0;
+}
+
+static int decode_ErrorTxn(struct buff_struct *b, struct ErrorTxn *v) {
+    if (jneed(b, 4)) return -E2BIG;
+    v->err = jget_int(b);
+    return 0;
+}
+
+static int encode_Txn(struct buff_struct *b, struct Txn *v) {
+    int rc;
+
+    if (jreserve(b, 4)) return -ENOMEM;
+    jput_int(b, v->type);
+    if ((rc = jwrite_buffer(b, &v->data))) return rc;
+    return 0;
+}
+
+static int decode_Txn(struct buff_struct *b, struct Txn *v) {
+    int rc;
+
+    if (jneed(b, 4)) return -E2BIG;
+    v->type = jget_int(b);
+    if ((rc = jread_buffer(b, &v->data))) return rc;
+    return 0;
+}
+
+static int encode_Txn_vector(struct buff_struct *b, struct Txn_vector *v) {
+    int rc;
+    int32_t i;
+
+    if ((rc = jwrite_int(b, v->count))) return rc;
+    for (i = 0; i < v->count; i++) {
+        if ((rc = encode_Txn(b, &v->data[i]))) return rc;
+    }
+    return 0;
+}
+
+static int decode_Txn_vector(struct buff_struct *b, struct Txn_vector *v) {
+    int rc;
+    int32_t i;
+
+    v->data = NULL;
+    if ((rc = jread_int(b, &v->count))) return rc;
+    if (v->count <= 0) return 0;
+    // every element takes at least a byte, a larger count is corrupt
+    if (v->count > b->len - b->off) return -E2BIG;
+    if (!(v->data = calloc(v->count, sizeof(*v->data)))) return -ENOMEM;
+    for (i = 0; i < v->count; i++) {
+        if ((rc = decode_Txn(b, &v->data[i]))) return rc;
+    }
+    return 0;
+}
+
+static int encode_MultiTxn(struct buff_struct *b, struct MultiTxn *v) {
+    int rc;
+
+    if ((rc = encode_Txn_vector(b, &v->txns))) return rc;
+    return 0;
+}
+
+static int decode_MultiTxn(struct buff_struct *b, struct MultiTxn *v) {
+    int rc;
+
+    if ((rc = decode_Txn_vector(b, &v->txns))) return rc;
+    return 0;
+}
+
+int jute_encode_Id(struct oarchive *out, struct Id *v) {
+    if (!is_buffer_oarchive(out)) return serialize_Id(out, "", v);
+    return encode_Id(out->priv, v);
+}
+
+int jute_decode_Id(struct iarchive *in, struct Id *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_Id(in, "", v);
+    return decode_Id(in->priv, v);
+}
+
+int jute_encode_ACL(struct oarchive *out, struct ACL *v) {
+    if (!is_buffer_oarchive(out)) return serialize_ACL(out, "", v);
+    return encode_ACL(out->priv, v);
+}
+
+int jute_decode_ACL(struct iarchive *in, struct ACL *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_ACL(in, "", v);
+    return decode_ACL(in->priv, v);
+}
+
+int jute_encode_Stat(struct oarchive *out, struct Stat *v) {
+    if (!is_buffer_oarchive(out)) return serialize_Stat(out, "", v);
+    return encode_Stat(out->priv, v);
+}
+
+int jute_decode_Stat(struct iarchive *in, struct Stat *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_Stat(in, "", v);
+    return decode_Stat(in->priv, v);
+}
+
+int jute_encode_StatPersisted(struct oarchive *out, struct StatPersisted *v) {
+    if (!is_buffer_oarchive(out)) return serialize_StatPersisted(out, "", v);
+    return encode_StatPersisted(out->priv, v);
+}
+
+int jute_decode_StatPersisted(struct iarchive *in, struct StatPersisted *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_StatPersisted(in, "", v);
+    return decode_StatPersisted(in->priv, v);
+}
+
+int jute_encode_StatPersistedV1(struct oarchive *out, struct StatPersistedV1 *v) {
+    if (!is_buffer_oarchive(out)) return serialize_StatPersistedV1(out, "", v);
+    return encode_StatPersistedV1(out->priv, v);
+}
+
+int jute_decode_StatPersistedV1(struct iarchive *in, struct StatPersistedV1 *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_StatPersistedV1(in, "", v);
+    return decode_StatPersistedV1(in->priv, v);
+}
+
+int jute_encode_ConnectRequest(struct oarchive *out, struct ConnectRequest *v) {
+    if (!is_buffer_oarchive(out)) return serialize_ConnectRequest(out, "", v);
+    return encode_ConnectRequest(out->priv, v);
+}
+
+int jute_decode_ConnectRequest(struct iarchive *in, struct ConnectRequest *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_ConnectRequest(in, "", v);
+    return decode_ConnectRequest(in->priv, v);
+}
+
+int jute_encode_ConnectResponse(struct oarchive *out, struct ConnectResponse *v) {
+    if (!is_buffer_oarchive(out)) return serialize_ConnectResponse(out, "", v);
+    return encode_ConnectResponse(out->priv, v);
+}
+
+int jute_decode_ConnectResponse(struct iarchive *in, struct ConnectResponse *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_ConnectResponse(in, "", v);
+    return decode_ConnectResponse(in->priv, v);
+}
+
+int jute_encode_String_vector(struct oarchive *out, struct String_vector *v) {
+    if (!is_buffer_oarchive(out)) return serialize_String_vector(out, "", v);
+    return encode_String_vector(out->priv, v);
+}
+
+int jute_decode_String_vector(struct iarchive *in, struct String_vector *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_String_vector(in, "", v);
+    return decode_String_vector(in->priv, v);
+}
+
+int jute_encode_SetWatches(struct oarchive *out, struct SetWatches *v) {
+    if (!is_buffer_oarchive(out)) return serialize_SetWatches(out, "", v);
+    return encode_SetWatches(out->priv, v);
+}
+
+int jute_decode_SetWatches(struct iarchive *in, struct SetWatches *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_SetWatches(in, "", v);
+    return decode_SetWatches(in->priv, v);
+}
+
+int jute_encode_RequestHeader(struct oarchive *out, struct RequestHeader *v) {
+    if (!is_buffer_oarchive(out)) return serialize_RequestHeader(out, "", v);
+    return encode_RequestHeader(out->priv, v);
+}
+
+int jute_decode_RequestHeader(struct iarchive *in, struct RequestHeader *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_RequestHeader(in, "", v);
+    return decode_RequestHeader(in->priv, v);
+}
+
+int jute_encode_MultiHeader(struct oarchive *out, struct MultiHeader *v) {
+    if (!is_buffer_oarchive(out)) return serialize_MultiHeader(out, "", v);
+    return encode_MultiHeader(out->priv, v);
+}
+
+int jute_decode_MultiHeader(struct iarchive *in, struct MultiHeader *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_MultiHeader(in, "", v);
+    return decode_MultiHeader(in->priv, v);
+}
+
+int jute_encode_AuthPacket(struct oarchive *out, struct AuthPacket *v) {
+    if (!is_buffer_oarchive(out)) return serialize_AuthPacket(out, "", v);
+    return encode_AuthPacket(out->priv, v);
+}
+
+int jute_decode_AuthPacket(struct iarchive *in, struct AuthPacket *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_AuthPacket(in, "", v);
+    return decode_AuthPacket(in->priv, v);
+}
+
+int jute_encode_ReplyHeader(struct oarchive *out, struct ReplyHeader *v) {
+    if (!is_buffer_oarchive(out)) return serialize_ReplyHeader(out, "", v);
+    return encode_ReplyHeader(out->priv, v);
+}
+
+int jute_decode_ReplyHeader(struct iarchive *in, struct ReplyHeader *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_ReplyHeader(in, "", v);
+    return decode_ReplyHeader(in->priv, v);
+}
+
+int jute_encode_GetDataRequest(struct oarchive *out, struct GetDataRequest *v) {
+    if (!is_buffer_oarchive(out)) return serialize_GetDataRequest(out, "", v);
+    return encode_GetDataRequest(out->priv, v);
+}
+
+int jute_decode_GetDataRequest(struct iarchive *in, struct GetDataRequest *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_GetDataRequest(in, "", v);
+    return decode_GetDataRequest(in->priv, v);
+}
+
+int jute_encode_SetDataRequest(struct oarchive *out, struct SetDataRequest *v) {
+    if (!is_buffer_oarchive(out)) return serialize_SetDataRequest(out, "", v);
+    return encode_SetDataRequest(out->priv, v);
+}
+
+int jute_decode_SetDataRequest(struct iarchive *in, struct SetDataRequest *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_SetDataRequest(in, "", v);
+    return decode_SetDataRequest(in->priv, v);
+}
+
+int jute_encode_SetDataResponse(struct oarchive *out, struct SetDataResponse *v) {
+    if (!is_buffer_oarchive(out)) return serialize_SetDataResponse(out, "", v);
+    return encode_SetDataResponse(out->priv, v);
+}
+
+int jute_decode_SetDataResponse(struct iarchive *in, struct SetDataResponse *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_SetDataResponse(in, "", v);
+    return decode_SetDataResponse(in->priv, v);
+}
+
+int jute_encode_GetSASLRequest(struct oarchive *out, struct GetSASLRequest *v) {
+    if (!is_buffer_oarchive(out)) return serialize_GetSASLRequest(out, "", v);
+    return encode_GetSASLRequest(out->priv, v);
+}
+
+int jute_decode_GetSASLRequest(struct iarchive *in, struct GetSASLRequest *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_GetSASLRequest(in, "", v);
+    return decode_GetSASLRequest(in->priv, v);
+}
+
+int jute_encode_SetSASLRequest(struct oarchive *out, struct SetSASLRequest *v) {
+    if (!is_buffer_oarchive(out)) return serialize_SetSASLRequest(out, "", v);
+    return encode_SetSASLRequest(out->priv, v);
+}
+
+int jute_decode_SetSASLRequest(struct iarchive *in, struct SetSASLRequest *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_SetSASLRequest(in, "", v);
+    return decode_SetSASLRequest(in->priv, v);
+}
+
+int jute_encode_SetSASLResponse(struct oarchive *out, struct SetSASLResponse *v) {
+    if (!is_buffer_oarchive(out)) return serialize_SetSASLResponse(out, "", v);
+    return encode_SetSASLResponse(out->priv, v);
+}
+
+int jute_decode_SetSASLResponse(struct iarchive *in, struct SetSASLResponse *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_SetSASLResponse(in, "", v);
+    return decode_SetSASLResponse(in->priv, v);
+}
+
+int jute_encode_ACL_vector(struct oarchive *out, struct ACL_vector *v) {
+    if (!is_buffer_oarchive(out)) return serialize_ACL_vector(out, "", v);
+    return encode_ACL_vector(out->priv, v);
+}
+
+int jute_decode_ACL_vector(struct iarchive *in, struct ACL_vector *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_ACL_vector(in, "", v);
+    return decode_ACL_vector(in->priv, v);
+}
+
+int jute_encode_CreateRequest(struct oarchive *out, struct CreateRequest *v) {
+    if (!is_buffer_oarchive(out)) return serialize_CreateRequest(out, "", v);
+    return encode_CreateRequest(out->priv, v);
+}
+
+int jute_decode_CreateRequest(struct iarchive *in, struct CreateRequest *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_CreateRequest(in, "", v);
+    return decode_CreateRequest(in->priv, v);
+}
+
+int jute_encode_DeleteRequest(struct oarchive *out, struct DeleteRequest *v) {
+    if (!is_buffer_oarchive(out)) return serialize_DeleteRequest(out, "", v);
+    return encode_DeleteRequest(out->priv, v);
+}
+
+int jute_decode_DeleteRequest(struct iarchive *in, struct DeleteRequest *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_DeleteRequest(in, "", v);
+    return decode_DeleteRequest(in->priv, v);
+}
+
+int jute_encode_GetChildrenRequest(struct oarchive *out, struct GetChildrenRequest *v) {
+    if (!is_buffer_oarchive(out)) return serialize_GetChildrenRequest(out, "", v);
+    return encode_GetChildrenRequest(out->priv, v);
+}
+
+int jute_decode_GetChildrenRequest(struct iarchive *in, struct GetChildrenRequest *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_GetChildrenRequest(in, "", v);
+    return decode_GetChildrenRequest(in->priv, v);
+}
+
+int jute_encode_GetChildren2Request(struct oarchive *out, struct GetChildren2Request *v) {
+    if (!is_buffer_oarchive(out)) return serialize_GetChildren2Request(out, "", v);
+    return encode_GetChildren2Request(out->priv, v);
+}
+
+int jute_decode_GetChildren2Request(struct iarchive *in, struct GetChildren2Request *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_GetChildren2Request(in, "", v);
+    return decode_GetChildren2Request(in->priv, v);
+}
+
+int jute_encode_CheckVersionRequest(struct oarchive *out, struct CheckVersionRequest *v) {
+    if (!is_buffer_oarchive(out)) return serialize_CheckVersionRequest(out, "", v);
+    return encode_CheckVersionRequest(out->priv, v);
+}
+
+int jute_decode_CheckVersionRequest(struct iarchive *in, struct CheckVersionRequest *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_CheckVersionRequest(in, "", v);
+    return decode_CheckVersionRequest(in->priv, v);
+}
+
+int jute_encode_GetMaxChildrenRequest(struct oarchive *out, struct GetMaxChildrenRequest *v) {
+    if (!is_buffer_oarchive(out)) return serialize_GetMaxChildrenRequest(out, "", v);
+    return encode_GetMaxChildrenRequest(out->priv, v);
+}
+
+int jute_decode_GetMaxChildrenRequest(struct iarchive *in, struct GetMaxChildrenRequest *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_GetMaxChildrenRequest(in, "", v);
+    return decode_GetMaxChildrenRequest(in->priv, v);
+}
+
+int jute_encode_GetMaxChildrenResponse(struct oarchive *out, struct GetMaxChildrenResponse *v) {
+    if (!is_buffer_oarchive(out)) return serialize_GetMaxChildrenResponse(out, "", v);
+    return encode_GetMaxChildrenResponse(out->priv, v);
+}
+
+int jute_decode_GetMaxChildrenResponse(struct iarchive *in, struct GetMaxChildrenResponse *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_GetMaxChildrenResponse(in, "", v);
+    return decode_GetMaxChildrenResponse(in->priv, v);
+}
+
+int jute_encode_SetMaxChildrenRequest(struct oarchive *out, struct SetMaxChildrenRequest *v) {
+    if (!is_buffer_oarchive(out)) return serialize_SetMaxChildrenRequest(out, "", v);
+    return encode_SetMaxChildrenRequest(out->priv, v);
+}
+
+int jute_decode_SetMaxChildrenRequest(struct iarchive *in, struct SetMaxChildrenRequest *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_SetMaxChildrenRequest(in, "", v);
+    return decode_SetMaxChildrenRequest(in->priv, v);
+}
+
+int jute_encode_SyncRequest(struct oarchive *out, struct SyncRequest *v) {
+    if (!is_buffer_oarchive(out)) return serialize_SyncRequest(out, "", v);
+    return encode_SyncRequest(out->priv, v);
+}
+
+int jute_decode_SyncRequest(struct iarchive *in, struct SyncRequest *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_SyncRequest(in, "", v);
+    return decode_SyncRequest(in->priv, v);
+}
+
+int jute_encode_SyncResponse(struct oarchive *out, struct SyncResponse *v) {
+    if (!is_buffer_oarchive(out)) return serialize_SyncResponse(out, "", v);
+    return encode_SyncResponse(out->priv, v);
+}
+
+int jute_decode_SyncResponse(struct iarchive *in, struct SyncResponse *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_SyncResponse(in, "", v);
+    return decode_SyncResponse(in->priv, v);
+}
+
+int jute_encode_GetACLRequest(struct oarchive *out, struct GetACLRequest *v) {
+    if (!is_buffer_oarchive(out)) return serialize_GetACLRequest(out, "", v);
+    return encode_GetACLRequest(out->priv, v);
+}
+
+int jute_decode_GetACLRequest(struct iarchive *in, struct GetACLRequest *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_GetACLRequest(in, "", v);
+    return decode_GetACLRequest(in->priv, v);
+}
+
+int jute_encode_SetACLRequest(struct oarchive *out, struct SetACLRequest *v) {
+    if (!is_buffer_oarchive(out)) return serialize_SetACLRequest(out, "", v);
+    return encode_SetACLRequest(out->priv, v);
+}
+
+int jute_decode_SetACLRequest(struct iarchive *in, struct SetACLRequest *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_SetACLRequest(in, "", v);
+    return decode_SetACLRequest(in->priv, v);
+}
+
+int jute_encode_SetACLResponse(struct oarchive *out, struct SetACLResponse *v) {
+    if (!is_buffer_oarchive(out)) return serialize_SetACLResponse(out, "", v);
+    return encode_SetACLResponse(out->priv, v);
+}
+
+int jute_decode_SetACLResponse(struct iarchive *in, struct SetACLResponse *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_SetACLResponse(in, "", v);
+    return decode_SetACLResponse(in->priv, v);
+}
+
+int jute_encode_WatcherEvent(struct oarchive *out, struct WatcherEvent *v) {
+    if (!is_buffer_oarchive(out)) return serialize_WatcherEvent(out, "", v);
+    return encode_WatcherEvent(out->priv, v);
+}
+
+int jute_decode_WatcherEvent(struct iarchive *in, struct WatcherEvent *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_WatcherEvent(in, "", v);
+    return decode_WatcherEvent(in->priv, v);
+}
+
+int jute_encode_ErrorResponse(struct oarchive *out, struct ErrorResponse *v) {
+    if (!is_buffer_oarchive(out)) return serialize_ErrorResponse(out, "", v);
+    return encode_ErrorResponse(out->priv, v);
+}
+
+int jute_decode_ErrorResponse(struct iarchive *in, struct ErrorResponse *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_ErrorResponse(in, "", v);
+    return decode_ErrorResponse(in->priv, v);
+}
+
+int jute_encode_CreateResponse(struct oarchive *out, struct CreateResponse *v) {
+    if (!is_buffer_oarchive(out)) return serialize_CreateResponse(out, "", v);
+    return encode_CreateResponse(out->priv, v);
+}
+
+int jute_decode_CreateResponse(struct iarchive *in, struct CreateResponse *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_CreateResponse(in, "", v);
+    return decode_CreateResponse(in->priv, v);
+}
+
+int jute_encode_ExistsRequest(struct oarchive *out, struct ExistsRequest *v) {
+    if (!is_buffer_oarchive(out)) return serialize_ExistsRequest(out, "", v);
+    return encode_ExistsRequest(out->priv, v);
+}
+
+int jute_decode_ExistsRequest(struct iarchive *in, struct ExistsRequest *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_ExistsRequest(in, "", v);
+    return decode_ExistsRequest(in->priv, v);
+}
+
+int jute_encode_ExistsResponse(struct oarchive *out, struct ExistsResponse *v) {
+    if (!is_buffer_oarchive(out)) return serialize_ExistsResponse(out, "", v);
+    return encode_ExistsResponse(out->priv, v);
+}
+
+int jute_decode_ExistsResponse(struct iarchive *in, struct ExistsResponse *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_ExistsResponse(in, "", v);
+    return decode_ExistsResponse(in->priv, v);
+}
+
+int jute_encode_GetDataResponse(struct oarchive *out, struct GetDataResponse *v) {
+    if (!is_buffer_oarchive(out)) return serialize_GetDataResponse(out, "", v);
+    return encode_GetDataResponse(out->priv, v);
+}
+
+int jute_decode_GetDataResponse(struct iarchive *in, struct GetDataResponse *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_GetDataResponse(in, "", v);
+    return decode_GetDataResponse(in->priv, v);
+}
+
+int jute_encode_GetChildrenResponse(struct oarchive *out, struct GetChildrenResponse *v) {
+    if (!is_buffer_oarchive(out)) return serialize_GetChildrenResponse(out, "", v);
+    return encode_GetChildrenResponse(out->priv, v);
+}
+
+int jute_decode_GetChildrenResponse(struct iarchive *in, struct GetChildrenResponse *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_GetChildrenResponse(in, "", v);
+    return decode_GetChildrenResponse(in->priv, v);
+}
+
+int jute_encode_GetChildren2Response(struct oarchive *out, struct GetChildren2Response *v) {
+    if (!is_buffer_oarchive(out)) return serialize_GetChildren2Response(out, "", v);
+    return encode_GetChildren2Response(out->priv, v);
+}
+
+int jute_decode_GetChildren2Response(struct iarchive *in, struct GetChildren2Response *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_GetChildren2Response(in, "", v);
+    return decode_GetChildren2Response(in->priv, v);
+}
+
+int jute_encode_GetACLResponse(struct oarchive *out, struct GetACLResponse *v) {
+    if (!is_buffer_oarchive(out)) return serialize_GetACLResponse(out, "", v);
+    return encode_GetACLResponse(out->priv, v);
+}
+
+int jute_decode_GetACLResponse(struct iarchive *in, struct GetACLResponse *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_GetACLResponse(in, "", v);
+    return decode_GetACLResponse(in->priv, v);
+}
+
+int jute_encode_LearnerInfo(struct oarchive *out, struct LearnerInfo *v) {
+    if (!is_buffer_oarchive(out)) return serialize_LearnerInfo(out, "", v);
+    return encode_LearnerInfo(out->priv, v);
+}
+
+int jute_decode_LearnerInfo(struct iarchive *in, struct LearnerInfo *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_LearnerInfo(in, "", v);
+    return decode_LearnerInfo(in->priv, v);
+}
+
+int jute_encode_Id_vector(struct oarchive *out, struct Id_vector *v) {
+    if (!is_buffer_oarchive(out)) return serialize_Id_vector(out, "", v);
+    return encode_Id_vector(out->priv, v);
+}
+
+int jute_decode_Id_vector(struct iarchive *in, struct Id_vector *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_Id_vector(in, "", v);
+    return decode_Id_vector(in->priv, v);
+}
+
+int jute_encode_QuorumPacket(struct oarchive *out, struct QuorumPacket *v) {
+    if (!is_buffer_oarchive(out)) return serialize_QuorumPacket(out, "", v);
+    return encode_QuorumPacket(out->priv, v);
+}
+
+int jute_decode_QuorumPacket(struct iarchive *in, struct QuorumPacket *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_QuorumPacket(in, "", v);
+    return decode_QuorumPacket(in->priv, v);
+}
+
+int jute_encode_FileHeader(struct oarchive *out, struct FileHeader *v) {
+    if (!is_buffer_oarchive(out)) return serialize_FileHeader(out, "", v);
+    return encode_FileHeader(out->priv, v);
+}
+
+int jute_decode_FileHeader(struct iarchive *in, struct FileHeader *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_FileHeader(in, "", v);
+    return decode_FileHeader(in->priv, v);
+}
+
+int jute_encode_TxnHeader(struct oarchive *out, struct TxnHeader *v) {
+    if (!is_buffer_oarchive(out)) return serialize_TxnHeader(out, "", v);
+    return encode_TxnHeader(out->priv, v);
+}
+
+int jute_decode_TxnHeader(struct iarchive *in, struct TxnHeader *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_TxnHeader(in, "", v);
+    return decode_TxnHeader(in->priv, v);
+}
+
+int jute_encode_CreateTxnV0(struct oarchive *out, struct CreateTxnV0 *v) {
+    if (!is_buffer_oarchive(out)) return serialize_CreateTxnV0(out, "", v);
+    return encode_CreateTxnV0(out->priv, v);
+}
+
+int jute_decode_CreateTxnV0(struct iarchive *in, struct CreateTxnV0 *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_CreateTxnV0(in, "", v);
+    return decode_CreateTxnV0(in->priv, v);
+}
+
+int jute_encode_CreateTxn(struct oarchive *out, struct CreateTxn *v) {
+    if (!is_buffer_oarchive(out)) return serialize_CreateTxn(out, "", v);
+    return encode_CreateTxn(out->priv, v);
+}
+
+int jute_decode_CreateTxn(struct iarchive *in, struct CreateTxn *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_CreateTxn(in, "", v);
+    return decode_CreateTxn(in->priv, v);
+}
+
+int jute_encode_DeleteTxn(struct oarchive *out, struct DeleteTxn *v) {
+    if (!is_buffer_oarchive(out)) return serialize_DeleteTxn(out, "", v);
+    return encode_DeleteTxn(out->priv, v);
+}
+
+int jute_decode_DeleteTxn(struct iarchive *in, struct DeleteTxn *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_DeleteTxn(in, "", v);
+    return decode_DeleteTxn(in->priv, v);
+}
+
+int jute_encode_SetDataTxn(struct oarchive *out, struct SetDataTxn *v) {
+    if (!is_buffer_oarchive(out)) return serialize_SetDataTxn(out, "", v);
+    return encode_SetDataTxn(out->priv, v);
+}
+
+int jute_decode_SetDataTxn(struct iarchive *in, struct SetDataTxn *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_SetDataTxn(in, "", v);
+    return decode_SetDataTxn(in->priv, v);
+}
+
+int jute_encode_CheckVersionTxn(struct oarchive *out, struct CheckVersionTxn *v) {
+    if (!is_buffer_oarchive(out)) return serialize_CheckVersionTxn(out, "", v);
+    return encode_CheckVersionTxn(out->priv, v);
+}
+
+int jute_decode_CheckVersionTxn(struct iarchive *in, struct CheckVersionTxn *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_CheckVersionTxn(in, "", v);
+    return decode_CheckVersionTxn(in->priv, v);
+}
+
+int jute_encode_SetACLTxn(struct oarchive *out, struct SetACLTxn *v) {
+    if (!is_buffer_oarchive(out)) return serialize_SetACLTxn(out, "", v);
+    return encode_SetACLTxn(out->priv, v);
+}
+
+int jute_decode_SetACLTxn(struct iarchive *in, struct SetACLTxn *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_SetACLTxn(in, "", v);
+    return decode_SetACLTxn(in->priv, v);
+}
+
+int jute_encode_SetMaxChildrenTxn(struct oarchive *out, struct SetMaxChildrenTxn *v) {
+    if (!is_buffer_oarchive(out)) return serialize_SetMaxChildrenTxn(out, "", v);
+    return encode_SetMaxChildrenTxn(out->priv, v);
+}
+
+int jute_decode_SetMaxChildrenTxn(struct iarchive *in, struct SetMaxChildrenTxn *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_SetMaxChildrenTxn(in, "", v);
+    return decode_SetMaxChildrenTxn(in->priv, v);
+}
+
+int jute_encode_CreateSessionTxn(struct oarchive *out, struct CreateSessionTxn *v) {
+    if (!is_buffer_oarchive(out)) return serialize_CreateSessionTxn(out, "", v);
+    return encode_CreateSessionTxn(out->priv, v);
+}
+
+int jute_decode_CreateSessionTxn(struct iarchive *in, struct CreateSessionTxn *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_CreateSessionTxn(in, "", v);
+    return decode_CreateSessionTxn(in->priv, v);
+}
+
+int jute_encode_ErrorTxn(struct oarchive *out, struct ErrorTxn *v) {
+    if (!is_buffer_oarchive(out)) return serialize_ErrorTxn(out, "", v);
+    return encode_ErrorTxn(out->priv, v);
+}
+
+int jute_decode_ErrorTxn(struct iarchive *in, struct ErrorTxn *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_ErrorTxn(in, "", v);
+    return decode_ErrorTxn(in->priv, v);
+}
+
+int jute_encode_Txn(struct oarchive *out, struct Txn *v) {
+    if (!is_buffer_oarchive(out)) return serialize_Txn(out, "", v);
+    return encode_Txn(out->priv, v);
+}
+
+int jute_decode_Txn(struct iarchive *in, struct Txn *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_Txn(in, "", v);
+    return decode_Txn(in->priv, v);
+}
+
+int jute_encode_Txn_vector(struct oarchive *out, struct Txn_vector *v) {
+    if (!is_buffer_oarchive(out)) return serialize_Txn_vector(out, "", v);
+    return encode_Txn_vector(out->priv, v);
+}
+
+int jute_decode_Txn_vector(struct iarchive *in, struct Txn_vector *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_Txn_vector(in, "", v);
+    return decode_Txn_vector(in->priv, v);
+}
+
+int jute_encode_MultiTxn(struct oarchive *out, struct MultiTxn *v) {
+    if (!is_buffer_oarchive(out)) return serialize_MultiTxn(out, "", v);
+    return encode_MultiTxn(out->priv, v);
+}
+
+int jute_decode_MultiTxn(struct iarchive *in, struct MultiTxn *v) {
+    if (!is_buffer_iarchive(in)) return deserialize_MultiTxn(in, "", v);
+    return decode_MultiTxn(in->priv, v);
+}
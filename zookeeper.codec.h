@@ -0,0 +1,191 @@
+/* generated by gen_codec.py from zookeeper.jute.c, do not edit. */
+
+#ifndef __ZOOKEEPER_CODEC__
+#define __ZOOKEEPER_CODEC__
+
+#include "zookeeper.jute.h"
+
+// jute_encode_* and jute_decode_* behave like serialize_* and deserialize_*
+// but read and write buffer archives directly, other archives fall back
+// to the generic functions. serialized_size_* returns the exact number of
+// bytes a record encodes to.
+
+int32_t serialized_size_Id(struct Id *v);
+int32_t serialized_size_ACL(struct ACL *v);
+int32_t serialized_size_Stat(struct Stat *v);
+int32_t serialized_size_StatPersisted(struct StatPersisted *v);
+int32_t serialized_size_StatPersistedV1(struct StatPersistedV1 *v);
+int32_t serialized_size_ConnectRequest(struct ConnectRequest *v);
+int32_t serialized_size_ConnectResponse(struct ConnectResponse *v);
+int32_t serialized_size_String_vector(struct String_vector *v);
+int32_t serialized_size_SetWatches(struct SetWatches *v);
+int32_t serialized_size_RequestHeader(struct RequestHeader *v);
+int32_t serialized_size_MultiHeader(struct MultiHeader *v);
+int32_t serialized_size_AuthPacket(struct AuthPacket *v);
+int32_t serialized_size_ReplyHeader(struct ReplyHeader *v);
+int32_t serialized_size_GetDataRequest(struct GetDataRequest *v);
+int32_t serialized_size_SetDataRequest(struct SetDataRequest *v);
+int32_t serialized_size_SetDataResponse(struct SetDataResponse *v);
+int32_t serialized_size_GetSASLRequest(struct GetSASLRequest *v);
+int32_t serialized_size_SetSASLRequest(struct SetSASLRequest *v);
+int32_t serialized_size_SetSASLResponse(struct SetSASLResponse *v);
+int32_t serialized_size_ACL_vector(struct ACL_vector *v);
+int32_t serialized_size_CreateRequest(struct CreateRequest *v);
+int32_t serialized_size_DeleteRequest(struct DeleteRequest *v);
+int32_t serialized_size_GetChildrenRequest(struct GetChildrenRequest *v);
+int32_t serialized_size_GetChildren2Request(struct GetChildren2Request *v);
+int32_t serialized_size_CheckVersionRequest(struct CheckVersionRequest *v);
+int32_t serialized_size_GetMaxChildrenRequest(struct GetMaxChildrenRequest *v);
+int32_t serialized_size_GetMaxChildrenResponse(struct GetMaxChildrenResponse *v);
+int32_t serialized_size_SetMaxChildrenRequest(struct SetMaxChildrenRequest *v);
+int32_t serialized_size_SyncRequest(struct SyncRequest *v);
+int32_t serialized_size_SyncResponse(struct SyncResponse *v);
+int32_t serialized_size_GetACLRequest(struct GetACLRequest *v);
+int32_t serialized_size_SetACLRequest(struct SetACLRequest *v);
+int32_t serialized_size_SetACLResponse(struct SetACLResponse *v);
+int32_t serialized_size_WatcherEvent(struct WatcherEvent *v);
+int32_t serialized_size_ErrorResponse(struct ErrorResponse *v);
+int32_t serialized_size_CreateResponse(struct CreateResponse *v);
+int32_t serialized_size_ExistsRequest(struct ExistsRequest *v);
+int32_t serialized_size_ExistsResponse(struct ExistsResponse *v);
+int32_t serialized_size_GetDataResponse(struct GetDataResponse *v);
+int32_t serialized_size_GetChildrenResponse(struct GetChildrenResponse *v);
+int32_t serialized_size_GetChildren2Response(struct GetChildren2Response *v);
+int32_t serialized_size_GetACLResponse(struct GetACLResponse *v);
+int32_t serialized_size_LearnerInfo(struct LearnerInfo *v);
+int32_t serialized_size_Id_vector(struct Id_vector *v);
+int32_t serialized_size_QuorumPacket(struct QuorumPacket *v);
+int32_t serialized_size_FileHeader(struct FileHeader *v);
+int32_t serialized_size_TxnHeader(struct TxnHeader *v);
+int32_t serialized_size_CreateTxnV0(struct CreateTxnV0 *v);
+int32_t serialized_size_CreateTxn(struct CreateTxn *v);
+int32_t serialized_size_DeleteTxn(struct DeleteTxn *v);
+int32_t serialized_size_SetDataTxn(struct SetDataTxn *v);
+int32_t serialized_size_CheckVersionTxn(struct CheckVersionTxn *v);
+int32_t serialized_size_SetACLTxn(struct SetACLTxn *v);
+int32_t serialized_size_SetMaxChildrenTxn(struct SetMaxChildrenTxn *v);
+int32_t serialized_size_CreateSessionTxn(struct CreateSessionTxn *v);
+int32_t serialized_size_ErrorTxn(struct ErrorTxn *v);
+int32_t serialized_size_Txn(struct Txn *v);
+int32_t serialized_size_Txn_vector(struct Txn_vector *v);
+int32_t serialized_size_MultiTxn(struct MultiTxn *v);
+
+int jute_encode_Id(struct oarchive *out, struct Id *v);
+int jute_decode_Id(struct iarchive *in, struct Id *v);
+int jute_encode_ACL(struct oarchive *out, struct ACL *v);
+int jute_decode_ACL(struct iarchive *in, struct ACL *v);
+int jute_encode_Stat(struct oarchive *out, struct Stat *v);
+int jute_decode_Stat(struct iarchive *in, struct Stat *v);
+int jute_encode_StatPersisted(struct oarchive *out, struct StatPersisted *v);
+int jute_decode_StatPersisted(struct iarchive *in, struct StatPersisted *v);
+int jute_encode_StatPersistedV1(struct oarchive *out, struct StatPersistedV1 *v);
+int jute_decode_StatPersistedV1(struct iarchive *in, struct StatPersistedV1 *v);
+int jute_encode_ConnectRequest(struct oarchive *out, struct ConnectRequest *v);
+int jute_decode_ConnectRequest(struct iarchive *in, struct ConnectRequest *v);
+int jute_encode_ConnectResponse(struct oarchive *out, struct ConnectResponse *v);
+int jute_decode_ConnectResponse(struct iarchive *in, struct ConnectResponse *v);
+int jute_encode_String_vector(struct oarchive *out, struct String_vector *v);
+int jute_decode_String_vector(struct iarchive *in, struct String_vector *v);
+int jute_encode_SetWatches(struct oarchive *out, struct SetWatches *v);
+int jute_decode_SetWatches(struct iarchive *in, struct SetWatches *v);
+int jute_encode_RequestHeader(struct oarchive *out, struct RequestHeader *v);
+int jute_decode_RequestHeader(struct iarchive *in, struct RequestHeader *v);
+int jute_encode_MultiHeader(struct oarchive *out, struct MultiHeader *v);
+int jute_decode_MultiHeader(struct iarchive *in, struct MultiHeader *v);
+int jute_encode_AuthPacket(struct oarchive *out, struct AuthPacket *v);
+int jute_decode_AuthPacket(struct iarchive *in, struct AuthPacket *v);
+int jute_encode_ReplyHeader(struct oarchive *out, struct ReplyHeader *v);
+int jute_decode_ReplyHeader(struct iarchive *in, struct ReplyHeader *v);
+int jute_encode_GetDataRequest(struct oarchive *out, struct GetDataRequest *v);
+int jute_decode_GetDataRequest(struct iarchive *in, struct GetDataRequest *v);
+int jute_encode_SetDataRequest(struct oarchive *out, struct SetDataRequest *v);
+int jute_decode_SetDataRequest(struct iarchive *in, struct SetDataRequest *v);
+int jute_encode_SetDataResponse(struct oarchive *out, struct SetDataResponse *v);
+int jute_decode_SetDataResponse(struct iarchive *in, struct SetDataResponse *v);
+int jute_encode_GetSASLRequest(struct oarchive *out, struct GetSASLRequest *v);
+int jute_decode_GetSASLRequest(struct iarchive *in, struct GetSASLRequest *v);
+int jute_encode_SetSASLRequest(struct oarchive *out, struct SetSASLRequest *v);
+int jute_decode_SetSASLRequest(struct iarchive *in, struct SetSASLRequest *v);
+int jute_encode_SetSASLResponse(struct oarchive *out, struct SetSASLResponse *v);
+int jute_decode_SetSASLResponse(struct iarchive *in, struct SetSASLResponse *v);
+int jute_encode_ACL_vector(struct oarchive *out, struct ACL_vector *v);
+int jute_decode_ACL_vector(struct iarchive *in, struct ACL_vector *v);
+int jute_encode_CreateRequest(struct oarchive *out, struct CreateRequest *v);
+int jute_decode_CreateRequest(struct iarchive *in, struct CreateRequest *v);
+int jute_encode_DeleteRequest(struct oarchive *out, struct DeleteRequest *v);
+int jute_decode_DeleteRequest(struct iarchive *in, struct DeleteRequest *v);
+int jute_encode_GetChildrenRequest(struct oarchive *out, struct GetChildrenRequest *v);
+int jute_decode_GetChildrenRequest(struct iarchive *in, struct GetChildrenRequest *v);
+int jute_encode_GetChildren2Request(struct oarchive *out, struct GetChildren2Request *v);
+int jute_decode_GetChildren2Request(struct iarchive *in, struct GetChildren2Request *v);
+int jute_encode_CheckVersionRequest(struct oarchive *out, struct CheckVersionRequest *v);
+int jute_decode_CheckVersionRequest(struct iarchive *in, struct CheckVersionRequest *v);
+int jute_encode_GetMaxChildrenRequest(struct oarchive *out, struct GetMaxChildrenRequest *v);
+int jute_decode_GetMaxChildrenRequest(struct iarchive *in, struct GetMaxChildrenRequest *v);
+int jute_encode_GetMaxChildrenResponse(struct oarchive *out, struct GetMaxChildrenResponse *v);
+int jute_decode_GetMaxChildrenResponse(struct iarchive *in, struct GetMaxChildrenResponse *v);
+int jute_encode_SetMaxChildrenRequest(struct oarchive *out, struct SetMaxChildrenRequest *v);
+int jute_decode_SetMaxChildrenRequest(struct iarchive *in, struct SetMaxChildrenRequest *v);
+int jute_encode_SyncRequest(struct oarchive *out, struct SyncRequest *v);
+int jute_decode_SyncRequest(struct iarchive *in, struct SyncRequest *v);
+int jute_encode_SyncResponse(struct oarchive *out, struct SyncResponse *v);
+int jute_decode_SyncResponse(struct iarchive *in, struct SyncResponse *v);
+int jute_encode_GetACLRequest(struct oarchive *out, struct GetACLRequest *v);
+int jute_decode_GetACLRequest(struct iarchive *in, struct GetACLRequest *v);
+int jute_encode_SetACLRequest(struct oarchive *out, struct SetACLRequest *v);
+int jute_decode_SetACLRequest(struct iarchive *in, struct SetACLRequest *v);
+int jute_encode_SetACLResponse(struct oarchive *out, struct SetACLResponse *v);
+int jute_decode_SetACLResponse(struct iarchive *in, struct SetACLResponse *v);
+int jute_encode_WatcherEvent(struct oarchive *out, struct WatcherEvent *v);
+int jute_decode_WatcherEvent(struct iarchive *in, struct WatcherEvent *v);
+int jute_encode_ErrorResponse(struct oarchive *out, struct ErrorResponse *v);
+int jute_decode_ErrorResponse(struct iarchive *in, struct ErrorResponse *v);
+int jute_encode_CreateResponse(struct oarchive *out, struct CreateResponse *v);
+int jute_decode_CreateResponse(struct iarchive *in, struct CreateResponse *v);
+int jute_encode_ExistsRequest(struct oarchive *out, struct ExistsRequest *v);
+int jute_decode_ExistsRequest(struct iarchive *in, struct ExistsRequest *v);
+int jute_encode_ExistsResponse(struct oarchive *out, struct ExistsResponse *v);
+int jute_decode_ExistsResponse(struct iarchive *in, struct ExistsResponse *v);
+int jute_encode_GetDataResponse(struct oarchive *out, struct GetDataResponse *v);
+int jute_decode_GetDataResponse(struct iarchive *in, struct GetDataResponse *v);
+int jute_encode_GetChildrenResponse(struct oarchive *out, struct GetChildrenResponse *v);
+int jute_decode_GetChildrenResponse(struct iarchive *in, struct GetChildrenResponse *v);
+int jute_encode_GetChildren2Response(struct oarchive *out, struct GetChildren2Response *v);
+int jute_decode_GetChildren2Response(struct iarchive *in, struct GetChildren2Response *v);
+int jute_encode_GetACLResponse(struct oarchive *out, struct GetACLResponse *v);
+int jute_decode_GetACLResponse(struct iarchive *in, struct GetACLResponse *v);
+int jute_encode_LearnerInfo(struct oarchive *out, struct LearnerInfo *v);
+int jute_decode_LearnerInfo(struct iarchive *in, struct LearnerInfo *v);
+int jute_encode_Id_vector(struct oarchive *out, struct Id_vector *v);
+int jute_decode_Id_vector(struct iarchive *in, struct Id_vector *v);
+int jute_encode_QuorumPacket(struct oarchive *out, struct QuorumPacket *v);
+int jute_decode_QuorumPacket(struct iarchive *in, struct QuorumPacket *v);
+int jute_encode_FileHeader(struct oarchive *out, struct FileHeader *v);
+int jute_decode_FileHeader(struct iarchive *in, struct FileHeader *v);
+int jute_encode_TxnHeader(struct oarchive *out, struct TxnHeader *v);
+int jute_decode_TxnHeader(struct iarchive *in, struct TxnHeader *v);
+int jute_encode_CreateTxnV0(struct oarchive *out, struct CreateTxnV0 *v);
+int jute_decode_CreateTxnV0(struct iarchive *in, struct CreateTxnV0 *v);
+int jute_encode_CreateTxn(struct oarchive *out, struct CreateTxn *v);
+int jute_decode_CreateTxn(struct iarchive *in, struct CreateTxn *v);
+int jute_encode_DeleteTxn(struct oarchive *out, struct DeleteTxn *v);
+int jute_decode_DeleteTxn(struct iarchive *in, struct DeleteTxn *v);
+int jute_encode_SetDataTxn(struct oarchive *out, struct SetDataTxn *v);
+int jute_decode_SetDataTxn(struct iarchive *in, struct SetDataTxn *v);
+int jute_encode_CheckVersionTxn(struct oarchive *out, struct CheckVersionTxn *v);
+int jute_decode_CheckVersionTxn(struct iarchive *in, struct CheckVersionTxn *v);
+int jute_encode_SetACLTxn(struct oarchive *out, struct SetACLTxn *v);
+int jute_decode_SetACLTxn(struct iarchive *in, struct SetACLTxn *v);
+int jute_encode_SetMaxChildrenTxn(struct oarchive *out, struct SetMaxChildrenTxn *v);
+int jute_decode_SetMaxChildrenTxn(struct iarchive *in, struct SetMaxChildrenTxn *v);
+int jute_encode_CreateSessionTxn(struct oarchive *out, struct CreateSessionTxn *v);
+int jute_decode_CreateSessionTxn(struct iarchive *in, struct CreateSessionTxn *v);
+int jute_encode_ErrorTxn(struct oarchive *out, struct ErrorTxn *v);
+int jute_decode_ErrorTxn(struct iarchive *in, struct ErrorTxn *v);
+int jute_encode_Txn(struct oarchive *out, struct Txn *v);
+int jute_decode_Txn(struct iarchive *in, struct Txn *v);
+int jute_encode_Txn_vector(struct oarchive *out, struct Txn_vector *v);
+int jute_decode_Txn_vector(struct iarchive *in, struct Txn_vector *v);
+int jute_encode_MultiTxn(struct oarchive *out, struct MultiTxn *v);
+int jute_decode_MultiTxn(struct iarchive *in, struct MultiTxn *v);
+#endif